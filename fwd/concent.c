@@ -0,0 +1,125 @@
+/*!>
+ *  ____  ____      _    ____ ___ _   _  ___
+ *  |  _ \|  _ \    / \  / ___|_ _| \ | |/ _ \
+ *  | | | | |_) |  / _ \| |  _ | ||  \| | | | |
+ *  | |_| |  _ <  / ___ \ |_| || || |\  | |_| |
+ *  |____/|_| \_\/_/   \_\____|___|_| \_|\___/
+ *
+ * Dragino_gw_fwd -- An opensource lora gateway forward
+ *
+ * See http://www.dragino.com for more information about
+ * the lora gateway project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ *
+ * Maintainer: skerlan
+ *
+ */
+
+/*!>!
+ * \file
+ * \brief
+ *  Description: concentrator access scheduler. A gate in front of
+ *  GW.hal.mx_concent lets TX lane requests through first: once one is
+ *  waiting, other operations wait until it had the concentrator. An
+ *  access in progress is never interrupted. Code still locking
+ *  mx_concent directly is serialized as before, without priority.
+*/
+
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "fwd.h"
+#include "concent.h"
+
+DECLARE_GW;
+
+static pthread_mutex_t mx_gate = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cd_gate = PTHREAD_COND_INITIALIZER;
+static bool gate_busy = false;                  /*!> concentrator given through the gate */
+static int nb_tx_wait = 0;                      /*!> TX lane requests waiting at the gate */
+
+static concent_wait_s wait_stat[CONCENT_OP_NB];
+
+static __thread int cancel_state;               /*!> of the thread holding the concentrator */
+
+static const char* op_name[CONCENT_OP_NB] = { "tx", "fetch", "counter", "scan", "other" };
+
+static int64_t mono_us(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (int64_t)t.tv_sec * 1000000 + t.tv_nsec / 1000;
+}
+
+static void wait_update(concent_op_e op, uint32_t wait_us) {
+    concent_wait_s* w = &wait_stat[op];
+    uint32_t max = __atomic_load_n(&w->wait_max_us, __ATOMIC_RELAXED);
+
+    __atomic_add_fetch(&w->nb, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&w->wait_sum_us, wait_us, __ATOMIC_RELAXED);
+    while (wait_us > max && !__atomic_compare_exchange_n(&w->wait_max_us, &max, wait_us, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+void concent_lock(concent_op_e op) {
+    int64_t start = mono_us();
+    int state;
+
+    /*!> a cancelled waiter would leave the gate locked or nb_tx_wait raised */
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+
+    pthread_mutex_lock(&mx_gate);
+    if (op == CONCENT_TX) {
+        nb_tx_wait++;
+        while (gate_busy)
+            pthread_cond_wait(&cd_gate, &mx_gate);
+        nb_tx_wait--;
+    } else {
+        while (gate_busy || nb_tx_wait > 0)
+            pthread_cond_wait(&cd_gate, &mx_gate);
+    }
+    gate_busy = true;
+    pthread_mutex_unlock(&mx_gate);
+
+    pthread_mutex_lock(&GW.hal.mx_concent);
+    cancel_state = state;
+
+    wait_update(op, (uint32_t)(mono_us() - start));
+}
+
+void concent_unlock(void) {
+    int state = cancel_state;
+
+    pthread_mutex_unlock(&GW.hal.mx_concent);
+
+    pthread_mutex_lock(&mx_gate);
+    gate_busy = false;
+    pthread_cond_broadcast(&cd_gate);
+    pthread_mutex_unlock(&mx_gate);
+
+    pthread_setcancelstate(state, NULL);
+}
+
+void concent_stat(concent_wait_s st[CONCENT_OP_NB], bool reset) {
+    int i;
+
+    for (i = 0; i < CONCENT_OP_NB; i++) {
+        if (reset) {
+            st[i].nb = __atomic_exchange_n(&wait_stat[i].nb, 0, __ATOMIC_RELAXED);
+            st[i].wait_sum_us = __atomic_exchange_n(&wait_stat[i].wait_sum_us, 0, __ATOMIC_RELAXED);
+            st[i].wait_max_us = __atomic_exchange_n(&wait_stat[i].wait_max_us, 0, __ATOMIC_RELAXED);
+        } else {
+            st[i].nb = __atomic_load_n(&wait_stat[i].nb, __ATOMIC_RELAXED);
+            st[i].wait_sum_us = __atomic_load_n(&wait_stat[i].wait_sum_us, __ATOMIC_RELAXED);
+            st[i].wait_max_us = __atomic_load_n(&wait_stat[i].wait_max_us, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+const char* concent_op_name(concent_op_e op) {
+    return op < CONCENT_OP_NB ? op_name[op] : "?";
+}
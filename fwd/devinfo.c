@@ -0,0 +1,184 @@
+/*!>
+ *  ____  ____      _    ____ ___ _   _  ___
+ *  |  _ \|  _ \    / \  / ___|_ _| \ | |/ _ \
+ *  | | | | |_) |  / _ \| |  _ | ||  \| | | | |
+ *  | |_| |  _ <  / ___ \ |_| || || |\  | |_| |
+ *  |____/|_| \_\/_/   \_\____|___|_| \_|\___/
+ *
+ * Dragino_gw_fwd -- An opensource lora gateway forward
+ *
+ * See http://www.dragino.com for more information about
+ * the lora gateway project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ *
+ * Maintainer: skerlan
+ *
+ */
+
+
+/*!>!
+ * \file
+ * \brief
+ *  Description: ABP device keys index. The abpdevs table of the devskey
+ *  database is read into an open addressing table keyed by DevAddr, a
+ *  lookup is one probe sequence without lock. The devskey watcher reloads
+ *  it when the database changes, see devskey_tab_s for the table lifetime.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <sqlite3.h>
+
+#include "fwd.h"
+#include "devinfo.h"
+#include "devskey.h"
+#include "loramac-crypto.h"
+
+typedef struct {
+    bool used;
+    devinfo_s info;
+} devinfo_slot_s;
+
+typedef struct {
+    uint32_t mask;                              /*!> slot number - 1, power of 2 */
+    int nb_dev;
+    devinfo_slot_s slot[];
+} devinfo_tab_s;
+
+static void tab_release(void* tab) {
+    lgw_free(tab);
+}
+
+static devskey_tab_s devs = DEVSKEY_TAB_INIT(tab_release);
+
+static inline uint32_t devaddr_hash(uint32_t devaddr, uint32_t mask) {
+    uint32_t h = devaddr * 2654435761u;
+    return (h ^ h >> 16) & mask;
+}
+
+bool devinfo_get(uint32_t devaddr, devinfo_s* info) {
+    const devinfo_tab_s* tab = devskey_tab_read(&devs);
+    uint32_t i;
+
+    if (tab == NULL)
+        return false;
+
+    for (i = devaddr_hash(devaddr, tab->mask); tab->slot[i].used; i = (i + 1) & tab->mask) {
+        if (tab->slot[i].info.devaddr == devaddr) {
+            memcpy(info, &tab->slot[i].info, sizeof(devinfo_s));
+            return true;
+        }
+    }
+    return false;
+}
+
+/*!> devaddr, appskey and nwkskey as hex strings, bad rows are skipped */
+static bool parse_row(sqlite3_stmt* stmt, devinfo_s* info) {
+    const char* devaddr = (const char*)sqlite3_column_text(stmt, 0);
+    const char* appskey = (const char*)sqlite3_column_text(stmt, 1);
+    const char* nwkskey = (const char*)sqlite3_column_text(stmt, 2);
+    char* end;
+
+    if (devaddr == NULL || appskey == NULL || nwkskey == NULL)
+        return false;
+
+    memset(info, 0, sizeof(devinfo_s));
+    errno = 0;
+    info->devaddr = (uint32_t)strtoul(devaddr, &end, 16);
+    if (errno != 0 || end == devaddr || *end != '\0')
+        return false;
+    if (hex_to_bin(appskey, info->appskey, 16) || hex_to_bin(nwkskey, info->nwkskey, 16))
+        return false;
+
+    snprintf(info->devaddr_str, sizeof(info->devaddr_str), "%s", devaddr);
+    snprintf(info->appskey_str, sizeof(info->appskey_str), "%s", appskey);
+    snprintf(info->nwkskey_str, sizeof(info->nwkskey_str), "%s", nwkskey);
+    return true;
+}
+
+static void tab_insert(devinfo_tab_s* tab, const devinfo_s* info) {
+    uint32_t i;
+
+    for (i = devaddr_hash(info->devaddr, tab->mask); tab->slot[i].used; i = (i + 1) & tab->mask) {
+        if (tab->slot[i].info.devaddr == info->devaddr)
+            break;                              /*!> same device twice, last row wins */
+    }
+    if (!tab->slot[i].used)
+        tab->nb_dev++;
+    tab->slot[i].used = true;
+    memcpy(&tab->slot[i].info, info, sizeof(devinfo_s));
+}
+
+static int devinfo_load(sqlite3* db) {
+    sqlite3_stmt* stmt = NULL;
+    devinfo_tab_s* tab = NULL;
+    devinfo_s info;
+    uint32_t nb_slot = 16;
+    int nb_row = 0, nb_read = 0, nb_bad = 0, ret = SQLITE_DONE;
+
+    /*!> table sized from the row count, at most half full */
+    if (sqlite3_prepare_v2(db, "SELECT count(*) FROM abpdevs", -1, &stmt, NULL) != SQLITE_OK ||
+        sqlite3_step(stmt) != SQLITE_ROW) {
+        lgw_log(LOG_WARNING, "%s[DEVINFO] can't count abpdevs: %s\n", WARNMSG, sqlite3_errmsg(db));
+        goto fail;
+    }
+    nb_row = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+    stmt = NULL;
+    while (nb_slot < (uint32_t)nb_row * 2)
+        nb_slot <<= 1;
+
+    tab = lgw_calloc(1, sizeof(devinfo_tab_s) + nb_slot * sizeof(devinfo_slot_s));
+    if (tab == NULL)
+        goto fail;
+    tab->mask = nb_slot - 1;
+
+    if (sqlite3_prepare_v2(db, "SELECT devaddr, appskey, nwkskey FROM abpdevs", -1, &stmt, NULL) != SQLITE_OK) {
+        lgw_log(LOG_WARNING, "%s[DEVINFO] can't read abpdevs: %s\n", WARNMSG, sqlite3_errmsg(db));
+        goto fail;
+    }
+    /*!> rows added since the count are dropped, the next check reloads */
+    while (nb_read < nb_row && (ret = sqlite3_step(stmt)) == SQLITE_ROW) {
+        nb_read++;
+        if (parse_row(stmt, &info))
+            tab_insert(tab, &info);
+        else
+            nb_bad++;
+    }
+    if (nb_read < nb_row && ret != SQLITE_DONE) {
+        lgw_log(LOG_WARNING, "%s[DEVINFO] can't read abpdevs: %s\n", WARNMSG, sqlite3_errmsg(db));
+        goto fail;
+    }
+    sqlite3_finalize(stmt);
+
+    if (nb_bad > 0)
+        lgw_log(LOG_WARNING, "%s[DEVINFO] %d devices with malformed keys ignored\n", WARNMSG, nb_bad);
+
+    devskey_tab_swap(&devs, tab);
+
+    LoRaMacSKeysFlush();                        /*!> expanded keys may be stale */
+
+    lgw_log(LOG_INFO, "%s[DEVINFO] %d ABP devices loaded\n", INFOMSG, tab->nb_dev);
+    return tab->nb_dev;
+
+fail:
+    if (stmt != NULL)
+        sqlite3_finalize(stmt);
+    if (tab != NULL)
+        lgw_free(tab);
+    return -1;                                  /*!> no retry until the file changes */
+}
+
+int devinfo_init(void) {
+    return devskey_watch(devinfo_load);
+}
+
+void devinfo_free(void) {
+    devskey_tab_free(&devs);
+}
@@ -0,0 +1,144 @@
+/*!>
+ *  ____  ____      _    ____ ___ _   _  ___
+ *  |  _ \|  _ \    / \  / ___|_ _| \ | |/ _ \
+ *  | | | | |_) |  / _ \| |  _ | ||  \| | | | |
+ *  | |_| |  _ <  / ___ \ |_| || || |\  | |_| |
+ *  |____/|_| \_\/_/   \_\____|___|_| \_|\___/
+ *
+ * Dragino_gw_fwd -- An opensource lora gateway forward
+ *
+ * See http://www.dragino.com for more information about
+ * the lora gateway project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ *
+ * Maintainer: skerlan
+ *
+ */
+
+
+/*!>!
+ * \file
+ * \brief
+ *  Description: devskey database watcher. The file is checked from the
+ *  main loop, when its time, size or inode changed it is opened read only
+ *  and every loader rebuilds its table from it.
+*/
+
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "fwd.h"
+#include "devskey.h"
+
+static devskey_load_cb loaders[DEVSKEY_LOADER_NB];
+static int nb_loader = 0;
+
+static struct stat db_st;                       /*!> database file at the last load */
+static bool db_stamped = false;
+static struct timespec last_check;
+
+void devskey_tab_swap(devskey_tab_s* t, void* tab) {
+    void* old = __atomic_exchange_n(&t->cur, tab, __ATOMIC_ACQ_REL);
+
+    if (t->old != NULL)
+        t->release(t->old);
+    t->old = old;
+}
+
+void devskey_tab_free(devskey_tab_s* t) {
+    void* tab = __atomic_exchange_n(&t->cur, NULL, __ATOMIC_ACQ_REL);
+
+    if (tab != NULL)
+        t->release(tab);
+    if (t->old != NULL)
+        t->release(t->old);
+    t->old = NULL;
+}
+
+static int run_loader(devskey_load_cb cb) {
+    sqlite3* db = NULL;
+    int ret;
+
+    if (sqlite3_open_v2(DEVSKEY_DB_PATH, &db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK) {
+        lgw_log(LOG_WARNING, "%s[DEVSKEY] can't open %s: %s\n", WARNMSG, DEVSKEY_DB_PATH, sqlite3_errmsg(db));
+        sqlite3_close_v2(db);
+        return -1;
+    }
+    sqlite3_busy_timeout(db, 100);
+    ret = cb(db);
+    sqlite3_close_v2(db);
+    return ret;
+}
+
+/*!> a file changed after the first stamp is seen by devskey_poll, so all loaders reload */
+static bool db_changed(void) {
+    struct stat st;
+
+    if (stat(DEVSKEY_DB_PATH, &st) != 0) {
+        if (!db_stamped)
+            lgw_log(LOG_WARNING, "%s[DEVSKEY] can't stat %s: %s\n", WARNMSG, DEVSKEY_DB_PATH, strerror(errno));
+        return false;
+    }
+    if (db_stamped && st.st_mtim.tv_sec == db_st.st_mtim.tv_sec && st.st_mtim.tv_nsec == db_st.st_mtim.tv_nsec &&
+        st.st_size == db_st.st_size && st.st_ino == db_st.st_ino)
+        return false;
+    db_st = st;
+    db_stamped = true;
+    return true;
+}
+
+int devskey_watch(devskey_load_cb cb) {
+    if (nb_loader == DEVSKEY_LOADER_NB)
+        return -1;
+    loaders[nb_loader++] = cb;
+
+    if (!db_stamped)
+        db_changed();
+    clock_gettime(CLOCK_MONOTONIC, &last_check);
+    return run_loader(cb);
+}
+
+void devskey_poll(void) {
+    struct timespec now;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if ((now.tv_sec - last_check.tv_sec) * 1000 + (now.tv_nsec - last_check.tv_nsec) / 1000000 < DEVSKEY_CHECK_MS)
+        return;
+    last_check = now;
+
+    if (nb_loader == 0 || !db_changed())
+        return;
+
+    for (i = 0; i < nb_loader; i++)
+        run_loader(loaders[i]);
+}
+
+int hex_digit(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+int hex_to_bin(const char* hex, uint8_t* bin, int len) {
+    int i, hi, lo;
+
+    for (i = 0; i < len; i++) {
+        hi = hex_digit(hex[2 * i]);
+        lo = hi < 0 ? -1 : hex_digit(hex[2 * i + 1]);
+        if (lo < 0)
+            return -1;
+        bin[i] = (uint8_t)(hi << 4 | lo);
+    }
+    return hex[2 * len] == '\0' ? 0 : -1;
+}
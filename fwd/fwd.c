@@ -54,6 +54,8 @@
 #include <getopt.h>
 #include <limits.h>
 #include <semaphore.h>
+#include <poll.h>
+#include <fcntl.h>
 
 #include "fwd.h"
 #include "parson.h"
@@ -64,6 +66,16 @@
 #include "stats.h"
 #include "timersync.h"
 #include "uart.h"
+#include "reactor.h"
+#include "timebase.h"
+#include "concent.h"
+#include "lbt.h"
+#include "relay_uart.h"
+#include "relay_fwd.h"
+#include "devinfo.h"
+#include "devskey.h"
+#include "pkt_filter.h"
+#include "wire_bin.h"
 
 #include "loragw_gps.h"
 #include "loragw_aux.h"
@@ -76,13 +88,16 @@ volatile bool quit_sig = false;	/*!> 1 -> application terminates without shuttin
 /*!> -------------------------------------------------------------------------- */
 /*!> --- privite DECLARATION ---------------------------------------- */
 
+static sem_t sem_main;                  /*!> posted by the reactor timers, taken by main loop */
+static bool report_pending = false;     /*!> report posted and not built yet */
+static bool timebase_pending = false;   /*!> counter sample posted and not taken yet */
+
 /*!> -------------------------------------------------------------------------- */
 /*!> --- PUBLIC DECLARATION ---------------------------------------- */
 
 uint32_t cur_hal_time = 0;
-int pthread_count = 0;
 
-pthread_mutex_t mx_pthread_count = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t mx_serv_sock = PTHREAD_MUTEX_INITIALIZER;   /*!> serialize service socket send and reconnect */
 
 // initialize GW
 INIT_GW;
@@ -168,16 +183,12 @@ void lgw_unregister_atexit(void (*func)(void))
 
 static void sig_handler(int sigio);
 
-static bool lbt_getchan_stat(int fd, uint32_t freq_hz, int8_t rssi_target, uint16_t scan_time_ms);
-
 /*!> threads */
 static void thread_up(void);
 static void thread_gps(void);
 static void thread_valid(void);
 static void thread_jit(void);
 static void thread_watchdog(void);
-static void thread_rxpkt_recycle(void);
-static void thread_lbt_scan(void);
 
 #ifdef SX1302MOD
 static void thread_spectral_scan(void);
@@ -234,6 +245,28 @@ void stop_clean_service(void) {
     LGW_LIST_TRAVERSE_SAFE_END;
 }
 
+/*!> reactor timer, the reports are built by the main loop so the reactor never waits on
+ *  the concentrator or the log. While a report is pending last_loop is left as is, the
+ *  watchdog then sees a stalled main loop as well as a stalled reactor */
+static void report_timer(void* arg) {
+    (void)arg;
+    if (__atomic_exchange_n(&report_pending, true, __ATOMIC_ACQ_REL))
+        return;
+    GW.cfg.last_loop = time(NULL);  // time of gateway last loop
+    sem_post(&sem_main);
+}
+
+#ifdef SX1302MOD
+/*!> reactor timer, the counter read waits for the concentrator behind fetches,
+ *  so the main loop takes the sample */
+static void timebase_timer(void* arg) {
+    (void)arg;
+    if (__atomic_exchange_n(&timebase_pending, true, __ATOMIC_ACQ_REL))
+        return;
+    sem_post(&sem_main);
+}
+#endif
+
 double difftimespec(struct timespec end, struct timespec beginning) {
     double x;
 
@@ -281,6 +314,27 @@ int get_tx_gain_lut_index(uint8_t rf_chain, int8_t rf_power, uint8_t * lut_index
     return 0;
 }
 
+/*!> rejected downlinks, counted in report of the service */
+static void tx_ack_count(serv_s* serv, enum jit_error_e error) {
+    switch (error) {
+        case JIT_ERROR_FULL:
+        case JIT_ERROR_COLLISION_PACKET:
+            STAT_INC(serv->report->stat_down.meas_nb_tx_rejected_collision_packet);
+            break;
+        case JIT_ERROR_TOO_LATE:
+            STAT_INC(serv->report->stat_down.meas_nb_tx_rejected_too_late);
+            break;
+        case JIT_ERROR_TOO_EARLY:
+            STAT_INC(serv->report->stat_down.meas_nb_tx_rejected_too_early);
+            break;
+        case JIT_ERROR_COLLISION_BEACON:
+            STAT_INC(serv->report->stat_down.meas_nb_tx_rejected_collision_beacon);
+            break;
+        default:
+            break;
+    }
+}
+
 int send_tx_ack(serv_s* serv, uint8_t token_h, uint8_t token_l, enum jit_error_e error, int32_t error_value) {
     uint8_t buff_ack[ACK_BUFF_SIZE]; /*!> buffer to give feedback to server */
     int buff_index;
@@ -290,7 +344,7 @@ int send_tx_ack(serv_s* serv, uint8_t token_h, uint8_t token_l, enum jit_error_e
     memset(&buff_ack, 0, sizeof buff_ack);
 
     /*!> Prepare downlink feedback to be sent to server */
-    buff_ack[0] = PROTOCOL_VERSION;
+    buff_ack[0] = WIRE_VERSION(serv->net->wire_format);
     buff_ack[1] = token_h;
     buff_ack[2] = token_l;
     buff_ack[3] = PKT_TX_ACK;
@@ -298,8 +352,12 @@ int send_tx_ack(serv_s* serv, uint8_t token_h, uint8_t token_l, enum jit_error_e
     *(uint32_t *)(buff_ack + 8) = GW.info.net_mac_l;
     buff_index = 12; /*!> 12-byte header */
 
+    tx_ack_count(serv, error);
+
     /*!> Put no JSON string if there is nothing to report */
-    if (error != JIT_ERROR_OK) {
+    if (error != JIT_ERROR_OK && serv->net->wire_format == WIRE_FORMAT_BIN) {
+        buff_index += wire_bin_txack_write(buff_ack + buff_index, (uint8_t)error, error == JIT_ERROR_TX_POWER ? error_value : 0);
+    } else if (error != JIT_ERROR_OK) {
         /*!> start of JSON structure */
         memcpy((void *)(buff_ack + buff_index), (void *)"{\"txpk_ack\":{", 13);
         buff_index += 13;
@@ -320,34 +378,18 @@ int send_tx_ack(serv_s* serv, uint8_t token_h, uint8_t token_l, enum jit_error_e
             case JIT_ERROR_COLLISION_PACKET:
                 memcpy((void *)(buff_ack + buff_index), (void *)"\"COLLISION_PACKET\"", 18);
                 buff_index += 18;
-                /*!> update stats */
-                pthread_mutex_lock(&serv->report->mx_report);
-                serv->report->stat_down.meas_nb_tx_rejected_collision_packet += 1;
-                pthread_mutex_unlock(&serv->report->mx_report);
                 break;
             case JIT_ERROR_TOO_LATE:
                 memcpy((void *)(buff_ack + buff_index), (void *)"\"TOO_LATE\"", 10);
                 buff_index += 10;
-                /*!> update stats */
-                pthread_mutex_lock(&serv->report->mx_report);
-                serv->report->stat_down.meas_nb_tx_rejected_too_late += 1;
-                pthread_mutex_unlock(&serv->report->mx_report);
                 break;
             case JIT_ERROR_TOO_EARLY:
                 memcpy((void *)(buff_ack + buff_index), (void *)"\"TOO_EARLY\"", 11);
                 buff_index += 11;
-                /*!> update stats */
-                pthread_mutex_lock(&serv->report->mx_report);
-                serv->report->stat_down.meas_nb_tx_rejected_too_early += 1;
-                pthread_mutex_unlock(&serv->report->mx_report);
                 break;
             case JIT_ERROR_COLLISION_BEACON:
                 memcpy((void *)(buff_ack + buff_index), (void *)"\"COLLISION_BEACON\"", 18);
                 buff_index += 18;
-                /*!> update stats */
-                pthread_mutex_lock(&serv->report->mx_report);
-                serv->report->stat_down.meas_nb_tx_rejected_collision_beacon += 1;
-                pthread_mutex_unlock(&serv->report->mx_report);
                 break;
             case JIT_ERROR_TX_FREQ:
                 memcpy((void *)(buff_ack + buff_index), (void *)"\"TX_FREQ\"", 9);
@@ -412,25 +454,107 @@ void print_tx_status(uint8_t tx_status) {
     }
 }
 
+void rxpkt_cursor_init(serv_s* serv) {
+    serv->rx.cursor = __atomic_load_n(&GW.rxpkts.head, __ATOMIC_ACQUIRE);
+    serv->rx.nb_lost = 0;
+}
+
+/*!> only one thread of a service call get_rxpkt, the ring is never locked.
+ *   bind is taken before checking slot seq, thread_up mark the slot busy
+ *   before checking bind, so a batch referenced is never rewritten.
+ */
 int get_rxpkt(serv_ct_s* serv_ct) {
-    int ret = 0;
+    uint32_t head, seq;
     rxpkts_s* rxpkt_entry;
     serv_s* serv = serv_ct->serv;
 
-    LGW_LIST_LOCK(&GW.rxpkts_list);
-    LGW_LIST_TRAVERSE(&GW.rxpkts_list, rxpkt_entry, list) {
+    serv_ct->batch = NULL;
+    serv_ct->rxpkt = NULL;
 
-        if (serv->info.stamp == (serv->info.stamp & rxpkt_entry->stamps))
+    while (1) {
+        head = __atomic_load_n(&GW.rxpkts.head, __ATOMIC_ACQUIRE);
+
+        if (serv->rx.cursor == head)
+            return 0;
+
+        if (head - serv->rx.cursor > RXPKTS_RING_SIZE) {    /*!> service too slow, skip overwritten batches */
+            serv->rx.nb_lost += head - serv->rx.cursor - RXPKTS_RING_SIZE;
+            lgw_log(LOG_WARNING, "%s[PKTS][%s] rxpkts ring overrun, lost %u batches\n", WARNMSG, serv->info.name, serv->rx.nb_lost);
+            serv->rx.cursor = head - RXPKTS_RING_SIZE;
+        }
+
+        rxpkt_entry = &GW.rxpkts.slot[serv->rx.cursor & (RXPKTS_RING_SIZE - 1)];
+
+        __atomic_add_fetch(&rxpkt_entry->bind, 1, __ATOMIC_SEQ_CST);
+        seq = __atomic_load_n(&rxpkt_entry->seq, __ATOMIC_SEQ_CST);
+
+        if (seq != serv->rx.cursor) {   /*!> rewritten or skipped by thread_up, try the next one */
+            __atomic_sub_fetch(&rxpkt_entry->bind, 1, __ATOMIC_RELEASE);
+            serv->rx.nb_lost++;
+            serv->rx.cursor++;
             continue;
-        
-        rxpkt_entry->stamps |= serv->info.stamp;
-        memcpy(serv_ct->rxpkt, rxpkt_entry->rxpkt, sizeof(struct lgw_pkt_rx_s) * rxpkt_entry->nb_pkt);
-        rxpkt_entry->bind--;
-        ret = rxpkt_entry->nb_pkt;
-        break;
+        }
+
+        serv->rx.cursor++;
+        serv_ct->batch = rxpkt_entry;
+        serv_ct->rxpkt = rxpkt_entry->rxpkt;
+        return rxpkt_entry->nb_pkt;
     }
-    LGW_LIST_UNLOCK(&GW.rxpkts_list);
-    return ret;
+}
+
+void put_rxpkt(serv_ct_s* serv_ct) {
+    if (serv_ct->batch == NULL)
+        return;
+    __atomic_sub_fetch(&serv_ct->batch->bind, 1, __ATOMIC_RELEASE);
+    serv_ct->batch = NULL;
+    serv_ct->rxpkt = NULL;
+}
+
+/*!> relay packets on if_chain 8 are handled once before publish, services
+ *   read the batch in place and must not modify it.
+ */
+static int relay_rxpkt_fixup(struct lgw_pkt_rx_s* rxpkt, int nb_pkt) {
+    int i, n = 0;
+    struct lgw_pkt_rx_s *p;
+    meta_type_t meta;
+    payload_type_t ptype;
+    uint8_t hop;
+
+    for (i = 0; i < nb_pkt; i++) {
+        p = &rxpkt[i];
+
+        if (p->if_chain == 8) { 
+
+            /*!> binary frames go on air as relay protocol packets, our downlink too */
+            if (GW.relay.frame == RELAY_FRAME_BIN && p->size > 0 &&
+                parse_mhdr(p->payload[0], &meta, &ptype, &hop) && meta == LORAWAN_TYPE) {
+                if (ptype != UPLINK_TYPE || !relay_fwd_uplink(p))
+                    continue;
+            } else {
+                if (GW.relay.as_relay) continue;  /*!> No need attention, otherwise loop */
+
+                if (p->payload[0] & RELAY_DN) continue;  /*!> RELAY_DN is myself downlink, haha! */
+
+                if (p->size < 5) continue;
+
+                /*!> Ooh! receive from RELAY */
+                lgw_log(LOG_DEBUG, "%s[RELAY] packet receive from relay! \n", DEBUGMSG);
+                p->count_us = (uint32_t)p->payload[1];
+                p->count_us |= (uint32_t)p->payload[2]<<8;
+                p->count_us |= (uint32_t)p->payload[3]<<16;
+                p->count_us |= (uint32_t)p->payload[4]<<24;
+                p->size -= 5;
+                memmove(p->payload, p->payload + 5, p->size);
+                lgw_memset(p->payload + p->size, 0, sizeof(p->payload) - p->size);
+            }
+        }
+
+        if (n != i)
+            memcpy(&rxpkt[n], p, sizeof(struct lgw_pkt_rx_s));
+        n++;
+    }
+
+    return n;
 }
 
 /*!> -------------------------------------------------------------------------- */
@@ -438,17 +562,21 @@ int get_rxpkt(serv_ct_s* serv_ct) {
 
 int main(int argc, char *argv[]) {
     int i;						/*!> loop variable and temporary variable for return value */
+    int report_tid = -1;        /*!> reactor timer of statistics report */
+    int timebase_tid = -1;      /*!> reactor timer of concentrator counter sampling */
+    struct timespec report_wake; /*!> main loop wakes up at least each second */
     struct sigaction sigact;	/*!> SIGQUIT&SIGINT&SIGTERM signal handling */
+    pthread_condattr_t cattr;   /*!> clock of jit wake up */
 
     //serv_s* serv_entry = NULL;  
 
     /*!> threads */
     pthread_t thrid_up;
-    pthread_t thrid_recycle;
     pthread_t thrid_gps;
     pthread_t thrid_valid;
     pthread_t thrid_jit;
     pthread_t thrid_lbt_scan;
+    pthread_t thrid_relay;
 #ifdef SX1302MOD
     pthread_t thrid_ss;
 #endif
@@ -504,6 +632,9 @@ int main(int argc, char *argv[]) {
         exit(EXIT_FAILURE);
     }
 
+    /*!> uplink filters of the services, compiled before any packet is received, reloaded by devskey_poll */
+    pkt_filter_init();
+
     if (access(GW.hal.confs.gwcfg, R_OK) == 0 && access(GW.hal.confs.sxcfg, R_OK) == 0) { /*!> if there is a global conf, parse it  */
         if (parsecfg()) {
             lgw_log(LOG_ERROR, "%s[FWD] failed to parse configuration file\n", ERRMSG);
@@ -627,6 +758,14 @@ int main(int argc, char *argv[]) {
             snprintf(buffer, sizeof(buffer), "ATZ\r\n"); 
             if (uart_send(GW.relay.tty_fd, buffer, strlen(buffer) + 1) == -1) 
                 lgw_log(LOG_ERROR, "%s[RELAY] AT ATZ of relay channel (cannot send command to uart)\n", ERRMSG);
+
+            if (lgw_pthread_create(&thrid_relay, NULL, (void *(*)(void *))thread_relay_fwd, NULL)) {
+                lgw_log(LOG_ERROR, "%s[FWD] impossible to create relay thread\n", ERRMSG);
+                uart_close(GW.relay.tty_fd);
+                GW.relay.tty_fd = -1;
+                GW.relay.as_relay = false;
+                GW.relay.has_relay = false;
+            }
         } else {
             GW.relay.as_relay = false;
             GW.relay.has_relay = false;
@@ -637,6 +776,12 @@ int main(int argc, char *argv[]) {
     /*!> get timezone info */
     tzset();
 
+    /*!> network event loop, services hand it their sockets and timers */
+    if (reactor_start()) {
+        lgw_log(LOG_ERROR, "%s[FWD] failed to start network reactor\n", ERRMSG);
+        exit(EXIT_FAILURE);
+    }
+
     service_start();
 
     while (GW.info.service_count == 0) {
@@ -655,6 +800,9 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    /*!> reactor timers hand their blocking work to the main loop */
+    sem_init(&sem_main, 0, 0);
+
     /*!> starting the concentrator */
     if (GW.cfg.radiostream_enabled == true) {
         lgw_log(LOG_INFO, "%s[FWD] Starting the concentrator\n", INFOMSG);
@@ -668,6 +816,13 @@ int main(int argc, char *argv[]) {
         if (i == LGW_HAL_SUCCESS) {
             lgw_db_put("loraradio", "radiostream", "running");
             lgw_log(LOG_INFO, "%s[FWD] concentrator started, radio packets can now be received.\n", INFOMSG);
+#ifdef SX1302MOD
+            /*!> counter readers use the time base instead of the SPI bus */
+            timebase_sample();
+            timebase_tid = reactor_add_timer(TIMEBASE_SAMPLE_MS, timebase_timer, NULL);
+            if (timebase_tid == -1)
+                lgw_log(LOG_WARNING, "%s[FWD] impossible to add time base timer, counter is resampled by readers\n", WARNMSG);
+#endif
         } else {
             lgw_db_put("loraradio", "radiostream", "hangup");
             lgw_log(LOG_ERROR, "%s[FWD] failed to start the concentrator\n", ERRMSG);
@@ -692,15 +847,16 @@ int main(int argc, char *argv[]) {
     else
         lgw_db_put("thread", "thread_up", "running");
 
-    if (lgw_pthread_create(&thrid_recycle, NULL, (void *(*)(void *))thread_rxpkt_recycle, NULL))
-        lgw_log(LOG_ERROR, "%s[FWD] impossible to create rxpkt recycle thread\n", ERRMSG);
-    else
-        lgw_db_put("thread", "thread_rxpkt_recycle", "running");
-
     /*!> JIT queue initialization */
     jit_queue_init(&GW.tx.jit_queue[0]);
     jit_queue_init(&GW.tx.jit_queue[1]);
 
+    /*!> jit thread sleeps until queued deadlines, mapped on the monotonic clock */
+    pthread_condattr_init(&cattr);
+    pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+    pthread_cond_init(&GW.jit.cd_wake, &cattr);
+    pthread_condattr_destroy(&cattr);
+
     // Timer synchronization needed for downstream ...
 #ifdef SX1301MOD
     if (lgw_pthread_create(&thrid_timersync, NULL, (void *(*)(void *))thread_timersync, NULL))
@@ -761,18 +917,29 @@ int main(int argc, char *argv[]) {
 
     //lgw_register_atexit(stop_clean_service);
 
-    /*!> main loop task : statistics transmission */
-    while (!exit_sig && !quit_sig) {
-        GW.cfg.last_loop = time(NULL);  // time of gateway last loop
+    /*!> statistics transmission on each report interval, the watchdog checks the reactor is alive */
+    report_tid = reactor_add_timer(GW.cfg.time_interval * 1000, report_timer, NULL);
+    if (report_tid == -1)
+        lgw_log(LOG_ERROR, "%s[FWD] impossible to add report timer\n", ERRMSG);
 
-        /*!> wait for next reporting interval */
-        wait_ms(GW.cfg.time_interval*1000);
+    /*!> ABP keys for mac decode, kept in memory and reloaded by devskey_poll */
+    if (GW.cfg.mac_decode)
+        devinfo_init();
 
-        if (exit_sig || quit_sig) {
-            break;
+    /*!> main loop task : counter sampling, statistics report, devskey database reload, wait for exit signal */
+    while (!exit_sig && !quit_sig) {
+        clock_gettime(CLOCK_REALTIME, &report_wake);
+        report_wake.tv_sec += 1;
+        if (sem_timedwait(&sem_main, &report_wake) == 0 && !exit_sig && !quit_sig) {
+            if (__atomic_exchange_n(&timebase_pending, false, __ATOMIC_ACQ_REL))
+                timebase_sample();
+            if (__atomic_load_n(&report_pending, __ATOMIC_ACQUIRE)) {
+                report_start();
+                __atomic_store_n(&report_pending, false, __ATOMIC_RELEASE);
+            }
         }
-        // Create statistics report
-        report_start();
+
+        devskey_poll();
 
         /*!> Exit strategies. */
         /*!> Server that are 'off-line may be a reason to exit */
@@ -791,9 +958,6 @@ int main(int argc, char *argv[]) {
     if ((i = pthread_join(thrid_up, NULL)) != 0)
         lgw_log(LOG_ERROR, "%s[FWD] failed to join data up thread with %d - %s\n", ERRMSG, i, strerror(errno));
 
-    if ((i = pthread_join(thrid_recycle, NULL)) != 0)
-        lgw_log(LOG_ERROR, "%s[FWD] failed to join recycle thread with %d - %s\n", ERRMSG, i, strerror(errno));
-
     if (GW.gps.gps_enabled == true) {
         pthread_cancel(thrid_gps);	        /*!> don't wait for GPS thread */
         if (GW.gps.time_ref == true)
@@ -819,13 +983,28 @@ int main(int argc, char *argv[]) {
 #endif
 
     if (GW.lbt.lbt_tty_enabled) {
-        pthread_cancel(thrid_lbt_scan);	    /*!> don't wait for timer sync thread */
+        lbt_stop();
+        if ((i = pthread_join(thrid_lbt_scan, NULL)) != 0)
+            lgw_log(LOG_ERROR, "%s[FWD] failed to join LBT scan thread with %d - %s\n", ERRMSG, i, strerror(errno));
     }
 
+    reactor_del_timer(report_tid);     /*!> no report while services are released */
+    if (timebase_tid != -1)
+        reactor_del_timer(timebase_tid);
+
     stop_clean_service();
 
-    if (GW.relay.tty_fd > 0)
+    reactor_stop();
+
+    if (GW.relay.tty_fd != -1) {
+        relay_fwd_stop();
+        if ((i = pthread_join(thrid_relay, NULL)) != 0)
+            lgw_log(LOG_ERROR, "%s[FWD] failed to join relay thread with %d - %s\n", ERRMSG, i, strerror(errno));
         uart_close(GW.relay.tty_fd);
+    }
+
+    devinfo_free();
+    pkt_filter_free();
 
     lgw_run_atexits(1);
 
@@ -854,6 +1033,41 @@ int main(int argc, char *argv[]) {
 /*!> -------------------------------------------------------------------------- */
 /*!> --- THREAD 1: RECEIVING PACKETS AND FORWARDING THEM ---------------------- */
 
+/*!> idle wait of thread_up, return at once on edge of RX irq gpio if any */
+static void fetch_wait(int irq_fd, int timeout_ms) {
+    struct pollfd pfd;
+    char value;
+
+    if (irq_fd < 0) {
+        wait_ms(timeout_ms);
+        return;
+    }
+
+    pfd.fd = irq_fd;
+    pfd.events = POLLPRI | POLLERR;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, timeout_ms) > 0) {
+        lseek(irq_fd, 0, SEEK_SET);     /*!> read value to acknowledge the edge */
+        if (read(irq_fd, &value, 1) < 0)
+            wait_ms(timeout_ms);
+    }
+}
+
+static void fetch_hist_update(struct timespec* since, struct timespec* now) {
+    static const int bound_ms[FETCH_HIST_NB - 1] = {1, 2, 5, 10, 20};
+    double lat_ms = 1000 * difftimespec(*now, *since);
+    int i;
+
+    for (i = 0; i < FETCH_HIST_NB - 1; i++) {
+        if (lat_ms < bound_ms[i])
+            break;
+    }
+
+    pthread_mutex_lock(&GW.fetch.mx_hist);
+    GW.fetch.lat_hist[i]++;
+    pthread_mutex_unlock(&GW.fetch.mx_hist);
+}
+
 static void thread_up(void) {
 
     /*!> allocate memory for packet fetching and processing */
@@ -863,24 +1077,41 @@ static void thread_up(void) {
 
     rxpkts_s *rxpkt_entry = NULL;
     serv_s* serv_entry = NULL;
+    uint32_t head;
+    int nb_skip, wait;
 
+    /*!> fetch scheduler */
+    int sleep_ms = GW.fetch.min_sleep_ms;
+    int irq_fd = -1;
+    struct timespec last_fetch;     /*!> end of previous fetch, packets can wait since then */
+    struct timespec fetch_time;
 
     lgw_log(LOG_INFO, "%s[THREAD][fwd-UP] Start...\n", INFOMSG);
 
+    if (GW.fetch.irq_gpio[0] != '\0') {
+        irq_fd = open(GW.fetch.irq_gpio, O_RDONLY);
+        if (irq_fd < 0)
+            lgw_log(LOG_WARNING, "%s[fwd-UP] can't open irq gpio %s (%s), polling only\n", WARNMSG, GW.fetch.irq_gpio, strerror(errno));
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &last_fetch);
+
     while (!exit_sig && !quit_sig) {
 
         /*!> fetch packets */
+        clock_gettime(CLOCK_MONOTONIC, &fetch_time);
 
         if (GW.cfg.radiostream_enabled == true) {
-            pthread_mutex_lock(&GW.hal.mx_concent);
+            concent_lock(CONCENT_FETCH);
             nb_pkt = lgw_receive(NB_PKT_MAX, rxpkt);
-            pthread_mutex_unlock(&GW.hal.mx_concent);
+            concent_unlock();
         } else {
             nb_pkt = 0;
         }
 
         if (nb_pkt == LGW_HAL_ERROR) {
             lgw_log(LOG_ERROR, "%s[fwd-UP] HAL receive failed, try restart HAL\n", ERRMSG);
+            nb_pkt = 0;
             //exit(EXIT_FAILURE);
         }
 
@@ -890,32 +1121,61 @@ static void thread_up(void) {
         if (GW.cfg.delay_enabled == true)
             nb_pkt = delay_pkt_get(10 - nb_pkt, &rxpkt[nb_pkt]) + nb_pkt;
 
+        if (nb_pkt > 0 && (GW.relay.as_relay || GW.relay.has_relay))
+            nb_pkt = relay_rxpkt_fixup(rxpkt, nb_pkt);
+
         /*!> wait a short time if no packets, nor status report */
         if (nb_pkt == 0) {
-            wait_ms(DEFAULT_FETCH_SLEEP_MS);
+            clock_gettime(CLOCK_MONOTONIC, &last_fetch);
+            if (GW.fetch.adaptive) {
+                fetch_wait(irq_fd, sleep_ms);
+                sleep_ms = (sleep_ms * 2 > GW.fetch.max_sleep_ms) ? GW.fetch.max_sleep_ms : sleep_ms * 2;
+            } else {
+                fetch_wait(irq_fd, GW.fetch.max_sleep_ms);
+            }
             continue;
         }
 
+        fetch_hist_update(&last_fetch, &fetch_time);
+        clock_gettime(CLOCK_MONOTONIC, &last_fetch);
+        sleep_ms = GW.fetch.min_sleep_ms;
+
         //lastest_us = rxpkt[0].count_us;
 
-        rxpkt_entry = lgw_malloc(sizeof(rxpkts_s));     //rxpkts结构体包含有一个lora_pkt_rx_s结构数组
+        /*!> thread_up is the only writer of the ring, overwrite the oldest slot.
+         *  A service still holding it (queued or serializing) gets RXPKTS_BIND_WAIT_MS to
+         *  release it, then the slot is skipped: its seq stays busy, readers pass over it */
+        head = GW.rxpkts.head;
+        for (nb_skip = 0; nb_skip < RXPKTS_RING_SIZE; nb_skip++) {
+            rxpkt_entry = &GW.rxpkts.slot[head & (RXPKTS_RING_SIZE - 1)];
+
+            __atomic_store_n(&rxpkt_entry->seq, RXPKTS_SEQ_BUSY, __ATOMIC_SEQ_CST);
+
+            for (wait = 0; wait < RXPKTS_BIND_WAIT_MS && __atomic_load_n(&rxpkt_entry->bind, __ATOMIC_SEQ_CST) > 0; wait++)
+                wait_ms(1);
+            if (__atomic_load_n(&rxpkt_entry->bind, __ATOMIC_SEQ_CST) == 0)
+                break;
+
+            head++;
+            __atomic_store_n(&GW.rxpkts.head, head, __ATOMIC_RELEASE);
+            STAT_INC(GW.rxpkts.nb_skip);
+        }
 
-        if (NULL == rxpkt_entry) {
+        if (nb_skip == RXPKTS_RING_SIZE) {
+            lgw_log(LOG_WARNING, "%s[fwd-UP] every rxpkts slot held by a service, %d packets dropped\n", WARNMSG, nb_pkt);
             continue;
         }
+        if (nb_skip > 0)
+            lgw_log(LOG_WARNING, "%s[fwd-UP] %d rxpkts slots still held by a service, skipped\n", WARNMSG, nb_skip);
 
-        rxpkt_entry->list.next = NULL;
         rxpkt_entry->entry_us = cur_hal_time;
-        rxpkt_entry->stamps = 0;
         rxpkt_entry->nb_pkt = nb_pkt;
-        rxpkt_entry->bind = GW.info.service_count;
         memcpy(rxpkt_entry->rxpkt, rxpkt, sizeof(struct lgw_pkt_rx_s) * nb_pkt);
 
-        LGW_LIST_LOCK(&GW.rxpkts_list);
-        LGW_LIST_INSERT_TAIL(&GW.rxpkts_list, rxpkt_entry, list);
-        LGW_LIST_UNLOCK(&GW.rxpkts_list);
+        __atomic_store_n(&rxpkt_entry->seq, head, __ATOMIC_RELEASE);
+        __atomic_store_n(&GW.rxpkts.head, head + 1, __ATOMIC_RELEASE);
 
-        lgw_log(LOG_DEBUG, "%s[fwd-UP] Size of package list is %d\n", DEBUGMSG, GW.rxpkts_list.size);
+        lgw_log(LOG_DEBUG, "%s[fwd-UP] rxpkts ring head is %u\n", DEBUGMSG, head + 1);
             
         LGW_LIST_TRAVERSE(&GW.serv_list, serv_entry, list) {
             if (sem_post(&serv_entry->thread.sema)) {
@@ -923,77 +1183,111 @@ static void thread_up(void) {
             }
         }
 
-        wait_ms(DEFAULT_FETCH_SLEEP_MS);
+        /*!> adaptive: the RX buffer may hold more packets, fetch again at once */
+        if (!GW.fetch.adaptive)
+            wait_ms(GW.fetch.max_sleep_ms);
 
     }
 
+    if (irq_fd >= 0)
+        close(irq_fd);
+
     lgw_log(LOG_INFO, "%s[THREAD][fwd-UP] Ended!\n", INFOMSG);
 }
 
 /*!> -------------------------------------------------------------------------- */
-/*!> --- THREAD : recycle rxpkts --------------------- */
-
-static void thread_rxpkt_recycle(void) {
-    int time_ms = 1000;  
-    int deal = 0;
+/*!> --- THREAD 3: CHECKING PACKETS TO BE SENT FROM JIT QUEUE AND SEND THEM --- */
 
-    rxpkts_s* rxpkt_entry = NULL;
-    serv_s* serv_entry = NULL;
+/*!> the deadlines of the queued packets are kept here, under mx_wake, jitqueue
+ *  does not expose its nodes nor its lock. A packet enqueued without jit_notify
+ *  is still sent, found by a scan within JIT_IDLE_WAIT_MS */
+void jit_notify(uint8_t rf_chain, uint32_t count_us) {
+    pthread_mutex_lock(&GW.jit.mx_wake);
+    if (rf_chain < LGW_RF_CHAIN_NB && GW.jit.nb_due[rf_chain] < JIT_QUEUE_MAX)
+        GW.jit.due[rf_chain][GW.jit.nb_due[rf_chain]++] = count_us;
+    GW.jit.kick = true;
+    pthread_cond_signal(&GW.jit.cd_wake);
+    pthread_mutex_unlock(&GW.jit.mx_wake);
+}
 
-    lgw_log(LOG_INFO, "%s[THREAD][RECYCLE] Starting...\n", INFOMSG);
+static void jit_hist_update(int32_t late_us) {
+    static const int32_t bound_us[JIT_HIST_NB - 1] = {1000, 2000, 5000, 10000, 20000};
+    int i;
 
-    while (!exit_sig && !quit_sig) {
-
-        wait_ms(time_ms);
+    for (i = 0; i < JIT_HIST_NB - 1; i++) {
+        if (late_us < bound_us[i])
+            break;
+    }
 
-        if (GW.rxpkts_list.size > 1) {   
-            LGW_LIST_TRAVERSE(&GW.serv_list, serv_entry, list) {
-                if (sem_post(&serv_entry->thread.sema))
-                    lgw_log(LOG_DEBUG, "%s[%s-recycle] post sema: %s\n", DEBUGMSG, serv_entry->info.name, strerror(errno));
-            }
-        }
+    pthread_mutex_lock(&GW.jit.mx_hist);
+    GW.jit.late_hist[i]++;
+    pthread_mutex_unlock(&GW.jit.mx_hist);
+}
 
-        if (GW.rxpkts_list.size > DEFAULT_RXPKTS_LIST_SIZE) {   
+/*!> forget the deadline of a packet that left the queue, under mx_wake */
+static void jit_due_del(int rf_chain, int k) {
+    GW.jit.due[rf_chain][k] = GW.jit.due[rf_chain][--GW.jit.nb_due[rf_chain]];
+}
 
-            deal = 0;
+/*!> a packet dequeued from rf_chain no longer has a deadline */
+static void jit_due_done(int rf_chain, uint32_t count_us) {
+    int k;
 
-            LGW_LIST_LOCK(&GW.rxpkts_list);
-            LGW_LIST_TRAVERSE_SAFE_BEGIN(&GW.rxpkts_list, rxpkt_entry, list) {
-                /*!> 16s = 2 * rxwindows + N */
-                if ((cur_hal_time - rxpkt_entry->entry_us > 16000000) || (rxpkt_entry->bind < 1)) {
-                    LGW_LIST_REMOVE_CURRENT(list);
-                    lgw_free(rxpkt_entry);
-                    GW.rxpkts_list.size--;
-                    deal++;
-                }
-            }
-            LGW_LIST_TRAVERSE_SAFE_END;
-            LGW_LIST_UNLOCK(&GW.rxpkts_list);
-            lgw_log(LOG_DEBUG, "%s[RECYCLE]  recycle deal(=%d), remain(=%d)\n", DEBUGMSG, deal, GW.rxpkts_list.size);
+    pthread_mutex_lock(&GW.jit.mx_wake);
+    for (k = 0; k < GW.jit.nb_due[rf_chain]; k++) {
+        if (GW.jit.due[rf_chain][k] == count_us) {
+            jit_due_del(rf_chain, k);
+            break;
         }
+    }
+    pthread_mutex_unlock(&GW.jit.mx_wake);
+}
 
-        if (GW.rxpkts_list.size > MAX_RXPKTS_LIST_SIZE) {   
-            deal = 0;
-            LGW_LIST_LOCK(&GW.rxpkts_list);
-            LGW_LIST_TRAVERSE_SAFE_BEGIN(&GW.rxpkts_list, rxpkt_entry, list) {
-                if ((cur_hal_time - rxpkt_entry->entry_us > 12000000) || (rxpkt_entry->bind < 1)) {
-                    LGW_LIST_REMOVE_CURRENT(list);
-                    lgw_free(rxpkt_entry);
-                    GW.rxpkts_list.size--;
-                    deal++;
-                }
+/*!> us from time_us until jit_peek hands out the earliest notified packet, JIT_IDLE_WAIT_MS at most.
+ *  A deadline passed at the scan of time_us on a queue that gave nothing is gone, jit_peek
+ *  dropped that packet as too late */
+static int32_t jit_next_deadline(uint32_t time_us, const bool dequeued[LGW_RF_CHAIN_NB]) {
+    int32_t next_us = JIT_IDLE_WAIT_MS * 1000;
+    int32_t d;
+    int i, k;
+
+    pthread_mutex_lock(&GW.jit.mx_wake);
+    for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
+        for (k = 0; k < GW.jit.nb_due[i]; k++) {
+            d = (int32_t)(GW.jit.due[i][k] - JIT_PEEK_WINDOW_US - time_us);
+            if (d < 0 && !dequeued[i]) {
+                jit_due_del(i, k--);
+                continue;
             }
-            LGW_LIST_TRAVERSE_SAFE_END;
-            LGW_LIST_UNLOCK(&GW.rxpkts_list);
-            lgw_log(LOG_DEBUG, "%s[RECYCLE] remove entry_us > 12s, deal(=%d), remain(=%d)\n", DEBUGMSG, deal, GW.rxpkts_list.size);
+            if (d < next_us)
+                next_us = d;
         }
     }
+    pthread_mutex_unlock(&GW.jit.mx_wake);
 
-    lgw_log(LOG_INFO, "%s[THREAD][RECYCLE] Ended!\n", INFOMSG);
+    return next_us;
+}
+
+/*!> sleep until from + wait_us on the monotonic clock, or until jit_notify */
+static void jit_wait(const struct timespec* from, int32_t wait_us) {
+    struct timespec wake = *from;
+
+    wake.tv_sec += wait_us / 1000000;
+    wake.tv_nsec += (long)(wait_us % 1000000) * 1000;
+    if (wake.tv_nsec >= 1000000000) {
+        wake.tv_sec += 1;
+        wake.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&GW.jit.mx_wake);
+    while (!GW.jit.kick && !exit_sig && !quit_sig) {
+        if (pthread_cond_timedwait(&GW.jit.cd_wake, &GW.jit.mx_wake, &wake) == ETIMEDOUT)
+            break;
+    }
+    GW.jit.kick = false;
+    pthread_mutex_unlock(&GW.jit.mx_wake);
 }
 
-/*!> -------------------------------------------------------------------------- */
-/*!> --- THREAD 3: CHECKING PACKETS TO BE SENT FROM JIT QUEUE AND SEND THEM --- */
 static void thread_jit(void) {
     int result = LGW_HAL_SUCCESS;
     struct lgw_pkt_tx_s pkt;
@@ -1002,28 +1296,36 @@ static void thread_jit(void) {
     enum jit_pkt_type_e pkt_type;
     uint8_t tx_status;
     bool chanisfree = true;
-    bool matching = false;   //匹配lbt查找
-    int i, j;
+    uint32_t lbt_freq_hz;       /*!> frequency the LBT slot was scheduled with, before beacon correction */
+    bool dequeued[LGW_RF_CHAIN_NB];
+    int nb_dequeued;
+    bool status_ok;
+    int32_t next_us;
+    struct timespec scan_time;  /*!> monotonic time of the cur_hal_time reading */
+    int i;
 
     lgw_log(LOG_INFO, "%s[THREAD][JIT] starting...\n", INFOMSG);
 
     while (!exit_sig && !quit_sig) {
-        wait_ms(10);
+        /*!> one counter value per scan, mapped to the monotonic clock for the next wake up */
+        timebase_now(&cur_hal_time);
+        clock_gettime(CLOCK_MONOTONIC, &scan_time);
+        memset(dequeued, 0, sizeof(dequeued));
+        nb_dequeued = 0;
 
         for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
             /*!> transfer data and metadata to the concentrator, and schedule TX */
-#ifdef SX1302MOD
-            pthread_mutex_lock(&GW.hal.mx_concent);
-            lgw_get_instcnt(&cur_hal_time);
-            pthread_mutex_unlock(&GW.hal.mx_concent);
-#else
-            get_concentrator_time(&cur_hal_time);
-#endif
             jit_result = jit_peek(&GW.tx.jit_queue[i], cur_hal_time, &pkt_index);
             if (jit_result == JIT_ERROR_OK) {
                 if (pkt_index > -1) {
                     jit_result = jit_dequeue(&GW.tx.jit_queue[i], pkt_index, &pkt, &pkt_type);
                     if (jit_result == JIT_ERROR_OK) {
+                        dequeued[i] = true;
+                        nb_dequeued++;
+                        jit_due_done(i, pkt.count_us);
+                        lbt_freq_hz = pkt.freq_hz;
+                        jit_hist_update((int32_t)(cur_hal_time - (pkt.count_us - JIT_PEEK_WINDOW_US)));
+
                         /*!> update beacon stats */
                         if (pkt_type == JIT_PKT_TYPE_BEACON) {
                             /*!> Compensate breacon frequency with xtal error */
@@ -1033,70 +1335,62 @@ static void thread_jit(void) {
                             pthread_mutex_unlock(&GW.hal.mx_xcorr);
 
                             /*!> Update statistics */
-                            pthread_mutex_lock(&GW.log.mx_report);
-                            GW.beacon.meas_nb_beacon_sent += 1;
-                            pthread_mutex_unlock(&GW.log.mx_report);
+                            STAT_INC(GW.beacon.meas_nb_beacon_sent);
                             lgw_log(LOG_INFO, "%s[JIT] Beacon dequeued (count_us=%u)\n", INFOMSG, pkt.count_us);
                         }
 
-                        /*!> check if concentrator is free for sending new packet */
-                        pthread_mutex_lock(&GW.hal.mx_concent); /*!> may have to wait for a fetch to finish */
-                        result = lgw_status(pkt.rf_chain, TX_STATUS, &tx_status);
-                        pthread_mutex_unlock(&GW.hal.mx_concent); /*!> free concentrator ASAP */
-                        if (result == LGW_HAL_ERROR) {
-                            lgw_log(LOG_WARNING, "%s[JIT] jit_queue[%d] lgw_status failed\n", WARNMSG, i);
-                        } else {
-                            if (tx_status == TX_EMITTING) {
-                                //lgw_log(LOG_ERROR, "%s[JIT] concentrator is currently emitting on rf_chain %d\n", i);
-                                print_tx_status(tx_status);
-                                continue;
-                            } else if (tx_status == TX_SCHEDULED) {
-                                //lgw_log(LOG_WARNING, "%s[JIT] a downlink was already scheduled on rf_chain %d, overwritting it...\n", i);
-                                print_tx_status(tx_status);
-                            } else {
-                                /*!> Nothing to do */
-                            }
-                        }
-
-                        /*!> send packet to concentrator */
+                        /*!> LBT verdict first, status and send then go in one TX lane access */
                         if (GW.lbt.lbt_tty_enabled) {
-                            matching = false;
-                            for (j = 0; j < NB_LBT_QUEUE; j++) {
-                                if (pkt.count_us == GW.lbt.lbt_stat[j].count_us) { 
-                                    chanisfree = GW.lbt.lbt_stat[j].chan_is_free;
-                                    matching = true;
+                            switch (lbt_verdict(pkt.rf_chain, pkt.count_us, lbt_freq_hz)) {
+                                case LBT_FREE:
+                                    chanisfree = true;
+                                    break;
+                                case LBT_BUSY:
+                                    chanisfree = false;
+                                    break;
+                                default:
+                                    lgw_log(LOG_WARNING, "%s[LBT] no verdict for count_us=%u freq=%u, not sent\n", WARNMSG, pkt.count_us, pkt.freq_hz);
+                                    chanisfree = false;
                                     break;
-                                }
-                            }
-                            if (!matching) {
-                                lgw_log(LOG_DEBUG, "%s[LBT] time not matching\n", DEBUGMSG);
-                                chanisfree = false;
                             }
                         }
 
+                        /*!> status check, upload and trigger in one TX lane access,
+                         *  no fetch or scan can slip in before the send */
+                        concent_lock(CONCENT_TX);
+                        result = lgw_status(pkt.rf_chain, TX_STATUS, &tx_status);
+                        status_ok = result != LGW_HAL_ERROR;
+                        if (status_ok && tx_status == TX_EMITTING) {
+                            concent_unlock();
+                            //lgw_log(LOG_ERROR, "%s[JIT] concentrator is currently emitting on rf_chain %d\n", i);
+                            print_tx_status(tx_status);
+                            continue;
+                        }
                         if (chanisfree) {
-                            pthread_mutex_lock(&GW.hal.mx_concent); /*!> may have to wait for a fetch to finish */
-                            result = lgw_send(&pkt);
-                            pthread_mutex_unlock(&GW.hal.mx_concent); /*!> free concentrator ASAP */
+                            result = lgw_tx_prepare(&pkt);
+                            if (result == LGW_HAL_SUCCESS)
+                                result = lgw_tx_arm(pkt.rf_chain);
                         } else {
                             result = LGW_LBT_ISSUE;
                         }
+                        concent_unlock();
+
+                        if (!status_ok) {
+                            lgw_log(LOG_WARNING, "%s[JIT] jit_queue[%d] lgw_status failed\n", WARNMSG, i);
+                        } else if (tx_status == TX_SCHEDULED) {
+                            //lgw_log(LOG_WARNING, "%s[JIT] a downlink was already scheduled on rf_chain %d, overwritting it...\n", i);
+                            print_tx_status(tx_status);
+                        }
 
                         if (result == LGW_HAL_ERROR) {
-                            pthread_mutex_lock(&GW.log.mx_report);
-                            GW.log.stat_dw.meas_nb_tx_fail += 1;
-                            pthread_mutex_unlock(&GW.log.mx_report);
-                            lgw_log(LOG_INFO, "%s[JIT] lgw_send failed on rf_chain %d\n", WARNMSG, i);
+                            STAT_INC(GW.log.stat_dw.meas_nb_tx_fail);
+                            lgw_log(LOG_INFO, "%s[JIT] TX prepare or arm failed on rf_chain %d\n", WARNMSG, i);
                             continue;
                         } else if (result == LGW_LBT_ISSUE) {
-                            pthread_mutex_lock(&GW.log.mx_report);
-                            GW.log.stat_dw.meas_nb_tx_fail += 1;
-                            pthread_mutex_unlock(&GW.log.mx_report);
-                            lgw_log(LOG_INFO, "%s[JIT] lgw_send failed, chan(%d) unaviable(lbt) \n", WARNMSG, pkt.freq_hz);
+                            STAT_INC(GW.log.stat_dw.meas_nb_tx_fail);
+                            lgw_log(LOG_INFO, "%s[JIT] TX failed, chan(%d) unaviable(lbt) \n", WARNMSG, pkt.freq_hz);
                         } else {
-                            pthread_mutex_lock(&GW.log.mx_report);
-                            GW.log.stat_dw.meas_nb_tx_ok += 1;
-                            pthread_mutex_unlock(&GW.log.mx_report);
+                            STAT_INC(GW.log.stat_dw.meas_nb_tx_ok);
                             lgw_log(LOG_INFO, "%s[JIT] send done on rf_chain %d in count_us=%u with freq=%u, SF%u\n", INFOMSG, i, pkt.count_us, pkt.freq_hz, pkt.datarate);
                         }
                     } else {
@@ -1109,6 +1403,15 @@ static void thread_jit(void) {
                 lgw_log(LOG_ERROR, "%s[JIT] jit_peek failed on rf_chain %d with %d\n", ERRMSG, i, jit_result);
             }
         }
+
+        /*!> rescan at once while packets leave the queues, a deadline that gave
+         *  nothing (counter drift) is retried 1 ms later */
+        next_us = jit_next_deadline(cur_hal_time, dequeued);
+        if (nb_dequeued > 0 && next_us <= 0)
+            continue;
+        if (next_us < 1000)
+            next_us = 1000;
+        jit_wait(&scan_time, next_us);
     }
 
     lgw_log(LOG_INFO, "%s[THREAD][JIT] ENDED!\n", INFOMSG);
@@ -1131,9 +1434,9 @@ static void gps_process_sync(void) {
     }
 
     /*!> get timestamp captured on PPM pulse  */
-    pthread_mutex_lock(&GW.hal.mx_concent);
+    concent_lock(CONCENT_COUNTER);
     i = lgw_get_trigcnt(&trig_tstamp);
-    pthread_mutex_unlock(&GW.hal.mx_concent);
+    concent_unlock();
     if (i != LGW_HAL_SUCCESS) {
         lgw_log(LOG_TIMERSYNC, "%s[GPS] failed to read concentrator timestamp\n", WARNMSG);
         return;
@@ -1398,7 +1701,7 @@ static void thread_spectral_scan(void) {
         spectral_scan_started = false;
 
         /*!> Start spectral scan (if no downlink programmed) */
-        pthread_mutex_lock(&GW.hal.mx_concent);
+        concent_lock(CONCENT_SCAN);
         /*!> -- Check if there is a downlink programmed */
         for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
             if (GW.tx.tx_enable[i] == true) {
@@ -1417,12 +1720,12 @@ static void thread_spectral_scan(void) {
             x = lgw_spectral_scan_start(freq_hz, GW.spectral_scan_params.nb_scan);
             if (x != 0) {
                 lgw_log(LOG_ERROR, "%s[SCAN] spectral scan start failed\n", ERRMSG);
-                pthread_mutex_unlock(&GW.hal.mx_concent);
+                concent_unlock();
                 continue; /*!> main while loop */
             }
             spectral_scan_started = true;
         }
-        pthread_mutex_unlock(&GW.hal.mx_concent);
+        concent_unlock();
 
         if (spectral_scan_started == true) {
             /*!> Wait for scan to be completed */
@@ -1436,9 +1739,9 @@ static void thread_spectral_scan(void) {
                 }
 
                 /*!> get spectral scan status */
-                pthread_mutex_lock(&GW.hal.mx_concent);
+                concent_lock(CONCENT_SCAN);
                 x = lgw_spectral_scan_get_status(&status);
-                pthread_mutex_unlock(&GW.hal.mx_concent);
+                concent_unlock();
                 if (x != 0) {
                     lgw_log(LOG_ERROR, "%s[SCAN] spectral scan status failed\n", ERRMSG);
                     break; /*!> do while */
@@ -1452,9 +1755,9 @@ static void thread_spectral_scan(void) {
                 /*!> Get spectral scan results */
                 memset(levels, 0, sizeof levels);
                 memset(results, 0, sizeof results);
-                pthread_mutex_lock(&GW.hal.mx_concent);
+                concent_lock(CONCENT_SCAN);
                 x = lgw_spectral_scan_get_results(levels, results);
-                pthread_mutex_unlock(&GW.hal.mx_concent);
+                concent_unlock();
                 if (x != 0) {
                     lgw_log(LOG_ERROR, "%s[SCAN] spectral scan get results failed\n", ERRMSG);
                     continue; /*!> main while loop */
@@ -1484,99 +1787,4 @@ static void thread_spectral_scan(void) {
 
 #endif
 
-static bool lbt_getchan_stat(int fd, uint32_t freq_hz, int8_t rssi_target, uint16_t scan_time_ms) 
-{
-    int ret;
-    struct timespec s_time;
-    struct timespec e_time;
-
-    if (fd < 0) return false;
-
-    clock_gettime(CLOCK_MONOTONIC, &s_time);
-    char buffer[48] = {'\0'};
-    snprintf(buffer, sizeof(buffer), "AT+GETCHANSTAT=%u,%i,%u\r\n", freq_hz, rssi_target, scan_time_ms);
-    lgw_log(LOG_DEBUG, "%s[LBT] command: %s", DEBUGMSG, buffer);
-    ret = uart_send(fd, buffer, strlen(buffer) + 1); 
-    if (ret == -1) {
-        lgw_log(LOG_ERROR, "%s[LBT] get channel stat error (cannot send command to uart)\n", ERRMSG);
-        return false;
-    }
-    memset(buffer, 0, sizeof(buffer));
-    uart_read(fd, buffer, 4, 1000);  /*!> 1000 (1s) default timeout ms for read ,  4 is sizeof FREE */
-    clock_gettime(CLOCK_MONOTONIC, &e_time);
-    lgw_log(LOG_DEBUG, "%s[LBT] scan use %i ms\n", DEBUGMSG, (int)(1000 * difftimespec(e_time, s_time)));
-
-    if (buffer[0] == 'F') {
-        lgw_log(LOG_DEBUG, "%s[LBT] chan(%u) is FREE\n", DEBUGMSG, freq_hz);
-        return true;
-    } else {
-        lgw_log(LOG_DEBUG, "%s[LBT] chan(%u) is BUSY\n", DEBUGMSG, freq_hz);
-        return false;
-    }
-}
-
-/*!> -------------------------------------------------------------------------- */
-/*!> --- THREAD : BACKGROUND LBT SCAN                                  --- */
-
-static void thread_lbt_scan(void) 
-{
-    int i, j;
-    uint32_t current_concentrator_time;
-    uint32_t diff_time;
-
-    for (i = 0; i < NB_LBT_QUEUE; i++) {
-        GW.lbt.lbt_stat[i].freq_hz = 0;
-        GW.lbt.lbt_stat[i].count_us = 0;
-        GW.lbt.lbt_stat[i].chan_is_free = false;
-    }
-
-    lgw_log(LOG_INFO, "%s[LBT] start lbt scan program\n", INFOMSG);
-
-    while (!exit_sig && !quit_sig) {
-
-        if (GW.lbt.lbt_tty_fd < 0) {
-            GW.lbt.lbt_tty_fd = uart_open(GW.lbt.lbt_tty_path);
-            if (GW.lbt.lbt_tty_fd != -1)
-                uart_config(GW.lbt.lbt_tty_fd, GW.lbt.lbt_tty_baude, 9, 9, 9, 9);  /*!> 9 use default */
-            else {
-                lgw_log(LOG_ERROR, "%s[LBT] cannot open tty path, continue\n", ERRMSG);
-                wait_ms(5000); 
-                continue;
-            }
-        }
-
-#ifdef SX1302MOD
-        current_concentrator_time = cur_hal_time;
-#else
-        get_concentrator_time(&current_concentrator_time);
-#endif
-
-        j = 0;
-
-        for (i = 0; i < NB_LBT_QUEUE; i++) {
-            diff_time = GW.lbt.lbt_stat[i].count_us - current_concentrator_time;
-
-            if (diff_time > 40000 &&  diff_time < 120000) {   
-                GW.lbt.lbt_stat[i].chan_is_free = lbt_getchan_stat(GW.lbt.lbt_tty_fd, GW.lbt.lbt_stat[i].freq_hz, GW.lbt.lbt_rssi_target, 6);
-                lgw_log(LOG_DEBUG, "%s[LBT] (%d)scan chan(%u) free=%s, us=%u\n", DEBUGMSG, i, GW.lbt.lbt_stat[i].freq_hz, GW.lbt.lbt_stat[i].chan_is_free ? "TRUE" : "FALSE", GW.lbt.lbt_stat[i].count_us);
-                j++;
-                wait_ms(12);  // rssi_scan_time_ms
-            } //else {
-               // GW.lbt.lbt_stat[i].chan_is_free = false;
-                //wait_ms(60);
-            //}
-            
-            if (diff_time > 10000000)  // (10s will be remove)
-                GW.lbt.lbt_stat[i].count_us = 0;
-        }
-
-        wait_ms(5 + 30 * j);  // rssi_scan_time_ms
-    }
-
-    if (GW.lbt.lbt_tty_fd > 0)
-        uart_close(GW.lbt.lbt_tty_fd);
-
-    lgw_log(LOG_INFO, "%s[THREAD][LBT] Exited!\n", INFOMSG);
-}
-
 /*!> --- EOF ------------------------------------------------------------------ */
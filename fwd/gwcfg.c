@@ -33,6 +33,8 @@
 #include "parson.h"
 #include "loragw_aux.h"
 #include "loragw_hal.h"
+#include "wire_bin.h"
+#include "relay_uart.h"
 
 
 static int parse_SX130x_configuration(const char* conf_file) {
@@ -1067,6 +1069,35 @@ static int parse_gateway_configuration(const char* conf_file) {
         lgw_log(LOG_INFO, "[INFO~][SETTING] autoquit_threshold is configured to %u \n", GW.cfg.autoquit_threshold);
     }
 
+    /*!> uplink fetch policy (optional) */
+    str = json_object_get_string(conf_obj, "fetch_policy");
+    if (str != NULL) {
+        GW.fetch.adaptive = strncmp(str, "fixed", 5) ? true : false;
+        lgw_log(LOG_INFO, "[INFO~][SETTING] fetch policy is configured to \"%s\"\n", GW.fetch.adaptive ? "adaptive" : "fixed");
+    }
+
+    val = json_object_get_value(conf_obj, "fetch_min_ms");
+    if (val != NULL) {
+        GW.fetch.min_sleep_ms = (uint16_t)json_value_get_number(val);
+        if (GW.fetch.min_sleep_ms < 1)
+            GW.fetch.min_sleep_ms = 1;
+    }
+
+    val = json_object_get_value(conf_obj, "fetch_max_ms");
+    if (val != NULL) {
+        GW.fetch.max_sleep_ms = (uint16_t)json_value_get_number(val);
+    }
+    if (GW.fetch.max_sleep_ms < GW.fetch.min_sleep_ms)
+        GW.fetch.max_sleep_ms = GW.fetch.min_sleep_ms;
+    lgw_log(LOG_INFO, "[INFO~][SETTING] fetch sleep is configured to %u~%u ms\n", GW.fetch.min_sleep_ms, GW.fetch.max_sleep_ms);
+
+    str = json_object_get_string(conf_obj, "fetch_irq_gpio");
+    if (str != NULL) {
+        strncpy(GW.fetch.irq_gpio, str, sizeof(GW.fetch.irq_gpio));
+        GW.fetch.irq_gpio[sizeof(GW.fetch.irq_gpio) - 1] = '\0';
+        lgw_log(LOG_INFO, "[INFO~][SETTING] fetch irq gpio is configured to \"%s\"\n", GW.fetch.irq_gpio);
+    }
+
     val = json_object_get_value(conf_obj, "time_interval");
     if (val != NULL) {
         GW.cfg.time_interval = (uint32_t)json_value_get_number(val);
@@ -1119,6 +1150,15 @@ static int parse_gateway_configuration(const char* conf_file) {
         GW.relay.tty_baude = (uint32_t)json_value_get_number(val);
     lgw_log(LOG_INFO, "[INFO~][SETTING] RELAY tty bauderate is configured to \"%u\"\n", GW.relay.tty_baude);
 
+    str = json_object_get_string(conf_obj, "relay_frame");
+    if (str != NULL) {
+        if (!strncmp(str, "binary", 6))
+            GW.relay.frame = RELAY_FRAME_BIN;
+        else if (strncmp(str, "at", 2))
+            lgw_log(LOG_WARNING, "%s[SETTING] unknown relay_frame \"%s\", use at\n", WARNMSG, str);
+        lgw_log(LOG_INFO, "[INFO~][SETTING] RELAY frame is configured to \"%s\"\n", GW.relay.frame == RELAY_FRAME_BIN ? "binary" : "at");
+    }
+
     /*!> time diff of UTC: string */
     str = json_object_get_string(conf_obj, "time_diff");
     if (str != NULL) {
@@ -1292,6 +1332,7 @@ static int parse_gateway_configuration(const char* conf_file) {
             serv_entry->net->pull_timeout.tv_sec = 0;
             serv_entry->net->pull_timeout.tv_usec = DEFAULT_PULL_TIMEOUT_MS * 1000;
             serv_entry->net->pull_interval = DEFAULT_PULL_INTERVAL;
+            serv_entry->net->wire_format = WIRE_FORMAT_JSON;
             
             /*!> about service filter information */
             serv_entry->filter.fwd_valid_pkt = true;
@@ -1325,6 +1366,7 @@ static int parse_gateway_configuration(const char* conf_file) {
             }
 
             serv_entry->thread.stop_sig = false;
+            serv_entry->push.mtu = DEFAULT_PUSH_MTU;
 
             serv_obj = json_array_get_object(serv_arry, i);
 
@@ -1456,6 +1498,28 @@ static int parse_gateway_configuration(const char* conf_file) {
                     lgw_log(LOG_INFO, "[INFO~][SETTING][%s] stat_interval is configure to \"%d\"\n", serv_entry->info.name, serv_entry->report->stat_interval);
                 }
 
+                val = json_object_get_value(serv_obj, "push_mtu");
+                if (val != NULL) {
+                    try = (int)json_value_get_number(val);
+                    if (try < MIN_PUSH_MTU)
+                        try = MIN_PUSH_MTU;
+                    else if (try > TX_BUFF_SIZE)
+                        try = TX_BUFF_SIZE;
+                    serv_entry->push.mtu = (uint16_t)try;
+                    lgw_log(LOG_INFO, "[INFO~][SETTING][%s] push_mtu is configure to \"%u\"\n", serv_entry->info.name, serv_entry->push.mtu);
+                }
+
+                str = json_object_get_string(serv_obj, "wire_format");
+                if (str != NULL) {
+                    if (!strncmp(str, "binary", 6)) {
+                        serv_entry->net->wire_format = WIRE_FORMAT_BIN;
+                        memcpy(serv_entry->report->stat_format, "binary", sizeof("binary"));
+                    } else if (strncmp(str, "json", 4)) {
+                        lgw_log(LOG_WARNING, "%s[SETTING][%s] unknown wire_format \"%s\", use json\n", WARNMSG, serv_entry->info.name, str);
+                    }
+                    lgw_log(LOG_INFO, "[INFO~][SETTING][%s] wire_format is configure to \"%s\"\n", serv_entry->info.name, serv_entry->net->wire_format == WIRE_FORMAT_BIN ? "binary" : "json");
+                }
+
             } //end of not as pkt type
             serv_entry->filter.fwd_valid_pkt = true;
             serv_entry->filter.fwd_error_pkt = true;
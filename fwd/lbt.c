@@ -0,0 +1,325 @@
+/*!>
+ *  ____  ____      _    ____ ___ _   _  ___
+ *  |  _ \|  _ \    / \  / ___|_ _| \ | |/ _ \
+ *  | | | | |_) |  / _ \| |  _ | ||  \| | | | |
+ *  | |_| |  _ <  / ___ \ |_| || || |\  | |_| |
+ *  |____/|_| \_\/_/   \_\____|___|_| \_|\___/
+ *
+ * Dragino_gw_fwd -- An opensource lora gateway forward
+ *
+ * See http://www.dragino.com for more information about
+ * the lora gateway project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ *
+ * Maintainer: skerlan
+ *
+ */
+
+
+/*!>!
+ * \file
+ * \brief
+ *  Description: LBT scheduler. A slot is taken for each downlink once
+ *  it is in the JIT queue, keyed by rf chain, count_us and frequency,
+ *  the same packet jit_dequeue gives back. The scheduler sleeps until the
+ *  earliest pending slot has to be scanned so its verdict is ready before
+ *  the JIT thread hands the packet out, scans are serialized on the tty.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "fwd.h"
+#include "uart.h"
+#include "lbt.h"
+#include "timebase.h"
+
+DECLARE_GW;
+
+typedef enum { SLOT_FREE, SLOT_PENDING, SLOT_SCANNING, SLOT_DONE } slot_state_e;
+
+typedef struct {
+    slot_state_e state;
+    uint8_t  rf_chain;
+    uint32_t count_us;
+    uint32_t freq_hz;
+    bool     chan_is_free;
+} lbt_slot_s;
+
+static lbt_slot_s slots[LBT_SLOT_NB];
+
+static pthread_mutex_t mx_lbt = PTHREAD_MUTEX_INITIALIZER;   /*!> slots, stats and latency estimate */
+static pthread_cond_t cd_sched;                 /*!> new slot or stop, for the scheduler */
+static pthread_cond_t cd_done;                  /*!> scan done, for lbt_verdict */
+static pthread_once_t lbt_once = PTHREAD_ONCE_INIT;
+static bool stop_sig = false;
+
+static int32_t lat_est_us = LBT_LAT_INIT_US;    /*!> expected scan latency, rises at once, decays slowly */
+static lbt_stat_s lbt_st;
+
+/*!> both conditions wait on the monotonic clock */
+static void lbt_init(void) {
+    pthread_condattr_t cattr;
+
+    pthread_condattr_init(&cattr);
+    pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+    pthread_cond_init(&cd_sched, &cattr);
+    pthread_cond_init(&cd_done, &cattr);
+    pthread_condattr_destroy(&cattr);
+}
+
+static void deadline(struct timespec* t, const struct timespec* from, int32_t wait_us) {
+    *t = *from;
+    t->tv_sec += wait_us / 1000000;
+    t->tv_nsec += (long)(wait_us % 1000000) * 1000;
+    if (t->tv_nsec >= 1000000000) {
+        t->tv_sec += 1;
+        t->tv_nsec -= 1000000000;
+    }
+}
+
+/*!> called with mx_lbt held */
+static lbt_slot_s* slot_find(uint8_t rf_chain, uint32_t count_us, uint32_t freq_hz) {
+    int i;
+
+    for (i = 0; i < LBT_SLOT_NB; i++) {
+        if (slots[i].state != SLOT_FREE && slots[i].rf_chain == rf_chain &&
+            slots[i].count_us == count_us && slots[i].freq_hz == freq_hz)
+            return &slots[i];
+    }
+    return NULL;
+}
+
+/*!> called with mx_lbt held, NULL when all entries are taken */
+static lbt_freq_stat_s* freq_stat(uint32_t freq_hz) {
+    int i;
+
+    for (i = 0; i < lbt_st.nb_freq; i++) {
+        if (lbt_st.freq[i].freq_hz == freq_hz)
+            return &lbt_st.freq[i];
+    }
+    if (lbt_st.nb_freq == LBT_FREQ_NB)
+        return NULL;
+    memset(&lbt_st.freq[i], 0, sizeof(lbt_st.freq[i]));
+    lbt_st.freq[i].freq_hz = freq_hz;
+    lbt_st.nb_freq++;
+    return &lbt_st.freq[i];
+}
+
+int lbt_schedule(uint8_t rf_chain, uint32_t count_us, uint32_t freq_hz) {
+    int i;
+
+    pthread_once(&lbt_once, lbt_init);
+
+    pthread_mutex_lock(&mx_lbt);
+    if (slot_find(rf_chain, count_us, freq_hz) != NULL) {
+        pthread_mutex_unlock(&mx_lbt);
+        return 0;
+    }
+    for (i = 0; i < LBT_SLOT_NB; i++) {
+        if (slots[i].state == SLOT_FREE)
+            break;
+    }
+    if (i == LBT_SLOT_NB) {
+        lbt_st.nb_full++;
+        pthread_mutex_unlock(&mx_lbt);
+        return -1;
+    }
+    slots[i].rf_chain = rf_chain;
+    slots[i].count_us = count_us;
+    slots[i].freq_hz = freq_hz;
+    slots[i].chan_is_free = false;
+    slots[i].state = SLOT_PENDING;
+    lbt_st.nb_sched++;
+    pthread_cond_signal(&cd_sched);
+    pthread_mutex_unlock(&mx_lbt);
+
+    return 0;
+}
+
+lbt_verdict_e lbt_verdict(uint8_t rf_chain, uint32_t count_us, uint32_t freq_hz) {
+    lbt_verdict_e v = LBT_NO_VERDICT;
+    struct timespec now, wake;
+    lbt_slot_s* s;
+
+    pthread_once(&lbt_once, lbt_init);
+
+    pthread_mutex_lock(&mx_lbt);
+    s = slot_find(rf_chain, count_us, freq_hz);
+    if (s != NULL && s->state == SLOT_SCANNING) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        deadline(&wake, &now, LBT_VERDICT_WAIT_MS * 1000);
+        while (s->state == SLOT_SCANNING) {
+            if (pthread_cond_timedwait(&cd_done, &mx_lbt, &wake) == ETIMEDOUT)
+                break;
+        }
+    }
+    if (s != NULL && s->state == SLOT_DONE)
+        v = s->chan_is_free ? LBT_FREE : LBT_BUSY;
+    else
+        lbt_st.nb_missed++;
+    /*!> a scan still running finds its slot free and drops the result */
+    if (s != NULL)
+        s->state = SLOT_FREE;
+    pthread_mutex_unlock(&mx_lbt);
+
+    return v;
+}
+
+/*!> 1 if the channel is free, 0 if busy, -1 if the module can't be asked */
+static int lbt_getchan_stat(int fd, uint32_t freq_hz, int8_t rssi_target, uint16_t scan_time_ms) 
+{
+    int ret;
+    char buffer[48] = {'\0'};
+
+    snprintf(buffer, sizeof(buffer), "AT+GETCHANSTAT=%u,%i,%u\r\n", freq_hz, rssi_target, scan_time_ms);
+    lgw_log(LOG_DEBUG, "%s[LBT] command: %s", DEBUGMSG, buffer);
+    ret = uart_send(fd, buffer, strlen(buffer) + 1); 
+    if (ret == -1) {
+        lgw_log(LOG_ERROR, "%s[LBT] get channel stat error (cannot send command to uart)\n", ERRMSG);
+        return -1;
+    }
+    memset(buffer, 0, sizeof(buffer));
+    uart_read(fd, buffer, 4, 1000);  /*!> 1000 (1s) default timeout ms for read ,  4 is sizeof FREE */
+
+    if (buffer[0] == 'F') {
+        lgw_log(LOG_DEBUG, "%s[LBT] chan(%u) is FREE\n", DEBUGMSG, freq_hz);
+        return 1;
+    } else {
+        lgw_log(LOG_DEBUG, "%s[LBT] chan(%u) is BUSY\n", DEBUGMSG, freq_hz);
+        return 0;
+    }
+}
+
+/*!> scan the channel of slot s, called and returns with mx_lbt held */
+static void lbt_scan(lbt_slot_s* s) {
+    struct timespec s_time, e_time;
+    lbt_freq_stat_s* fs;
+    uint32_t freq_hz = s->freq_hz;
+    int32_t lat_us;
+    int ret;
+
+    s->state = SLOT_SCANNING;
+    pthread_mutex_unlock(&mx_lbt);
+
+    clock_gettime(CLOCK_MONOTONIC, &s_time);
+    ret = lbt_getchan_stat(GW.lbt.lbt_tty_fd, freq_hz, GW.lbt.lbt_rssi_target, GW.lbt.lbt_scan_time_ms);
+    clock_gettime(CLOCK_MONOTONIC, &e_time);
+    lat_us = (int32_t)(1000000 * difftimespec(e_time, s_time));
+    lgw_log(LOG_DEBUG, "%s[LBT] scan chan(%u) free=%s in %i us\n", DEBUGMSG, freq_hz, ret == 1 ? "TRUE" : "FALSE", lat_us);
+
+    pthread_mutex_lock(&mx_lbt);
+    if (ret >= 0) {
+        if (lat_us > lat_est_us)
+            lat_est_us = lat_us;
+        else
+            lat_est_us += (lat_us - lat_est_us) / LBT_LAT_FILT;
+
+        fs = freq_stat(freq_hz);
+        if (fs != NULL) {
+            fs->nb_scan++;
+            if (ret == 0)
+                fs->nb_busy++;
+            fs->lat_sum_us += lat_us;
+            if ((uint32_t)lat_us > fs->lat_max_us)
+                fs->lat_max_us = lat_us;
+        }
+    }
+    if (s->state == SLOT_SCANNING) {
+        s->chan_is_free = ret == 1;
+        s->state = SLOT_DONE;
+        pthread_cond_broadcast(&cd_done);
+    }
+}
+
+void thread_lbt_scan(void) 
+{
+    struct timespec now, wake;
+    uint32_t count_us;
+    bool count_ok;
+    lbt_slot_s* next;
+    int32_t d, start_us, wait_us;
+    int i;
+
+    pthread_once(&lbt_once, lbt_init);
+
+    lgw_log(LOG_INFO, "%s[LBT] start lbt scan program\n", INFOMSG);
+
+    while (1) {
+        if (GW.lbt.lbt_tty_fd < 0) {
+            GW.lbt.lbt_tty_fd = uart_open(GW.lbt.lbt_tty_path);
+            if (GW.lbt.lbt_tty_fd != -1)
+                uart_config(GW.lbt.lbt_tty_fd, GW.lbt.lbt_tty_baude, 9, 9, 9, 9);  /*!> 9 use default */
+            else
+                lgw_log(LOG_ERROR, "%s[LBT] cannot open tty path, continue\n", ERRMSG);
+        }
+
+        /*!> counter read out of the lock, it may wait for the concentrator */
+        count_ok = timebase_now(&count_us) == 0;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        pthread_mutex_lock(&mx_lbt);
+        if (stop_sig) {
+            pthread_mutex_unlock(&mx_lbt);
+            break;
+        }
+
+        /*!> earliest slot to scan, slots jit never asked for are dropped */
+        next = NULL;
+        wait_us = GW.lbt.lbt_tty_fd < 0 ? 5000000 : LBT_IDLE_WAIT_MS * 1000;
+        for (i = 0; count_ok && GW.lbt.lbt_tty_fd >= 0 && i < LBT_SLOT_NB; i++) {
+            if (slots[i].state == SLOT_FREE)
+                continue;
+            d = (int32_t)(slots[i].count_us - count_us);
+            if (d < -1000000) {
+                slots[i].state = SLOT_FREE;
+                continue;
+            }
+            /*!> too late when jit already handed it out, lbt_verdict counts it */
+            if (slots[i].state != SLOT_PENDING || d <= JIT_PEEK_WINDOW_US)
+                continue;
+            start_us = d - JIT_PEEK_WINDOW_US - LBT_LEAD_GUARD_US - lat_est_us;
+            if (start_us < wait_us) {
+                wait_us = start_us;
+                next = &slots[i];
+            }
+        }
+
+        if (next != NULL && wait_us <= 0) {
+            lbt_scan(next);
+        } else {
+            deadline(&wake, &now, wait_us);
+            pthread_cond_timedwait(&cd_sched, &mx_lbt, &wake);
+        }
+        pthread_mutex_unlock(&mx_lbt);
+    }
+
+    if (GW.lbt.lbt_tty_fd > 0)
+        uart_close(GW.lbt.lbt_tty_fd);
+
+    lgw_log(LOG_INFO, "%s[THREAD][LBT] Exited!\n", INFOMSG);
+}
+
+void lbt_stop(void) {
+    pthread_once(&lbt_once, lbt_init);
+
+    pthread_mutex_lock(&mx_lbt);
+    stop_sig = true;
+    pthread_cond_signal(&cd_sched);
+    pthread_mutex_unlock(&mx_lbt);
+}
+
+void lbt_stat(lbt_stat_s* st, bool reset) {
+    pthread_mutex_lock(&mx_lbt);
+    *st = lbt_st;
+    if (reset)
+        memset(&lbt_st, 0, sizeof(lbt_st));
+    pthread_mutex_unlock(&mx_lbt);
+}
@@ -0,0 +1,470 @@
+/*!>
+ *  ____  ____      _    ____ ___ _   _  ___
+ *  |  _ \|  _ \    / \  / ___|_ _| \ | |/ _ \
+ *  | | | | |_) |  / _ \| |  _ | ||  \| | | | |
+ *  | |_| |  _ <  / ___ \ |_| || || |\  | |_| |
+ *  |____/|_| \_\/_/   \_\____|___|_| \_|\___/
+ *
+ * Dragino_gw_fwd -- An opensource lora gateway forward
+ *
+ * See http://www.dragino.com for more information about
+ * the lora gateway project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ *
+ * Maintainer: skerlan
+ *
+ */
+
+
+/*!>!
+ * \file
+ * \brief
+ *  Description: compiled uplink filters. The rows (service, type, value)
+ *  of the filter table are turned into a bitset for fport and nwkid,
+ *  sorted prefix arrays for devaddr and hash sets for deveui and joineui,
+ *  one group per service. Packets are checked against the published set
+ *  without lock. The devskey watcher recompiles it when the database
+ *  changes, see devskey_tab_s for the set lifetime.
+*/
+
+#include <string.h>
+#include <strings.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <sqlite3.h>
+
+#include "fwd.h"
+#include "pkt_filter.h"
+#include "devskey.h"
+
+#define ADDR_HEX_NB     8                       /*!> hex digits of a devaddr */
+#define EUI_HEX_NB      16                      /*!> hex digits of an eui */
+
+typedef enum { KIND_FPORT, KIND_DEVADDR, KIND_NWKID, KIND_DEVEUI, KIND_JOINEUI, KIND_NB } kind_e;
+
+static const char* kind_name[KIND_NB] = { "fport", "devaddr", "nwkid", "deveui", "joineui" };
+
+/*!> one row of the filter table, parsed */
+typedef struct {
+    char name[32];
+    kind_e kind;
+    int len;                                    /*!> devaddr prefix length, in hex digits */
+    uint64_t value;
+} rule_s;
+
+typedef struct {
+    uint64_t eui;
+    bool used;
+} eui_slot_s;
+
+typedef struct {
+    uint32_t mask;                              /*!> slot number - 1, power of 2 */
+    eui_slot_s* slot;                           /*!> NULL when empty */
+} eui_set_s;
+
+/*!> devaddr prefixes, sorted, by number of hex digits */
+typedef struct {
+    int nb[ADDR_HEX_NB + 1];
+    uint32_t* pfx[ADDR_HEX_NB + 1];
+} addr_set_s;
+
+typedef struct {
+    char name[32];                              /*!> service name */
+    uint32_t fport[256 / 32];
+    uint32_t nwkid[128 / 32];
+    addr_set_s devaddr;
+    eui_set_s deveui;
+    eui_set_s joineui;
+} serv_filter_s;
+
+typedef struct {
+    int nb_serv;
+    serv_filter_s serv[];
+} filter_set_s;
+
+static void set_free(void* tab);
+
+static devskey_tab_s filters = DEVSKEY_TAB_INIT(set_free);
+
+static inline bool bit_test(const uint32_t* bits, uint32_t n) {
+    return (bits[n >> 5] >> (n & 31)) & 1;
+}
+
+static inline uint32_t eui_hash(uint64_t eui, uint32_t mask) {
+    uint64_t h = eui * 0x9E3779B97F4A7C15ull;
+    return (uint32_t)(h >> 32) & mask;
+}
+
+static bool eui_has(const eui_set_s* set, uint64_t eui) {
+    uint32_t i;
+
+    if (set->slot == NULL)
+        return false;
+    for (i = eui_hash(eui, set->mask); set->slot[i].used; i = (i + 1) & set->mask) {
+        if (set->slot[i].eui == eui)
+            return true;
+    }
+    return false;
+}
+
+static bool addr_has(const addr_set_s* set, uint32_t devaddr) {
+    const uint32_t* pfx;
+    uint32_t key;
+    int len, lo, hi, mid;
+
+    for (len = 1; len <= ADDR_HEX_NB; len++) {
+        if (set->nb[len] == 0)
+            continue;
+        key = devaddr >> (32 - 4 * len);
+        pfx = set->pfx[len];
+        lo = 0;
+        hi = set->nb[len] - 1;
+        while (lo <= hi) {
+            mid = (lo + hi) / 2;
+            if (pfx[mid] == key)
+                return true;
+            if (pfx[mid] < key)
+                lo = mid + 1;
+            else
+                hi = mid - 1;
+        }
+    }
+    return false;
+}
+
+/*!> eui string of the parsed frame */
+static bool eui_from_str(const char* str, uint64_t* eui) {
+    int i, d;
+
+    *eui = 0;
+    for (i = 0; i < EUI_HEX_NB; i++) {
+        d = hex_digit(str[i]);
+        if (d < 0)
+            return false;
+        *eui = *eui << 4 | (uint64_t)d;
+    }
+    return str[EUI_HEX_NB] == '\0';
+}
+
+/*!> INCLUDE drops what matches, EXCLUDE forwards only what matches */
+static inline bool verdict(filter_e mode, bool match) {
+    return mode == INCLUDE ? match : !match;
+}
+
+static const serv_filter_s* serv_filter_find(const filter_set_s* set, const char* name) {
+    int i;
+
+    if (set == NULL)
+        return NULL;
+    for (i = 0; i < set->nb_serv; i++) {
+        if (strcmp(set->serv[i].name, name) == 0)
+            return &set->serv[i];
+    }
+    return NULL;
+}
+
+bool pkt_filter_drop(const serv_s* serv, const LoRaMacMessageData_t* macmsg) {
+    static const serv_filter_s none;            /*!> service without rules */
+    const serv_filter_s* f;
+    uint64_t eui;
+    uint32_t addr;
+    int hdr;
+
+    if (serv->filter.fport == NOFILTER && serv->filter.devaddr == NOFILTER &&
+        serv->filter.nwkid == NOFILTER && serv->filter.deveui == NOFILTER &&
+        serv->filter.joineui == NOFILTER)
+        return false;
+
+    f = serv_filter_find(devskey_tab_read(&filters), serv->info.name);
+    if (f == NULL)
+        f = &none;
+
+    switch (macmsg->MHDR.Bits.MType) {
+        case FRAME_TYPE_JOIN_REQ:
+            if (serv->filter.deveui != NOFILTER &&
+                verdict(serv->filter.deveui, eui_from_str((const char*)macmsg->DevEUI, &eui) && eui_has(&f->deveui, eui)))
+                return true;
+            if (serv->filter.joineui != NOFILTER &&
+                verdict(serv->filter.joineui, eui_from_str((const char*)macmsg->AppEUI, &eui) && eui_has(&f->joineui, eui)))
+                return true;
+            break;
+        case FRAME_TYPE_DATA_UNCONFIRMED_UP:
+        case FRAME_TYPE_DATA_CONFIRMED_UP:
+            addr = macmsg->FHDR.DevAddr;
+            /*!> MHDR, FHDR and MIC, the port follows when the frame has one */
+            hdr = 1 + 7 + macmsg->FHDR.FCtrl.Bits.FOptsLen + LORAMAC_MIC_FIELD_SIZE;
+            if (serv->filter.fport != NOFILTER && macmsg->BufSize > hdr &&
+                verdict(serv->filter.fport, bit_test(f->fport, macmsg->FPort)))
+                return true;
+            if (serv->filter.devaddr != NOFILTER && verdict(serv->filter.devaddr, addr_has(&f->devaddr, addr)))
+                return true;
+            if (serv->filter.nwkid != NOFILTER && verdict(serv->filter.nwkid, bit_test(f->nwkid, addr >> 25)))
+                return true;
+            break;
+        default:
+            break;
+    }
+    return false;
+}
+
+/*!> value of a row, characters other than hex digits are ignored as the
+ *   gwdb filter lookup did, so "260B*" is the prefix 260B */
+static bool parse_rule(const char* name, const char* type, const char* value, rule_s* rule) {
+    char* end;
+    unsigned long port;
+    int i, d;
+
+    memset(rule, 0, sizeof(rule_s));
+    if (strlen(name) >= sizeof(rule->name))
+        return false;
+    strcpy(rule->name, name);
+
+    for (i = 0; i < KIND_NB; i++) {
+        if (strcasecmp(type, kind_name[i]) == 0)
+            break;
+    }
+    if (i == KIND_NB)
+        return false;
+    rule->kind = i;
+
+    if (rule->kind == KIND_FPORT) {
+        errno = 0;
+        port = strtoul(value, &end, 10);
+        if (errno != 0 || end == value || *end != '\0' || port > 255)
+            return false;
+        rule->value = port;
+        return true;
+    }
+
+    for (; *value != '\0'; value++) {
+        d = hex_digit(*value);
+        if (d < 0)
+            continue;
+        if (rule->len == EUI_HEX_NB)
+            return false;
+        rule->value = rule->value << 4 | (uint64_t)d;
+        rule->len++;
+    }
+
+    switch (rule->kind) {
+        case KIND_DEVADDR:
+            return rule->len > 0 && rule->len <= ADDR_HEX_NB;
+        case KIND_NWKID:
+            return rule->len > 0 && rule->value < 128;
+        default:
+            return rule->len == EUI_HEX_NB;     /*!> whole eui only */
+    }
+}
+
+static int cmp_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void set_free(void* tab) {
+    filter_set_s* set = tab;
+    serv_filter_s* f;
+    int i, len;
+
+    if (set == NULL)
+        return;
+    for (i = 0; i < set->nb_serv; i++) {
+        f = &set->serv[i];
+        for (len = 1; len <= ADDR_HEX_NB; len++) {
+            if (f->devaddr.pfx[len] != NULL)
+                lgw_free(f->devaddr.pfx[len]);
+        }
+        if (f->deveui.slot != NULL)
+            lgw_free(f->deveui.slot);
+        if (f->joineui.slot != NULL)
+            lgw_free(f->joineui.slot);
+    }
+    lgw_free(set);
+}
+
+static int eui_set_init(eui_set_s* set, int nb) {
+    uint32_t nb_slot = 8;
+
+    if (nb == 0)
+        return 0;
+    while (nb_slot < (uint32_t)nb * 2)
+        nb_slot <<= 1;
+    set->slot = lgw_calloc(nb_slot, sizeof(eui_slot_s));
+    if (set->slot == NULL)
+        return -1;
+    set->mask = nb_slot - 1;
+    return 0;
+}
+
+static void eui_set_add(eui_set_s* set, uint64_t eui) {
+    uint32_t i;
+
+    for (i = eui_hash(eui, set->mask); set->slot[i].used; i = (i + 1) & set->mask) {
+        if (set->slot[i].eui == eui)
+            return;
+    }
+    set->slot[i].used = true;
+    set->slot[i].eui = eui;
+}
+
+/*!> group the rules by service, sets are sized before they are filled */
+static filter_set_s* set_compile(const rule_s* rule, int nb_rule) {
+    filter_set_s* set;
+    serv_filter_s* f;
+    int nb_serv = 0, i, j, len, nb_addr, nb_deveui, nb_joineui;
+
+    for (i = 0; i < nb_rule; i++) {
+        for (j = 0; j < i && strcmp(rule[j].name, rule[i].name); j++);
+        if (j == i)
+            nb_serv++;
+    }
+
+    set = lgw_calloc(1, sizeof(filter_set_s) + nb_serv * sizeof(serv_filter_s));
+    if (set == NULL)
+        return NULL;
+
+    for (i = 0; i < nb_rule; i++) {
+        for (j = 0; j < set->nb_serv && strcmp(set->serv[j].name, rule[i].name); j++);
+        if (j < set->nb_serv)
+            continue;
+        f = &set->serv[set->nb_serv++];
+        strcpy(f->name, rule[i].name);
+
+        nb_deveui = nb_joineui = 0;
+        for (j = i; j < nb_rule; j++) {
+            if (strcmp(rule[j].name, f->name) == 0) {
+                nb_deveui += rule[j].kind == KIND_DEVEUI;
+                nb_joineui += rule[j].kind == KIND_JOINEUI;
+            }
+        }
+        if (eui_set_init(&f->deveui, nb_deveui) || eui_set_init(&f->joineui, nb_joineui))
+            goto fail;
+
+        for (len = 1; len <= ADDR_HEX_NB; len++) {
+            nb_addr = 0;
+            for (j = i; j < nb_rule; j++) {
+                if (rule[j].kind == KIND_DEVADDR && rule[j].len == len && strcmp(rule[j].name, f->name) == 0)
+                    nb_addr++;
+            }
+            if (nb_addr == 0)
+                continue;
+            f->devaddr.pfx[len] = lgw_malloc(nb_addr * sizeof(uint32_t));
+            if (f->devaddr.pfx[len] == NULL)
+                goto fail;
+        }
+
+        for (j = i; j < nb_rule; j++) {
+            if (strcmp(rule[j].name, f->name))
+                continue;
+            switch (rule[j].kind) {
+                case KIND_FPORT:
+                    f->fport[rule[j].value >> 5] |= 1u << (rule[j].value & 31);
+                    break;
+                case KIND_NWKID:
+                    f->nwkid[rule[j].value >> 5] |= 1u << (rule[j].value & 31);
+                    break;
+                case KIND_DEVADDR:
+                    len = rule[j].len;
+                    f->devaddr.pfx[len][f->devaddr.nb[len]++] = (uint32_t)rule[j].value;
+                    break;
+                case KIND_DEVEUI:
+                    eui_set_add(&f->deveui, rule[j].value);
+                    break;
+                case KIND_JOINEUI:
+                    eui_set_add(&f->joineui, rule[j].value);
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        for (len = 1; len <= ADDR_HEX_NB; len++) {
+            if (f->devaddr.nb[len] > 1)
+                qsort(f->devaddr.pfx[len], f->devaddr.nb[len], sizeof(uint32_t), cmp_u32);
+        }
+    }
+
+    return set;
+
+fail:
+    set_free(set);
+    return NULL;
+}
+
+static int pkt_filter_load(sqlite3* db) {
+    sqlite3_stmt* stmt = NULL;
+    filter_set_s* set = NULL;
+    rule_s* rule = NULL;
+    const char *name, *type, *value;
+    int nb_row = 0, nb_rule = 0, nb_bad = 0, ret = SQLITE_DONE;
+
+    if (sqlite3_prepare_v2(db, "SELECT count(*) FROM filter", -1, &stmt, NULL) != SQLITE_OK ||
+        sqlite3_step(stmt) != SQLITE_ROW) {
+        lgw_log(LOG_WARNING, "%s[FILTER] can't count filters: %s\n", WARNMSG, sqlite3_errmsg(db));
+        goto fail;
+    }
+    nb_row = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+    stmt = NULL;
+
+    if (nb_row > 0) {
+        rule = lgw_malloc(nb_row * sizeof(rule_s));
+        if (rule == NULL)
+            goto fail;
+    }
+
+    if (sqlite3_prepare_v2(db, "SELECT DISTINCT name, type, value FROM filter", -1, &stmt, NULL) != SQLITE_OK) {
+        lgw_log(LOG_WARNING, "%s[FILTER] can't read filters: %s\n", WARNMSG, sqlite3_errmsg(db));
+        goto fail;
+    }
+    /*!> rows added since the count are dropped, the next check reloads */
+    while (nb_rule + nb_bad < nb_row && (ret = sqlite3_step(stmt)) == SQLITE_ROW) {
+        name = (const char*)sqlite3_column_text(stmt, 0);
+        type = (const char*)sqlite3_column_text(stmt, 1);
+        value = (const char*)sqlite3_column_text(stmt, 2);
+        if (name != NULL && type != NULL && value != NULL && parse_rule(name, type, value, &rule[nb_rule]))
+            nb_rule++;
+        else
+            nb_bad++;
+    }
+    if (nb_rule + nb_bad < nb_row && ret != SQLITE_DONE) {
+        lgw_log(LOG_WARNING, "%s[FILTER] can't read filters: %s\n", WARNMSG, sqlite3_errmsg(db));
+        goto fail;
+    }
+    sqlite3_finalize(stmt);
+    stmt = NULL;
+
+    if (nb_bad > 0)
+        lgw_log(LOG_WARNING, "%s[FILTER] %d malformed filters ignored\n", WARNMSG, nb_bad);
+
+    set = set_compile(rule, nb_rule);
+    if (set == NULL)
+        goto fail;
+    if (rule != NULL)
+        lgw_free(rule);
+
+    devskey_tab_swap(&filters, set);
+
+    lgw_log(LOG_INFO, "%s[FILTER] %d filters of %d services loaded\n", INFOMSG, nb_rule, set->nb_serv);
+    return nb_rule;
+
+fail:
+    if (stmt != NULL)
+        sqlite3_finalize(stmt);
+    if (rule != NULL)
+        lgw_free(rule);
+    return -1;                                  /*!> no retry until the file changes */
+}
+
+int pkt_filter_init(void) {
+    return devskey_watch(pkt_filter_load);
+}
+
+void pkt_filter_free(void) {
+    devskey_tab_free(&filters);
+}
@@ -0,0 +1,260 @@
+/*!>
+ *  ____  ____      _    ____ ___ _   _  ___
+ *  |  _ \|  _ \    / \  / ___|_ _| \ | |/ _ \
+ *  | | | | |_) |  / _ \| |  _ | ||  \| | | | |
+ *  | |_| |  _ <  / ___ \ |_| || || |\  | |_| |
+ *  |____/|_| \_\/_/   \_\____|___|_| \_|\___/
+ *
+ * Dragino_gw_fwd -- An opensource lora gateway forward
+ *
+ * See http://www.dragino.com for more information about
+ * the lora gateway project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ *
+ * Maintainer: skerlan
+ *
+ */
+
+/*!>!
+ * \file
+ * \brief
+ *  Description: network event loop. Sockets and timerfd timers of all
+ *  services are watched by one epoll thread, handlers are called from it.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#include "fwd.h"
+#include "reactor.h"
+
+typedef struct _reactor_handler {
+    int fd;
+    bool timer;                 /*!> fd is a timerfd owned by reactor */
+    bool dead;                  /*!> removed, freed by reactor thread */
+    reactor_fd_cb fd_cb;
+    reactor_timer_cb timer_cb;
+    void* arg;
+    LGW_LIST_ENTRY(_reactor_handler) list;
+} reactor_handler_s;
+
+LGW_LIST_HEAD_NOLOCK(reactor_list, _reactor_handler);
+
+static struct reactor_list handlers = LGW_LIST_HEAD_NOLOCK_INIT_VALUE;
+
+/*!> handler list and epoll set, not held while a callback runs */
+static pthread_mutex_t mx_reactor = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cd_idle = PTHREAD_COND_INITIALIZER;   /*!> running handler is back */
+static reactor_handler_s* running = NULL;       /*!> handler whose callback is running */
+
+static int epfd = -1;
+static pthread_t thrid_reactor;
+static volatile bool reactor_stop_sig = false;
+
+static void thread_reactor(void);
+
+static reactor_handler_s* handler_add(int fd, bool timer, reactor_fd_cb fd_cb, reactor_timer_cb timer_cb, void* arg) {
+    struct epoll_event ev;
+    reactor_handler_s* h;
+
+    h = (reactor_handler_s*)lgw_malloc(sizeof(reactor_handler_s));
+    if (h == NULL)
+        return NULL;
+
+    h->fd = fd;
+    h->timer = timer;
+    h->dead = false;
+    h->fd_cb = fd_cb;
+    h->timer_cb = timer_cb;
+    h->arg = arg;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = h;
+
+    pthread_mutex_lock(&mx_reactor);
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        pthread_mutex_unlock(&mx_reactor);
+        lgw_log(LOG_WARNING, "%s[REACTOR] can't watch fd(%d): %s\n", WARNMSG, fd, strerror(errno));
+        lgw_free(h);
+        return NULL;
+    }
+    LGW_LIST_INSERT_HEAD(&handlers, h, list);
+    pthread_mutex_unlock(&mx_reactor);
+
+    return h;
+}
+
+static void handler_del(int fd, bool timer) {
+    reactor_handler_s* h;
+
+    pthread_mutex_lock(&mx_reactor);
+    LGW_LIST_TRAVERSE(&handlers, h, list) {
+        if (h->fd == fd && h->timer == timer && !h->dead) {
+            epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL);
+            h->dead = true;
+            if (timer)
+                close(fd);
+            /*!> the callback may be running, wait for it unless it removes itself */
+            if (!pthread_equal(pthread_self(), thrid_reactor)) {
+                while (running == h)
+                    pthread_cond_wait(&cd_idle, &mx_reactor);
+            }
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mx_reactor);
+}
+
+/*!> free the handlers removed, only reactor thread does it so no event is pending on them */
+static void handler_sweep(void) {
+    reactor_handler_s* h;
+
+    LGW_LIST_TRAVERSE_SAFE_BEGIN(&handlers, h, list) {
+        if (h->dead) {
+            LGW_LIST_REMOVE_CURRENT(list);
+            lgw_free(h);
+        }
+    }
+    LGW_LIST_TRAVERSE_SAFE_END;
+}
+
+int reactor_start(void) {
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd == -1) {
+        lgw_log(LOG_ERROR, "%s[REACTOR] epoll_create1 failed: %s\n", ERRMSG, strerror(errno));
+        return -1;
+    }
+
+    reactor_stop_sig = false;
+    if (lgw_pthread_create(&thrid_reactor, NULL, (void *(*)(void *))thread_reactor, NULL)) {
+        lgw_log(LOG_ERROR, "%s[THREAD] impossible to create reactor thread\n", ERRMSG);
+        close(epfd);
+        epfd = -1;
+        return -1;
+    }
+
+    return 0;
+}
+
+void reactor_stop(void) {
+    reactor_handler_s* h;
+
+    if (epfd == -1)
+        return;
+
+    reactor_stop_sig = true;
+    pthread_join(thrid_reactor, NULL);
+
+    LGW_LIST_TRAVERSE_SAFE_BEGIN(&handlers, h, list) {
+        if (h->timer && !h->dead)
+            close(h->fd);
+        LGW_LIST_REMOVE_CURRENT(list);
+        lgw_free(h);
+    }
+    LGW_LIST_TRAVERSE_SAFE_END;
+
+    close(epfd);
+    epfd = -1;
+}
+
+int reactor_add_fd(int fd, reactor_fd_cb cb, void* arg) {
+    if (fd < 0 || cb == NULL)
+        return -1;
+
+    return handler_add(fd, false, cb, NULL, arg) == NULL ? -1 : 0;
+}
+
+void reactor_del_fd(int fd) {
+    if (fd < 0)
+        return;
+
+    handler_del(fd, false);
+}
+
+int reactor_add_timer(int interval_ms, reactor_timer_cb cb, void* arg) {
+    struct itimerspec its;
+    int tfd;
+
+    if (interval_ms <= 0 || cb == NULL)
+        return -1;
+
+    tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (tfd == -1) {
+        lgw_log(LOG_WARNING, "%s[REACTOR] timerfd_create failed: %s\n", WARNMSG, strerror(errno));
+        return -1;
+    }
+
+    its.it_interval.tv_sec = interval_ms / 1000;
+    its.it_interval.tv_nsec = (interval_ms % 1000) * 1000000L;
+    its.it_value = its.it_interval;
+    timerfd_settime(tfd, 0, &its, NULL);
+
+    if (handler_add(tfd, true, NULL, cb, arg) == NULL) {
+        close(tfd);
+        return -1;
+    }
+
+    return tfd;
+}
+
+void reactor_del_timer(int timer) {
+    if (timer < 0)
+        return;
+
+    handler_del(timer, true);
+}
+
+static void thread_reactor(void) {
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+    reactor_handler_s* h;
+    uint64_t expired;
+    int i, nb;
+
+    lgw_log(LOG_INFO, "%s[THREAD] Starting network reactor thread.\n", INFOMSG);
+
+    while (!reactor_stop_sig) {
+        /*!> wake up from time to time to see the stop signal */
+        nb = epoll_wait(epfd, events, REACTOR_MAX_EVENTS, 1000);
+        if (nb == -1) {
+            if (errno != EINTR)
+                lgw_log(LOG_ERROR, "%s[REACTOR] epoll_wait failed: %s\n", ERRMSG, strerror(errno));
+            continue;
+        }
+
+        /*!> callbacks run unlocked, so they and other threads can add or remove handlers */
+        pthread_mutex_lock(&mx_reactor);
+        for (i = 0; i < nb; i++) {
+            h = (reactor_handler_s*)events[i].data.ptr;
+            if (h->dead)    /*!> removed by a previous handler of this round */
+                continue;
+            /*!> timerfd is closed by handler_del, read it while the handler is known alive */
+            if (h->timer && read(h->fd, &expired, sizeof(expired)) != sizeof(expired))
+                continue;
+            running = h;
+            pthread_mutex_unlock(&mx_reactor);
+            if (h->timer) {
+                h->timer_cb(h->arg);
+            } else {
+                h->fd_cb(h->fd, events[i].events, h->arg);
+            }
+            pthread_mutex_lock(&mx_reactor);
+            running = NULL;
+            pthread_cond_broadcast(&cd_idle);
+        }
+        handler_sweep();
+        pthread_mutex_unlock(&mx_reactor);
+    }
+
+    lgw_log(LOG_INFO, "%s[THREAD] End of network reactor thread\n", INFOMSG);
+}
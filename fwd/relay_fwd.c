@@ -0,0 +1,386 @@
+/*!>
+ *  ____  ____      _    ____ ___ _   _  ___
+ *  |  _ \|  _ \    / \  / ___|_ _| \ | |/ _ \
+ *  | | | | |_) |  / _ \| |  _ | ||  \| | | | |
+ *  | |_| |  _ <  / ___ \ |_| || || |\  | |_| |
+ *  |____/|_| \_\/_/   \_\____|___|_| \_|\___/
+ *
+ * Dragino_gw_fwd -- An opensource lora gateway forward
+ *
+ * See http://www.dragino.com for more information about
+ * the lora gateway project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ *
+ * Maintainer: skerlan
+ *
+ */
+
+
+/*!>!
+ * \file
+ * \brief
+ *  Description: relay forwarding engine. An uplink is known by its
+ *  uplink_id with DevAddr and FCnt (DevEUI and DevNonce for a join), the
+ *  key is kept in a small open addressed set for RELAY_DEDUP_WINDOW_MS so
+ *  the copies coming back over the other relays, and our own forward,
+ *  are dropped. A relay gateway forwards the first copy with hop_count
+ *  raised, a gateway with relays gives it to the services. Writes to the
+ *  relay uart are queued by deadline, a downlink with an earlier count_us
+ *  goes out first and nothing is written once its time has passed.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "fwd.h"
+#include "uart.h"
+#include "timebase.h"
+#include "relay_uart.h"
+#include "relay_fwd.h"
+
+DECLARE_GW;
+
+/*!> key 0 is an empty entry */
+typedef struct {
+    uint64_t key;
+    int64_t  seen_us;
+} dedup_s;
+
+typedef struct {
+    bool     used;
+    int64_t  deadline_us;                   /*!> monotonic */
+    int      len;
+    uint8_t  data[RELAY_TX_MAX];
+} relay_tx_s;
+
+/*!> only thread_up looks at uplinks, the set has no lock */
+static dedup_s dedup[RELAY_DEDUP_NB];
+
+static relay_tx_s pool[RELAY_QUEUE_NB];
+static int order[RELAY_QUEUE_NB];           /*!> pool entries by deadline, earliest first */
+static int nb_queued = 0;
+
+static pthread_mutex_t mx_relay = PTHREAD_MUTEX_INITIALIZER;   /*!> queue */
+static pthread_cond_t cd_queue;             /*!> new write or stop, for the uart thread */
+static pthread_once_t relay_once = PTHREAD_ONCE_INIT;
+static bool stop_sig = false;
+
+static relay_fwd_stat_s relay_st;
+
+static void relay_init(void) {
+    pthread_condattr_t cattr;
+
+    pthread_condattr_init(&cattr);
+    pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+    pthread_cond_init(&cd_queue, &cattr);
+    pthread_condattr_destroy(&cattr);
+}
+
+static int64_t mono_us(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static uint64_t fnv1a(uint64_t h, const uint8_t* d, int len) {
+    while (len--) {
+        h ^= *d++;
+        h *= 0x100000001B3ULL;
+    }
+    return h;
+}
+
+/*!> uplink_id with the frame identity: DevAddr and FCnt of a data uplink,
+ *   DevEUI and DevNonce of a join request, the whole frame otherwise */
+static uint64_t uplink_key(const uplink_packet_t* up) {
+    const uint8_t* phy = up->phy_payload;
+    uint8_t id[2] = { up->uplink_id >> 8, up->uplink_id & 0xFF };
+    uint64_t h = fnv1a(0xCBF29CE484222325ULL, id, sizeof(id));
+
+    switch (up->payload_len > 0 ? phy[0] >> 5 : 0xFF) {
+        case 0x02:  /*!> unconfirmed data up */
+        case 0x04:  /*!> confirmed data up */
+            if (up->payload_len >= 12) {
+                h = fnv1a(h, phy + 1, 4);
+                h = fnv1a(h, phy + 6, 2);
+                break;
+            }
+            h = fnv1a(h, phy, up->payload_len);
+            break;
+        case 0x00:  /*!> join request */
+            if (up->payload_len >= 19) {
+                h = fnv1a(h, phy + 9, 10);
+                break;
+            }
+            h = fnv1a(h, phy, up->payload_len);
+            break;
+        default:
+            h = fnv1a(h, phy, up->payload_len);
+            break;
+    }
+
+    return h != 0 ? h : 1;
+}
+
+/*!> true when the key is in the window, otherwise it's recorded in the
+ *   first free or expired entry of the probe, or the oldest one */
+static bool dedup_seen(uint64_t key, int64_t now_us) {
+    dedup_s *e, *victim = NULL;
+    int i, idx = (int)((key ^ (key >> 32)) & (RELAY_DEDUP_NB - 1));
+
+    for (i = 0; i < RELAY_DEDUP_PROBE; i++) {
+        e = &dedup[(idx + i) & (RELAY_DEDUP_NB - 1)];
+        if (e->key != 0 && now_us - e->seen_us >= RELAY_DEDUP_WINDOW_MS * 1000LL)
+            e->key = 0;
+        if (e->key == key)
+            return true;
+        if (victim == NULL || (victim->key != 0 && (e->key == 0 || e->seen_us < victim->seen_us)))
+            victim = e;
+    }
+
+    victim->key = key;
+    victim->seen_us = now_us;
+    return false;
+}
+
+/*!> spreading factor of the data_rate field, 0 if unknown */
+static uint32_t relay_datarate(uint8_t data_rate) {
+    switch (data_rate) {
+        case 5:  return DR_LORA_SF5;
+        case 6:  return DR_LORA_SF6;
+        case 7:  return DR_LORA_SF7;
+        case 8:  return DR_LORA_SF8;
+        case 9:  return DR_LORA_SF9;
+        case 10: return DR_LORA_SF10;
+        case 11: return DR_LORA_SF11;
+        case 12: return DR_LORA_SF12;
+        default: return 0;
+    }
+}
+
+/*!> called with mx_relay held, NULL when every queued write is due before
+ *   deadline_us, otherwise the latest one is dropped to make room */
+static relay_tx_s* queue_get(int64_t deadline_us) {
+    int i;
+
+    if (nb_queued == RELAY_QUEUE_NB) {
+        STAT_INC(relay_st.nb_full);
+        if (pool[order[nb_queued - 1]].deadline_us <= deadline_us)
+            return NULL;
+        pool[order[--nb_queued]].used = false;
+    }
+    for (i = 0; i < RELAY_QUEUE_NB; i++) {
+        if (!pool[i].used)
+            break;
+    }
+    pool[i].used = true;
+    pool[i].deadline_us = deadline_us;
+    return &pool[i];
+}
+
+/*!> called with mx_relay held, same deadlines stay in arrival order */
+static void queue_insert(relay_tx_s* tx) {
+    int i;
+
+    for (i = nb_queued; i > 0 && pool[order[i - 1]].deadline_us > tx->deadline_us; i--)
+        order[i] = order[i - 1];
+    order[i] = (int)(tx - pool);
+    nb_queued++;
+    pthread_cond_signal(&cd_queue);
+}
+
+static int queue_uplink(const uplink_packet_t* up) {
+    relay_tx_s* tx;
+
+    pthread_once(&relay_once, relay_init);
+
+    pthread_mutex_lock(&mx_relay);
+    tx = queue_get(mono_us() + RELAY_UP_DEADLINE_MS * 1000LL);
+    if (tx == NULL) {
+        pthread_mutex_unlock(&mx_relay);
+        return -1;
+    }
+    tx->len = relay_frame_uplink(tx->data, sizeof(tx->data), up);
+    if (tx->len < 0) {
+        tx->used = false;
+        pthread_mutex_unlock(&mx_relay);
+        return -1;
+    }
+    queue_insert(tx);
+    pthread_mutex_unlock(&mx_relay);
+    return 0;
+}
+
+bool relay_fwd_uplink(struct lgw_pkt_rx_s* p) {
+    uplink_packet_t up;
+    uint32_t dr;
+
+    if (!unpack_uplink_packet(p->payload, p->size, &up))
+        return false;
+
+    STAT_INC(relay_st.nb_up_rcv);
+
+    if (dedup_seen(uplink_key(&up), mono_us())) {
+        STAT_INC(relay_st.nb_up_dup);
+        lgw_log(LOG_DEBUG, "%s[RELAY][UPLINK] duplicate of uplink %03X hop %u dropped\n", DEBUGMSG, up.uplink_id, up.hop_count);
+        return false;
+    }
+
+    /*!> a relay gateway never publishes what it hears on the relay channel */
+    if (GW.relay.as_relay) {
+        if (up.hop_count >= RELAY_MAX_HOP) {
+            STAT_INC(relay_st.nb_up_hop);
+            return false;
+        }
+        up.hop_count++;
+        if (queue_uplink(&up) == 0) {
+            STAT_INC(relay_st.nb_up_fwd);
+            lgw_log(LOG_DEBUG, "%s[RELAY][UPLINK] uplink %03X forwarded at hop %u\n", DEBUGMSG, up.uplink_id, up.hop_count);
+        }
+        return false;
+    }
+
+    STAT_INC(relay_st.nb_up_deliver);
+    lgw_log(LOG_DEBUG, "%s[RELAY][UPLINK] uplink %03X received after %u hops\n", DEBUGMSG, up.uplink_id, up.hop_count + 1);
+
+    dr = relay_datarate(up.data_rate);
+    if (dr != 0) {
+        p->modulation = MOD_LORA;
+        p->datarate = dr;
+    }
+    p->rssic = up.rssi;
+    p->rssis = up.rssi;
+    p->snr = up.snr;
+    p->size = up.payload_len;
+    memcpy(p->payload, up.phy_payload, up.payload_len);
+    lgw_memset(p->payload + p->size, 0, sizeof(p->payload) - p->size);
+
+    return true;
+}
+
+/*!> us to shift len bytes through the relay uart, 10 bits a byte */
+static int32_t uart_xfer_us(int len) {
+    uint32_t baud = GW.relay.tty_baude != 0 ? GW.relay.tty_baude : 9600;
+
+    return (int32_t)((int64_t)len * 10 * 1000000 / baud);
+}
+
+int relay_fwd_downlink(const struct lgw_pkt_tx_s* txpkt) {
+    relay_tx_s* tx;
+    uint8_t data[RELAY_TX_MAX];
+    uint32_t count_us;
+    int32_t d;
+    int len;
+
+    pthread_once(&relay_once, relay_init);
+
+    len = relay_format_downlink(data, sizeof(data), txpkt, GW.relay.frame);
+    if (len < 0) {
+        lgw_log(LOG_ERROR, "%s[RELAY][DOWNLINK] can't frame downlink of %u bytes\n", ERRMSG, txpkt->size);
+        return -1;
+    }
+    if (GW.relay.frame == RELAY_FRAME_AT)
+        lgw_log(LOG_DEBUG, "%s[RELAY][AT-SEND] %s \n", DEBUGMSG, (char*)data);
+
+    /*!> the write must be through the uart, plus the relay lead, by the TX instant.
+     *  Without the counter the downlink keeps the uplink deadline */
+    if (timebase_now(&count_us) == 0)
+        d = (int32_t)(txpkt->count_us - count_us) - uart_xfer_us(len) - RELAY_DN_LEAD_MS * 1000;
+    else
+        d = RELAY_UP_DEADLINE_MS * 1000;
+    if (d <= 0) {
+        STAT_INC(relay_st.nb_late);
+        return -1;
+    }
+
+    pthread_mutex_lock(&mx_relay);
+    tx = queue_get(mono_us() + d);
+    if (tx == NULL) {
+        pthread_mutex_unlock(&mx_relay);
+        return -1;
+    }
+    tx->len = len;
+    memcpy(tx->data, data, len);
+    queue_insert(tx);
+    pthread_mutex_unlock(&mx_relay);
+
+    STAT_INC(relay_st.nb_dn_queued);
+    return 0;
+}
+
+void thread_relay_fwd(void) {
+    struct timespec wake;
+    uint8_t buf[RELAY_TX_MAX];
+    relay_tx_s* tx;
+    int len;
+
+    pthread_once(&relay_once, relay_init);
+
+    lgw_log(LOG_INFO, "%s[RELAY] start relay forwarding\n", INFOMSG);
+
+    pthread_mutex_lock(&mx_relay);
+    while (!stop_sig) {
+        if (nb_queued == 0) {
+            clock_gettime(CLOCK_MONOTONIC, &wake);
+            wake.tv_sec += RELAY_IDLE_WAIT_MS / 1000;
+            pthread_cond_timedwait(&cd_queue, &mx_relay, &wake);
+            continue;
+        }
+
+        tx = &pool[order[0]];
+        nb_queued--;
+        memmove(order, order + 1, nb_queued * sizeof(order[0]));
+        tx->used = false;
+
+        /*!> a downlink deadline already leaves room for the uart transfer */
+        if (tx->deadline_us <= mono_us()) {
+            STAT_INC(relay_st.nb_late);
+            continue;
+        }
+
+        /*!> the uart is slow, the queue stays open while writing */
+        len = tx->len;
+        memcpy(buf, tx->data, len);
+        pthread_mutex_unlock(&mx_relay);
+
+        if (uart_send(GW.relay.tty_fd, (char*)buf, len) == -1)
+            lgw_log(LOG_ERROR, "%s[RELAY] cannot write %d bytes to relay uart\n", ERRMSG, len);
+        else
+            STAT_INC(relay_st.nb_sent);
+
+        pthread_mutex_lock(&mx_relay);
+    }
+    pthread_mutex_unlock(&mx_relay);
+
+    lgw_log(LOG_INFO, "%s[THREAD][RELAY] Exited!\n", INFOMSG);
+}
+
+void relay_fwd_stop(void) {
+    pthread_once(&relay_once, relay_init);
+
+    pthread_mutex_lock(&mx_relay);
+    stop_sig = true;
+    pthread_cond_signal(&cd_queue);
+    pthread_mutex_unlock(&mx_relay);
+}
+
+#define STAT_COPY(f)    st->f = reset ? STAT_TAKE(relay_st.f) : STAT_GET(relay_st.f)
+
+void relay_fwd_stat(relay_fwd_stat_s* st, bool reset) {
+    STAT_COPY(nb_up_rcv);
+    STAT_COPY(nb_up_dup);
+    STAT_COPY(nb_up_hop);
+    STAT_COPY(nb_up_fwd);
+    STAT_COPY(nb_up_deliver);
+    STAT_COPY(nb_dn_queued);
+    STAT_COPY(nb_sent);
+    STAT_COPY(nb_late);
+    STAT_COPY(nb_full);
+}
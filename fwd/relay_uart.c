@@ -0,0 +1,159 @@
+/*!>
+ *  ____  ____      _    ____ ___ _   _  ___
+ *  |  _ \|  _ \    / \  / ___|_ _| \ | |/ _ \
+ *  | | | | |_) |  / _ \| |  _ | ||  \| | | | |
+ *  | |_| |  _ <  / ___ \ |_| || || |\  | |_| |
+ *  |____/|_| \_\/_/   \_\____|___|_| \_|\___/
+ *
+ * Dragino_gw_fwd -- An opensource lora gateway forward
+ *
+ * See http://www.dragino.com for more information about
+ * the lora gateway project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ *
+ * Maintainer: skerlan
+ *
+ */
+
+
+/*!>!
+ * \file
+ * \brief
+ *  Description: relay uart framing. The AT path spells every byte of a
+ *  downlink in hex, the binary frame sends the relay protocol packet as
+ *  is, about half the bytes on the uart for the same downlink. Uplinks
+ *  forwarded to the next hop are binary frames.
+*/
+
+#include <string.h>
+#include <stdio.h>
+
+#include "relay_uart.h"
+
+/*!> CRC-16/CCITT-FALSE */
+static uint16_t frame_crc(const uint8_t* d, int len) {
+    uint16_t crc = 0xFFFF;
+    int i;
+
+    while (len--) {
+        crc ^= (uint16_t)*d++ << 8;
+        for (i = 0; i < 8; i++)
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+/*!> spreading factor in the 4 bits data_rate field, 0 for FSK */
+static uint8_t relay_data_rate(const struct lgw_pkt_tx_s* txpkt) {
+    if (txpkt->modulation != MOD_LORA)
+        return 0;
+    switch (txpkt->datarate) {
+        case DR_LORA_SF5:  return 5;
+        case DR_LORA_SF6:  return 6;
+        case DR_LORA_SF7:  return 7;
+        case DR_LORA_SF8:  return 8;
+        case DR_LORA_SF9:  return 9;
+        case DR_LORA_SF10: return 10;
+        case DR_LORA_SF11: return 11;
+        case DR_LORA_SF12: return 12;
+        default:           return 0;
+    }
+}
+
+/*!> SOF, length and CRC around the relay packet already at buf + 3 */
+static int frame_wrap(uint8_t* buf, int len) {
+    uint16_t crc;
+
+    buf[0] = RELAY_FRAME_SOF;
+    buf[1] = len >> 8;
+    buf[2] = len & 0xFF;
+
+    crc = frame_crc(buf + 1, len + 2);
+    buf[len + 3] = crc >> 8;
+    buf[len + 4] = crc & 0xFF;
+
+    return len + RELAY_FRAME_OVERHEAD;
+}
+
+int relay_frame_downlink(uint8_t* buf, int size, const struct lgw_pkt_tx_s* txpkt) {
+    downlink_packet_t dp;
+    int len;
+
+    if (txpkt->size > MAX_PHY_PAYLOAD_LEN || size < RELAY_FRAME_OVERHEAD)
+        return -1;
+
+    /*!> tx power and delay are left to the relay, as with AT+SEND */
+    init_downlink_packet(&dp);
+    dp.dwlink_id = generate_dwlink_id();
+    dp.data_rate = relay_data_rate(txpkt);
+    dp.frequency = txpkt->freq_hz;
+    dp.count_us = txpkt->count_us;
+    dp.payload_len = txpkt->size;
+    memcpy(dp.phy_payload, txpkt->payload, txpkt->size);
+
+    len = encode_downlink_packet(&dp, buf + 3, size - RELAY_FRAME_OVERHEAD);
+    if (len < 0)
+        return -1;
+
+    return frame_wrap(buf, len);
+}
+
+int relay_frame_uplink(uint8_t* buf, int size, const uplink_packet_t* up) {
+    int len;
+
+    if (size < RELAY_FRAME_OVERHEAD)
+        return -1;
+
+    len = encode_uplink_packet(up, buf + 3, size - RELAY_FRAME_OVERHEAD);
+    if (len < 0)
+        return -1;
+
+    return frame_wrap(buf, len);
+}
+
+/*!> AT+SEND command: direction, count_us and payload in hex */
+int relay_at_downlink(char* buffer, int size, const struct lgw_pkt_tx_s* txpkt) {
+    char payload_to_hex[512] = {'\0'};  
+    char count_hex[9];
+    int i, j;
+
+    /*!> about downlink, I wanto pack all txpkt, But I think
+     *   count_us: enough!
+     *   all downlink use node rx window2
+     **/
+
+    sprintf(&payload_to_hex[0], "%02x", RELAY_DN);   /*!> paylad direction */
+    sprintf(count_hex, "%08x", txpkt->count_us);  
+#ifdef BIGENDIAN
+    payload_to_hex[2] = count_hex[6];         /*! count us */
+    payload_to_hex[3] = count_hex[7];
+    payload_to_hex[4] = count_hex[4];
+    payload_to_hex[5] = count_hex[5];
+    payload_to_hex[6] = count_hex[2];
+    payload_to_hex[7] = count_hex[3];
+    payload_to_hex[8] = count_hex[0];
+    payload_to_hex[9] = count_hex[1];
+#else
+    memcpy(&payload_to_hex[2], count_hex, 8);
+#endif
+
+    for (i = 0, j = 10; i < txpkt->size && j < (int)sizeof(payload_to_hex) - 2; ++i) {    /*!> pyload */
+        sprintf(&payload_to_hex[j], "%02x", txpkt->payload[i]);
+        j += 2;
+    }
+
+    snprintf(buffer, size, "AT+SEND=0,%s,0,0\r\n", payload_to_hex);
+
+    return strlen(buffer) + 1;
+}
+
+int relay_format_downlink(uint8_t* buf, int size, const struct lgw_pkt_tx_s* txpkt, relay_frame_e frame) {
+    if (frame == RELAY_FRAME_BIN)
+        return relay_frame_downlink(buf, size, txpkt);
+    else
+        return relay_at_downlink((char*)buf, size, txpkt);
+}
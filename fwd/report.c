@@ -45,9 +45,22 @@
 #include "parson.h"
 #include "loragw_hal.h"
 #include "loragw_gps.h"
+#include "wire_bin.h"
+#include "timebase.h"
+#include "concent.h"
+#include "lbt.h"
+#include "relay_fwd.h"
 
 DECLARE_GW;
 
+static uint32_t cp_fetch_hist[FETCH_HIST_NB];  /*!> fetch latency of the last interval, shared by all reports */
+static uint32_t cp_jit_hist[JIT_HIST_NB];      /*!> jit dispatch lateness of the last interval */
+static timebase_stat_s cp_timebase;            /*!> counter time base accuracy of the last interval */
+static concent_wait_s cp_concent[CONCENT_OP_NB];  /*!> concentrator waits of the last interval */
+static lbt_stat_s cp_lbt;                       /*!> LBT assessments of the last interval */
+static relay_fwd_stat_s cp_relay;               /*!> relay forwarding of the last interval */
+static uint32_t cp_rxpkts_skip;                 /*!> rxpkts slots skipped because a service held them */
+
 static void semtech_report(serv_s *serv) {
     int i;
     time_t current_time;
@@ -62,6 +75,7 @@ static void semtech_report(serv_s *serv) {
     uint32_t cp_up_payload_byte = 0;
     uint32_t cp_up_dgram_sent = 0;
     uint32_t cp_up_ack_rcv = 0;
+    uint32_t cp_up_queue_drop = 0;
     uint32_t cp_dw_pull_sent = 0;
     uint32_t cp_dw_ack_rcv = 0;
     uint32_t cp_dw_dgram_rcv = 0;
@@ -98,38 +112,29 @@ static void semtech_report(serv_s *serv) {
     float up_ack_ratio;
     float dw_ack_ratio;
 
-    /*!> access upstream statistics, copy and reset them */
-    pthread_mutex_lock(&(serv->report->mx_report));
-
-    cp_nb_rx_rcv = serv->report->stat_up.meas_nb_rx_rcv;
-    cp_nb_rx_ok = serv->report->stat_up.meas_nb_rx_ok;
-    cp_nb_rx_bad = serv->report->stat_up.meas_nb_rx_bad;
-    cp_nb_rx_nocrc = serv->report->stat_up.meas_nb_rx_nocrc;
-    cp_up_pkt_fwd = serv->report->stat_up.meas_up_pkt_fwd;
-    cp_up_network_byte = serv->report->stat_up.meas_up_network_byte;
-    cp_up_payload_byte = serv->report->stat_up.meas_up_payload_byte;
-
-    cp_nb_rx_drop = cp_nb_rx_rcv - cp_nb_rx_ok - cp_nb_rx_bad - cp_nb_rx_nocrc;
-
-    cp_up_dgram_sent = serv->report->stat_up.meas_up_dgram_sent;
-    cp_up_ack_rcv = serv->report->stat_up.meas_up_ack_rcv;
-
-    serv->report->stat_up.meas_nb_rx_rcv = 0;
-    serv->report->stat_up.meas_nb_rx_ok = 0;
-    serv->report->stat_up.meas_nb_rx_bad = 0;
-    serv->report->stat_up.meas_nb_rx_nocrc = 0;
-    serv->report->stat_up.meas_up_pkt_fwd = 0;
-    serv->report->stat_up.meas_up_network_byte = 0;
-    serv->report->stat_up.meas_up_payload_byte = 0;
-    serv->report->stat_up.meas_up_dgram_sent = 0;
-    serv->report->stat_up.meas_up_ack_rcv = 0;
-
-    /*!> get timestamp for statistics (must be done inside the lock) */
+    /*!> take upstream statistics, workers keep counting meanwhile
+     *  received is taken last, so it covers every packet counted as ok/bad/nocrc */
+    cp_nb_rx_ok = STAT_TAKE(serv->report->stat_up.meas_nb_rx_ok);
+    cp_nb_rx_bad = STAT_TAKE(serv->report->stat_up.meas_nb_rx_bad);
+    cp_nb_rx_nocrc = STAT_TAKE(serv->report->stat_up.meas_nb_rx_nocrc);
+    cp_nb_rx_rcv = STAT_TAKE(serv->report->stat_up.meas_nb_rx_rcv);
+    cp_up_pkt_fwd = STAT_TAKE(serv->report->stat_up.meas_up_pkt_fwd);
+    cp_up_network_byte = STAT_TAKE(serv->report->stat_up.meas_up_network_byte);
+    cp_up_payload_byte = STAT_TAKE(serv->report->stat_up.meas_up_payload_byte);
+
+    if (cp_nb_rx_rcv > cp_nb_rx_ok + cp_nb_rx_bad + cp_nb_rx_nocrc)
+        cp_nb_rx_drop = cp_nb_rx_rcv - cp_nb_rx_ok - cp_nb_rx_bad - cp_nb_rx_nocrc;
+    else
+        cp_nb_rx_drop = 0;
+
+    cp_up_dgram_sent = STAT_TAKE(serv->report->stat_up.meas_up_dgram_sent);
+    cp_up_ack_rcv = STAT_TAKE(serv->report->stat_up.meas_up_ack_rcv);
+
+    cp_up_queue_drop = __atomic_exchange_n(&serv->push.nb_drop, 0, __ATOMIC_RELAXED);
+
     current_time = time(NULL);
     serv->state.stall_time = (int)(current_time - serv->state.contact);
 
-    pthread_mutex_unlock(&serv->report->mx_report);
-
     /*!> Do the math */
     strftime(stat_timestamp, sizeof stat_timestamp, "%F %T %Z", gmtime(&current_time));
     strftime(iso_timestamp, sizeof stat_timestamp, "%FT%TZ", gmtime(&current_time));
@@ -150,49 +155,26 @@ static void semtech_report(serv_s *serv) {
         up_ack_ratio = 0.0;
     }
 
-    /*!> access downstream statistics, copy and reset them */
+    /*!> take downstream statistics */
+    cp_dw_pull_sent = STAT_TAKE(serv->report->stat_down.meas_dw_pull_sent);
+    cp_dw_ack_rcv = STAT_TAKE(serv->report->stat_down.meas_dw_ack_rcv);
+    cp_dw_dgram_rcv = STAT_TAKE(serv->report->stat_down.meas_dw_dgram_rcv);
+    cp_dw_dgram_acp = STAT_TAKE(serv->report->stat_down.meas_dw_dgram_acp);
 
-    pthread_mutex_lock(&serv->report->mx_report);
-
-    cp_dw_pull_sent  = serv->report->stat_down.meas_dw_pull_sent;
-    cp_dw_ack_rcv = serv->report->stat_down.meas_dw_ack_rcv;
-    cp_dw_dgram_rcv = serv->report->stat_down.meas_dw_dgram_rcv;
-    cp_dw_dgram_acp = serv->report->stat_down.meas_dw_dgram_acp;
-
-    cp_dw_network_byte = serv->report->stat_down.meas_dw_network_byte;
-    cp_dw_payload_byte = serv->report->stat_down.meas_dw_payload_byte;
-    cp_nb_tx_ok = serv->report->stat_down.meas_nb_tx_ok;
-    cp_nb_tx_fail = serv->report->stat_down.meas_nb_tx_fail;
+    cp_dw_network_byte = STAT_TAKE(serv->report->stat_down.meas_dw_network_byte);
+    cp_dw_payload_byte = STAT_TAKE(serv->report->stat_down.meas_dw_payload_byte);
+    cp_nb_tx_ok = STAT_TAKE(serv->report->stat_down.meas_nb_tx_ok);
+    cp_nb_tx_fail = STAT_TAKE(serv->report->stat_down.meas_nb_tx_fail);
 
     //TODO: Why were here all '+=' instead of '='?? The summed values grow unbounded and eventually overflow!
-    cp_nb_tx_requested += serv->report->stat_down.meas_nb_tx_requested;	
-    cp_nb_tx_rejected_collision_packet += serv->report->stat_down.meas_nb_tx_rejected_collision_packet;	
-    cp_nb_tx_rejected_collision_beacon += serv->report->stat_down.meas_nb_tx_rejected_collision_beacon;	
-    cp_nb_tx_rejected_too_late += serv->report->stat_down.meas_nb_tx_rejected_too_late;	
-    cp_nb_tx_rejected_too_early += serv->report->stat_down.meas_nb_tx_rejected_too_early;	
-    cp_nb_beacon_queued += serv->report->meas_nb_beacon_queued;	
-    cp_nb_beacon_sent += serv->report->meas_nb_beacon_sent;	
-    cp_nb_beacon_rejected += serv->report->meas_nb_beacon_rejected;	
-
-    serv->report->stat_down.meas_dw_pull_sent = 0;
-    serv->report->stat_down.meas_dw_ack_rcv = 0;
-
-    serv->report->stat_down.meas_dw_dgram_rcv = 0;
-    serv->report->stat_down.meas_dw_dgram_acp = 0;
-
-    serv->report->stat_down.meas_dw_network_byte = 0;
-    serv->report->stat_down.meas_dw_payload_byte = 0;
-    serv->report->stat_down.meas_nb_tx_ok = 0;
-    serv->report->stat_down.meas_nb_tx_fail = 0;
-    serv->report->stat_down.meas_nb_tx_requested = 0;
-    serv->report->stat_down.meas_nb_tx_rejected_collision_packet = 0;
-    serv->report->stat_down.meas_nb_tx_rejected_collision_beacon = 0;
-    serv->report->stat_down.meas_nb_tx_rejected_too_late = 0;
-    serv->report->stat_down.meas_nb_tx_rejected_too_early = 0;
-    serv->report->meas_nb_beacon_queued = 0;
-    serv->report->meas_nb_beacon_sent = 0;
-    serv->report->meas_nb_beacon_rejected = 0;
-    pthread_mutex_unlock(&serv->report->mx_report);
+    cp_nb_tx_requested += STAT_TAKE(serv->report->stat_down.meas_nb_tx_requested);
+    cp_nb_tx_rejected_collision_packet += STAT_TAKE(serv->report->stat_down.meas_nb_tx_rejected_collision_packet);
+    cp_nb_tx_rejected_collision_beacon += STAT_TAKE(serv->report->stat_down.meas_nb_tx_rejected_collision_beacon);
+    cp_nb_tx_rejected_too_late += STAT_TAKE(serv->report->stat_down.meas_nb_tx_rejected_too_late);
+    cp_nb_tx_rejected_too_early += STAT_TAKE(serv->report->stat_down.meas_nb_tx_rejected_too_early);
+    cp_nb_beacon_queued += STAT_TAKE(serv->report->meas_nb_beacon_queued);
+    cp_nb_beacon_sent += STAT_TAKE(serv->report->meas_nb_beacon_sent);
+    cp_nb_beacon_rejected += STAT_TAKE(serv->report->meas_nb_beacon_rejected);
 
     if (cp_dw_pull_sent > 0) {
         dw_ack_ratio = (float)cp_dw_ack_rcv / (float)cp_dw_pull_sent;
@@ -238,11 +220,46 @@ static void semtech_report(serv_s *serv) {
     lgw_log(LOG_REPORT, "# RF packets forwarded: %u (%u bytes)\n", cp_up_pkt_fwd, cp_up_payload_byte);
     lgw_log(LOG_REPORT, "# PUSH_DATA datagrams sent: %u (%u bytes)\n", cp_up_dgram_sent, cp_up_network_byte);
     lgw_log(LOG_REPORT, "# PUSH_DATA acknowledged: %.2f%%\n", 100.0 * up_ack_ratio);
+    lgw_log(LOG_REPORT, "# RF packets dropped by full push queue: %u\n", cp_up_queue_drop);
+    lgw_log(LOG_REPORT, "# RX ring slots skipped while held: %u\n", cp_rxpkts_skip);
+    lgw_log(LOG_REPORT, "# Fetch latency (%s): <1ms:%u <2ms:%u <5ms:%u <10ms:%u <20ms:%u >=20ms:%u\n",
+                    GW.fetch.adaptive ? "adaptive" : "fixed",
+                    cp_fetch_hist[0], cp_fetch_hist[1], cp_fetch_hist[2],
+                    cp_fetch_hist[3], cp_fetch_hist[4], cp_fetch_hist[5]);
 
     lgw_log(LOG_REPORT, "### [DOWNSTREAM] ###\n");
     lgw_log(LOG_REPORT, "# PULL_DATA sent: %u (%.2f%% acknowledged)\n", cp_dw_pull_sent, 100.0 * dw_ack_ratio);
     lgw_log(LOG_REPORT, "# PULL_RESP(onse) datagrams received: %u (%u bytes)\n", cp_dw_dgram_rcv, cp_dw_network_byte);
     lgw_log(LOG_REPORT, "# RF packets sent to concentrator: %u (%u bytes)\n", (cp_nb_tx_ok + cp_nb_tx_fail), cp_dw_payload_byte);
+    lgw_log(LOG_REPORT, "# JIT dispatch lateness: <1ms:%u <2ms:%u <5ms:%u <10ms:%u <20ms:%u >=20ms:%u\n",
+                    cp_jit_hist[0], cp_jit_hist[1], cp_jit_hist[2],
+                    cp_jit_hist[3], cp_jit_hist[4], cp_jit_hist[5]);
+    lgw_log(LOG_REPORT, "# Counter time base: %u samples, %u reads, error avg %.1f us max %u us, drift %.2f ppm, %u resync\n",
+                    cp_timebase.nb_sample, cp_timebase.nb_read, cp_timebase.err_avg_us,
+                    cp_timebase.err_max_us, cp_timebase.drift_ppm, cp_timebase.nb_resync);
+    for (i = 0; i < CONCENT_OP_NB; i++) {
+        lgw_log(LOG_REPORT, "# Concentrator wait (%s): %u accesses, avg %.0f us, max %u us\n",
+                    concent_op_name(i), cp_concent[i].nb,
+                    cp_concent[i].nb > 0 ? (double)cp_concent[i].wait_sum_us / cp_concent[i].nb : 0.0,
+                    cp_concent[i].wait_max_us);
+    }
+    if (GW.lbt.lbt_tty_enabled) {
+        lgw_log(LOG_REPORT, "# LBT: %u scheduled, %u refused (no slot), %u sent without verdict\n",
+                    cp_lbt.nb_sched, cp_lbt.nb_full, cp_lbt.nb_missed);
+        for (i = 0; i < cp_lbt.nb_freq; i++) {
+            lgw_log(LOG_REPORT, "# LBT %u Hz: %u scans, %.1f%% busy, latency avg %.0f us max %u us\n",
+                    cp_lbt.freq[i].freq_hz, cp_lbt.freq[i].nb_scan,
+                    cp_lbt.freq[i].nb_scan > 0 ? 100.0 * cp_lbt.freq[i].nb_busy / cp_lbt.freq[i].nb_scan : 0.0,
+                    cp_lbt.freq[i].nb_scan > 0 ? (double)cp_lbt.freq[i].lat_sum_us / cp_lbt.freq[i].nb_scan : 0.0,
+                    cp_lbt.freq[i].lat_max_us);
+        }
+    }
+    if (GW.relay.as_relay || GW.relay.has_relay) {
+        lgw_log(LOG_REPORT, "# Relay uplinks: %u heard, %u duplicates, %u over hop limit, %u forwarded, %u delivered\n",
+                    cp_relay.nb_up_rcv, cp_relay.nb_up_dup, cp_relay.nb_up_hop, cp_relay.nb_up_fwd, cp_relay.nb_up_deliver);
+        lgw_log(LOG_REPORT, "# Relay uart: %u downlinks queued, %u written, %u late, %u queue full\n",
+                    cp_relay.nb_dn_queued, cp_relay.nb_sent, cp_relay.nb_late, cp_relay.nb_full);
+    }
     lgw_log(LOG_REPORT, "# TX errors: %u\n", cp_nb_tx_fail);
 
     if (cp_nb_tx_requested != 0) {
@@ -265,16 +282,16 @@ static void semtech_report(serv_s *serv) {
     }
     if (!strncmp(GW.hal.board, "sx1302", 6)) {
         lgw_log(LOG_REPORT, "\n### [SX1302 status] ###\n");
-        pthread_mutex_lock(&GW.hal.mx_concent);
+        concent_lock(CONCENT_OTHER);
         i = lgw_get_trigcnt(&trigcnt);
         i |= lgw_get_instcnt(&instcnt);
-        pthread_mutex_unlock(&GW.hal.mx_concent);
+        concent_unlock();
         i |= lgw_get_temperature(&temperature);
     } else {
         lgw_log(LOG_REPORT, "\n### [SX1301 status] ###\n");
-        pthread_mutex_lock(&GW.hal.mx_concent);
+        concent_lock(CONCENT_OTHER);
         i = lgw_get_trigcnt(&trigcnt);
-        pthread_mutex_unlock(&GW.hal.mx_concent);
+        concent_unlock();
     }
 
     if (i != LGW_HAL_SUCCESS) {
@@ -323,9 +340,11 @@ static void semtech_report(serv_s *serv) {
     /*!> Check which format to use */
     bool semtech_format = strcmp(serv->report->stat_format, "semtech") == 0;
     bool other_format = strcmp(serv->report->stat_format, "other") == 0;
+    bool binary_format = strcmp(serv->report->stat_format, "binary") == 0;
 
     JSON_Value *root_value = NULL;
     JSON_Object *root_object = NULL;
+    char key[64];
 
     if (other_format) {
         root_value = json_value_init_object();
@@ -365,6 +384,61 @@ static void semtech_report(serv_s *serv) {
         json_object_dotset_number(root_object, "current.down_beacon_packets_queued", cp_nb_beacon_queued);
         json_object_dotset_number(root_object, "current.down_beacon_packets_send", cp_nb_beacon_sent);
         json_object_dotset_number(root_object, "current.down_beacon_packets_rejected", cp_nb_beacon_rejected);
+        json_object_dotset_number(root_object, "current.up_queue_drop", cp_up_queue_drop);
+        json_object_dotset_number(root_object, "current.up_ring_skip", cp_rxpkts_skip);
+        json_object_dotset_string(root_object, "current.up_fetch_policy", GW.fetch.adaptive ? "adaptive" : "fixed");
+        json_object_dotset_number(root_object, "current.up_fetch_latency.lt_1ms", cp_fetch_hist[0]);
+        json_object_dotset_number(root_object, "current.up_fetch_latency.lt_2ms", cp_fetch_hist[1]);
+        json_object_dotset_number(root_object, "current.up_fetch_latency.lt_5ms", cp_fetch_hist[2]);
+        json_object_dotset_number(root_object, "current.up_fetch_latency.lt_10ms", cp_fetch_hist[3]);
+        json_object_dotset_number(root_object, "current.up_fetch_latency.lt_20ms", cp_fetch_hist[4]);
+        json_object_dotset_number(root_object, "current.up_fetch_latency.ge_20ms", cp_fetch_hist[5]);
+        json_object_dotset_number(root_object, "current.down_jit_lateness.lt_1ms", cp_jit_hist[0]);
+        json_object_dotset_number(root_object, "current.down_jit_lateness.lt_2ms", cp_jit_hist[1]);
+        json_object_dotset_number(root_object, "current.down_jit_lateness.lt_5ms", cp_jit_hist[2]);
+        json_object_dotset_number(root_object, "current.down_jit_lateness.lt_10ms", cp_jit_hist[3]);
+        json_object_dotset_number(root_object, "current.down_jit_lateness.lt_20ms", cp_jit_hist[4]);
+        json_object_dotset_number(root_object, "current.down_jit_lateness.ge_20ms", cp_jit_hist[5]);
+        json_object_dotset_number(root_object, "current.time_base.samples", cp_timebase.nb_sample);
+        json_object_dotset_number(root_object, "current.time_base.reads", cp_timebase.nb_read);
+        json_object_dotset_number(root_object, "current.time_base.resync", cp_timebase.nb_resync);
+        json_object_dotset_number(root_object, "current.time_base.error_avg_us", cp_timebase.err_avg_us);
+        json_object_dotset_number(root_object, "current.time_base.error_max_us", cp_timebase.err_max_us);
+        json_object_dotset_number(root_object, "current.time_base.drift_ppm", cp_timebase.drift_ppm);
+        for (i = 0; i < CONCENT_OP_NB; i++) {
+            snprintf(key, sizeof(key), "current.concent_wait.%s.nb", concent_op_name(i));
+            json_object_dotset_number(root_object, key, cp_concent[i].nb);
+            snprintf(key, sizeof(key), "current.concent_wait.%s.avg_us", concent_op_name(i));
+            json_object_dotset_number(root_object, key, cp_concent[i].nb > 0 ? (double)cp_concent[i].wait_sum_us / cp_concent[i].nb : 0.0);
+            snprintf(key, sizeof(key), "current.concent_wait.%s.max_us", concent_op_name(i));
+            json_object_dotset_number(root_object, key, cp_concent[i].wait_max_us);
+        }
+        if (GW.lbt.lbt_tty_enabled) {
+            json_object_dotset_number(root_object, "current.lbt.scheduled", cp_lbt.nb_sched);
+            json_object_dotset_number(root_object, "current.lbt.refused", cp_lbt.nb_full);
+            json_object_dotset_number(root_object, "current.lbt.no_verdict", cp_lbt.nb_missed);
+            for (i = 0; i < cp_lbt.nb_freq; i++) {
+                snprintf(key, sizeof(key), "current.lbt.freq.%u.scans", cp_lbt.freq[i].freq_hz);
+                json_object_dotset_number(root_object, key, cp_lbt.freq[i].nb_scan);
+                snprintf(key, sizeof(key), "current.lbt.freq.%u.busy_ratio", cp_lbt.freq[i].freq_hz);
+                json_object_dotset_number(root_object, key, cp_lbt.freq[i].nb_scan > 0 ? (double)cp_lbt.freq[i].nb_busy / cp_lbt.freq[i].nb_scan : 0.0);
+                snprintf(key, sizeof(key), "current.lbt.freq.%u.latency_avg_us", cp_lbt.freq[i].freq_hz);
+                json_object_dotset_number(root_object, key, cp_lbt.freq[i].nb_scan > 0 ? (double)cp_lbt.freq[i].lat_sum_us / cp_lbt.freq[i].nb_scan : 0.0);
+                snprintf(key, sizeof(key), "current.lbt.freq.%u.latency_max_us", cp_lbt.freq[i].freq_hz);
+                json_object_dotset_number(root_object, key, cp_lbt.freq[i].lat_max_us);
+            }
+        }
+        if (GW.relay.as_relay || GW.relay.has_relay) {
+            json_object_dotset_number(root_object, "current.relay.up_heard", cp_relay.nb_up_rcv);
+            json_object_dotset_number(root_object, "current.relay.up_duplicate", cp_relay.nb_up_dup);
+            json_object_dotset_number(root_object, "current.relay.up_hop_limit", cp_relay.nb_up_hop);
+            json_object_dotset_number(root_object, "current.relay.up_forwarded", cp_relay.nb_up_fwd);
+            json_object_dotset_number(root_object, "current.relay.up_delivered", cp_relay.nb_up_deliver);
+            json_object_dotset_number(root_object, "current.relay.dn_queued", cp_relay.nb_dn_queued);
+            json_object_dotset_number(root_object, "current.relay.uart_written", cp_relay.nb_sent);
+            json_object_dotset_number(root_object, "current.relay.late", cp_relay.nb_late);
+            json_object_dotset_number(root_object, "current.relay.queue_full", cp_relay.nb_full);
+        }
 
         memset(serv->report->status_report, 0, sizeof(serv->report->status_report));
         json_serialize_to_buffer(root_value, serv->report->status_report, STATUS_SIZE);
@@ -399,6 +473,26 @@ static void semtech_report(serv_s *serv) {
         //lgw_db_put("/fwd/pkts/report", timestr, serv->report->status_report);
     }
 
+    if (binary_format) {
+        wire_bin_stat_s st;
+        st.time = current_time;
+        st.coord_ok = (GW.gps.gps_enabled && coord_ok) || GW.gps.gps_fake_enable;
+        st.lat = cp_gps_coord.lat;
+        st.lon = cp_gps_coord.lon;
+        st.alt = cp_gps_coord.alt;
+        st.rxnb = cp_nb_rx_rcv;
+        st.rxok = cp_nb_rx_ok;
+        st.rxfw = cp_up_pkt_fwd;
+        st.ackr = 100.0 * up_ack_ratio;
+        st.dwnb = cp_dw_dgram_rcv;
+        st.txnb = cp_nb_tx_ok;
+        /*!> record size is in its header, the sender does not look for a null char */
+        wire_bin_stat_write((uint8_t*)serv->report->status_report, &st);
+        pthread_mutex_lock(&serv->report->mx_report);
+        serv->report->report_ready = true;
+        pthread_mutex_unlock(&serv->report->mx_report);
+    }
+
     lgw_log(LOG_REPORT, "\033[32m ############## [%s] REPORT ENDED ###############\033[m\n", serv->info.name);
     sem_post(&serv->thread.sema);
 
@@ -407,6 +501,24 @@ static void semtech_report(serv_s *serv) {
 
 void report_start() {
     serv_s* serv_entry;
+
+    /*!> fetch latency, jit lateness, time base, concentrator waits and LBT are gateway wide, copy and reset once per interval */
+    pthread_mutex_lock(&GW.fetch.mx_hist);
+    memcpy(cp_fetch_hist, GW.fetch.lat_hist, sizeof(cp_fetch_hist));
+    memset(GW.fetch.lat_hist, 0, sizeof(GW.fetch.lat_hist));
+    pthread_mutex_unlock(&GW.fetch.mx_hist);
+
+    pthread_mutex_lock(&GW.jit.mx_hist);
+    memcpy(cp_jit_hist, GW.jit.late_hist, sizeof(cp_jit_hist));
+    memset(GW.jit.late_hist, 0, sizeof(GW.jit.late_hist));
+    pthread_mutex_unlock(&GW.jit.mx_hist);
+
+    timebase_stat(&cp_timebase, true);
+    concent_stat(cp_concent, true);
+    lbt_stat(&cp_lbt, true);
+    relay_fwd_stat(&cp_relay, true);
+    cp_rxpkts_skip = STAT_TAKE(GW.rxpkts.nb_skip);
+
     LGW_LIST_TRAVERSE(&GW.serv_list, serv_entry, list) { 
         switch (serv_entry->info.type) {
             case semtech:
@@ -0,0 +1,280 @@
+/*!>
+ *  ____  ____      _    ____ ___ _   _  ___
+ *  |  _ \|  _ \    / \  / ___|_ _| \ | |/ _ \
+ *  | | | | |_) |  / _ \| |  _ | ||  \| | | | |
+ *  | |_| |  _ <  / ___ \ |_| || || |\  | |_| |
+ *  |____/|_| \_\/_/   \_\____|___|_| \_|\___/
+ *
+ * Dragino_gw_fwd -- An opensource lora gateway forward
+ *
+ * See http://www.dragino.com for more information about
+ * the lora gateway project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ *
+ * Maintainer: skerlan
+ *
+ */
+
+/*!>!
+ * \file
+ * \brief
+ *  Description: rxpk JSON writer. Fixed fields come from tables, numbers
+ *  are formatted by hand and payload is base64 encoded in place, the
+ *  upstream datagram is built with no snprintf call.
+*/
+
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "rxpk_json.h"
+
+/*!> JSON fragment of a HAL value */
+typedef struct {
+    uint32_t value;
+    const char *str;
+    uint8_t len;
+} rxpk_field_s;
+
+#define FIELD(v, s)     { v, s, sizeof(s) - 1 }
+
+static const rxpk_field_s stat_table[] = {
+    FIELD(STAT_CRC_OK,  ",\"stat\":1"),
+    FIELD(STAT_CRC_BAD, ",\"stat\":-1"),
+    FIELD(STAT_NO_CRC,  ",\"stat\":0"),
+};
+
+static const rxpk_field_s datr_table[] = {
+    FIELD(DR_LORA_SF5,  ",\"datr\":\"SF5"),
+    FIELD(DR_LORA_SF6,  ",\"datr\":\"SF6"),
+    FIELD(DR_LORA_SF7,  ",\"datr\":\"SF7"),
+    FIELD(DR_LORA_SF8,  ",\"datr\":\"SF8"),
+    FIELD(DR_LORA_SF9,  ",\"datr\":\"SF9"),
+    FIELD(DR_LORA_SF10, ",\"datr\":\"SF10"),
+    FIELD(DR_LORA_SF11, ",\"datr\":\"SF11"),
+    FIELD(DR_LORA_SF12, ",\"datr\":\"SF12"),
+};
+
+static const rxpk_field_s bw_table[] = {
+    FIELD(BW_125KHZ, "BW125\""),
+    FIELD(BW_250KHZ, "BW250\""),
+    FIELD(BW_500KHZ, "BW500\""),
+};
+
+static const rxpk_field_s codr_table[] = {
+    FIELD(CR_LORA_4_5, ",\"codr\":\"4/5\""),
+    FIELD(CR_LORA_4_6, ",\"codr\":\"4/6\""),
+    FIELD(CR_LORA_4_7, ",\"codr\":\"4/7\""),
+    FIELD(CR_LORA_4_8, ",\"codr\":\"4/8\""),
+    FIELD(0,           ",\"codr\":\"OFF\""),   /*!> treat the CR0 case (mostly false sync) */
+};
+
+static const char b64_table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+#define PUT_STR(d, s)   do { memcpy(d, s, sizeof(s) - 1); d += sizeof(s) - 1; } while (0)
+
+static char* put_field(char* d, const rxpk_field_s* table, int nb, uint32_t value) {
+    int i;
+    for (i = 0; i < nb; i++) {
+        if (table[i].value == value) {
+            memcpy(d, table[i].str, table[i].len);
+            return d + table[i].len;
+        }
+    }
+    return NULL;
+}
+
+static char* put_u32(char* d, uint32_t v) {
+    char tmp[10];
+    int n = 0;
+
+    do {
+        tmp[n++] = '0' + (v % 10);
+        v /= 10;
+    } while (v != 0);
+
+    while (n > 0)
+        *d++ = tmp[--n];
+
+    return d;
+}
+
+static char* put_i32(char* d, int32_t v) {
+    if (v < 0) {
+        *d++ = '-';
+        return put_u32(d, (uint32_t)(-(int64_t)v));
+    }
+    return put_u32(d, (uint32_t)v);
+}
+
+/*!> fixed width, zero padded */
+static char* put_u32_pad(char* d, uint32_t v, int width) {
+    int i;
+    for (i = width - 1; i >= 0; i--) {
+        d[i] = '0' + (v % 10);
+        v /= 10;
+    }
+    return d + width;
+}
+
+/*!> same output as "%.0f" of roundf(v), "-0" included */
+static char* put_round(char* d, float v) {
+    float r = roundf(v);
+    if (signbit(r)) {
+        *d++ = '-';
+        r = -r;
+    }
+    return put_u32(d, (uint32_t)r);
+}
+
+/*!> same output as "%.1f": v * 10 is exact in a double and rint rounds a
+ *   tie to even as printf does, snr comes in quarter steps so 0.25 is "0.2" */
+static char* put_fixed1(char* d, float v) {
+    uint32_t t;
+    if (signbit(v)) {
+        *d++ = '-';
+        v = -v;
+    }
+    t = (uint32_t)rint((double)v * 10);
+    d = put_u32(d, t / 10);
+    *d++ = '.';
+    *d++ = '0' + t % 10;
+    return d;
+}
+
+/*!> ISO 8601, "2021-01-01T00:00:00.000000Z" */
+static char* put_iso_time(char* d, const struct timespec* utc) {
+    struct tm x;
+
+    gmtime_r(&utc->tv_sec, &x);
+    d = put_u32_pad(d, x.tm_year + 1900, 4);
+    *d++ = '-';
+    d = put_u32_pad(d, x.tm_mon + 1, 2);
+    *d++ = '-';
+    d = put_u32_pad(d, x.tm_mday, 2);
+    *d++ = 'T';
+    d = put_u32_pad(d, x.tm_hour, 2);
+    *d++ = ':';
+    d = put_u32_pad(d, x.tm_min, 2);
+    *d++ = ':';
+    d = put_u32_pad(d, x.tm_sec, 2);
+    *d++ = '.';
+    d = put_u32_pad(d, utc->tv_nsec / 1000, 6);
+    *d++ = 'Z';
+    return d;
+}
+
+/*!> base64 with padding, written straight into the datagram */
+static char* put_b64(char* d, const uint8_t* in, int size) {
+    int i;
+    uint32_t w;
+
+    for (i = 0; i + 2 < size; i += 3) {
+        w = ((uint32_t)in[i] << 16) | ((uint32_t)in[i + 1] << 8) | in[i + 2];
+        *d++ = b64_table[(w >> 18) & 0x3F];
+        *d++ = b64_table[(w >> 12) & 0x3F];
+        *d++ = b64_table[(w >> 6) & 0x3F];
+        *d++ = b64_table[w & 0x3F];
+    }
+
+    if (size - i == 1) {
+        w = (uint32_t)in[i] << 16;
+        *d++ = b64_table[(w >> 18) & 0x3F];
+        *d++ = b64_table[(w >> 12) & 0x3F];
+        *d++ = '=';
+        *d++ = '=';
+    } else if (size - i == 2) {
+        w = ((uint32_t)in[i] << 16) | ((uint32_t)in[i + 1] << 8);
+        *d++ = b64_table[(w >> 18) & 0x3F];
+        *d++ = b64_table[(w >> 12) & 0x3F];
+        *d++ = b64_table[(w >> 6) & 0x3F];
+        *d++ = '=';
+    }
+
+    return d;
+}
+
+int rxpk_json_write(char* buf, const struct lgw_pkt_rx_s* p, const struct timespec* utc) {
+    char* d = buf;
+
+    PUT_STR(d, "{\"jver\":");
+    d = put_u32(d, PROTOCOL_JSON_RXPK_FRAME_FORMAT);
+
+    /*!> RAW timestamp */
+    PUT_STR(d, ",\"tmst\":");
+    d = put_u32(d, p->count_us);
+
+    /*!> Packet RX time */
+    if (utc != NULL) {
+        PUT_STR(d, ",\"time\":\"");
+        d = put_iso_time(d, utc);
+        *d++ = '"';
+    }
+
+    /*!> Packet concentrator channel, RF chain & RX frequency */
+    PUT_STR(d, ",\"chan\":");
+    d = put_u32(d, p->if_chain);
+    PUT_STR(d, ",\"rfch\":");
+    d = put_u32(d, p->rf_chain);
+    PUT_STR(d, ",\"freq\":");
+    d = put_u32(d, p->freq_hz / 1000000);
+    *d++ = '.';
+    d = put_u32_pad(d, p->freq_hz % 1000000, 6);
+    PUT_STR(d, ",\"mid\":");
+#ifdef SX1302MOD
+    if (p->modem_id < 10)       /*!> "%2u" */
+        *d++ = ' ';
+    d = put_u32(d, p->modem_id);
+#else
+    *d++ = '0';
+#endif
+
+    /*!> Packet status */
+    d = put_field(d, stat_table, sizeof(stat_table) / sizeof(stat_table[0]), p->status);
+    if (d == NULL)
+        return -1;
+
+    /*!> Packet modulation */
+    if (p->modulation == MOD_LORA) {
+        PUT_STR(d, ",\"modu\":\"LORA\"");
+
+        d = put_field(d, datr_table, sizeof(datr_table) / sizeof(datr_table[0]), p->datarate);
+        if (d == NULL)
+            return -1;
+        d = put_field(d, bw_table, sizeof(bw_table) / sizeof(bw_table[0]), p->bandwidth);
+        if (d == NULL)
+            return -1;
+        d = put_field(d, codr_table, sizeof(codr_table) / sizeof(codr_table[0]), p->coderate);
+        if (d == NULL)
+            return -1;
+
+        PUT_STR(d, ",\"rssis\":");
+        d = put_round(d, p->rssis);
+        PUT_STR(d, ",\"lsnr\":");
+        d = put_fixed1(d, p->snr);
+        PUT_STR(d, ",\"foff\":");
+        d = put_i32(d, p->freq_offset);
+    } else if (p->modulation == MOD_FSK) {
+        PUT_STR(d, ",\"modu\":\"FSK\",\"datr\":");
+        d = put_u32(d, p->datarate);
+    } else {
+        return -1;
+    }
+
+    /*!> Channel RSSI, payload size */
+    PUT_STR(d, ",\"rssi\":");
+    d = put_round(d, p->rssic);
+    PUT_STR(d, ",\"size\":");
+    d = put_u32(d, p->size);
+
+    /*!> Packet base64-encoded payload */
+    PUT_STR(d, ",\"data\":\"");
+    d = put_b64(d, p->payload, p->size);
+    PUT_STR(d, "\"}");
+
+    return (int)(d - buf);
+}
@@ -0,0 +1,194 @@
+/*!>
+ *  ____  ____      _    ____ ___ _   _  ___
+ *  |  _ \|  _ \    / \  / ___|_ _| \ | |/ _ \
+ *  | | | | |_) |  / _ \| |  _ | ||  \| | | | |
+ *  | |_| |  _ <  / ___ \ |_| || || |\  | |_| |
+ *  |____/|_| \_\/_/   \_\____|___|_| \_|\___/
+ *
+ * Dragino_gw_fwd -- An opensource lora gateway forward
+ *
+ * See http://www.dragino.com for more information about
+ * the lora gateway project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ *
+ * Maintainer: skerlan
+ *
+ */
+
+/*!>!
+ * \file
+ * \brief
+ *  Description: concentrator time base. The counter read on the bus is
+ *  kept with the monotonic time of the reading and the measured drift,
+ *  published under a sequence lock so readers never block or wait for
+ *  the SPI bus. Only the sampler writes, under mx_sample.
+*/
+
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "fwd.h"
+#include "timebase.h"
+#include "concent.h"
+#ifndef SX1302MOD
+#include "timersync.h"
+#endif
+
+#include "loragw_hal.h"
+
+typedef struct {
+    uint32_t count_us;          /*!> counter read at mono_ns */
+    int64_t  mono_ns;
+    double   rate;              /*!> counter us per monotonic us */
+    bool     valid;
+} timebase_s;
+
+static timebase_s base;
+static uint32_t base_seq;       /*!> odd while base is written */
+
+static pthread_mutex_t mx_sample = PTHREAD_MUTEX_INITIALIZER;  /*!> one writer, and the stats */
+
+static timebase_stat_s tb_stat;
+static double err_sum;
+static uint32_t nb_err;
+
+static int64_t mono_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (int64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+static void base_read(timebase_s* b) {
+    uint32_t seq;
+
+    do {
+        seq = __atomic_load_n(&base_seq, __ATOMIC_ACQUIRE);
+        *b = base;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || seq != __atomic_load_n(&base_seq, __ATOMIC_RELAXED));
+}
+
+/*!> mx_sample held */
+static void base_write(const timebase_s* b) {
+    uint32_t seq = base_seq;
+
+    __atomic_store_n(&base_seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    base = *b;
+    __atomic_store_n(&base_seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+static uint32_t extrapolate(const timebase_s* b, int64_t now_ns) {
+    return b->count_us + (uint32_t)llround((double)(now_ns - b->mono_ns) / 1000.0 * b->rate);
+}
+
+int timebase_sample(void) {
+#ifdef SX1302MOD
+    timebase_s b;
+    int64_t t0, t1;
+    uint32_t cnt;
+    double dt_us, err_us;
+    int i;
+
+    pthread_mutex_lock(&mx_sample);
+
+    concent_lock(CONCENT_COUNTER);
+    t0 = mono_ns();
+    i = lgw_get_instcnt(&cnt);
+    t1 = mono_ns();
+    concent_unlock();
+
+    tb_stat.nb_sample++;
+
+    if (i != LGW_HAL_SUCCESS) {
+        memset(&b, 0, sizeof(b));
+        base_write(&b);
+        pthread_mutex_unlock(&mx_sample);
+        lgw_log(LOG_WARNING, "%s[TIMEBASE] failed to read concentrator counter\n", WARNMSG);
+        return -1;
+    }
+
+    b = base;                   /*!> only writer, no need of seq */
+    b.mono_ns = t0 + (t1 - t0) / 2;
+
+    if (b.valid) {
+        dt_us = (double)(b.mono_ns - base.mono_ns) / 1000.0;
+        err_us = (double)(int32_t)(cnt - extrapolate(&base, b.mono_ns));
+
+        if (fabs(err_us) > TIMEBASE_MAX_DRIFT_PPM * 1e-6 * dt_us + TIMEBASE_READ_JITTER_US) {
+            /*!> counter was reset or base is broken */
+            b.rate = 1.0;
+            tb_stat.nb_resync++;
+            lgw_log(LOG_DEBUG, "%s[TIMEBASE] resync, counter %u is %.0f us off\n", DEBUGMSG, cnt, err_us);
+        } else {
+            err_sum += fabs(err_us);
+            nb_err++;
+            if (fabs(err_us) > tb_stat.err_max_us)
+                tb_stat.err_max_us = (uint32_t)fabs(err_us);
+            /*!> a short interval is mostly read jitter, it only checks the base */
+            if (dt_us >= TIMEBASE_SAMPLE_MS * 500)
+                b.rate += ((double)(cnt - base.count_us) / dt_us - b.rate) / TIMEBASE_DRIFT_FILT;
+        }
+    } else {
+        b.rate = 1.0;
+        b.valid = true;
+        tb_stat.nb_resync++;
+    }
+    b.count_us = cnt;
+    base_write(&b);
+
+    pthread_mutex_unlock(&mx_sample);
+#endif
+    return 0;
+}
+
+int timebase_now(uint32_t* count_us) {
+#ifdef SX1302MOD
+    timebase_s b;
+    int64_t now;
+
+    base_read(&b);
+    now = mono_ns();
+    if (!b.valid || now - b.mono_ns > (int64_t)TIMEBASE_MAX_AGE_MS * 1000000) {
+        if (timebase_sample())
+            return -1;
+        base_read(&b);
+        now = mono_ns();
+        if (!b.valid)
+            return -1;
+    }
+
+    *count_us = extrapolate(&b, now);
+    __atomic_add_fetch(&tb_stat.nb_read, 1, __ATOMIC_RELAXED);
+#else
+    get_concentrator_time(count_us);
+#endif
+    return 0;
+}
+
+void timebase_stat(timebase_stat_s* st, bool reset) {
+    timebase_s b;
+
+    base_read(&b);
+
+    pthread_mutex_lock(&mx_sample);
+    *st = tb_stat;
+    st->nb_read = __atomic_load_n(&tb_stat.nb_read, __ATOMIC_RELAXED);
+    st->err_avg_us = nb_err > 0 ? err_sum / nb_err : 0;
+    st->drift_ppm = b.valid ? (b.rate - 1.0) * 1e6 : 0;
+    if (reset) {
+        tb_stat.nb_sample = 0;
+        tb_stat.nb_resync = 0;
+        tb_stat.err_max_us = 0;
+        __atomic_fetch_sub(&tb_stat.nb_read, st->nb_read, __ATOMIC_RELAXED);
+        err_sum = 0;
+        nb_err = 0;
+    }
+    pthread_mutex_unlock(&mx_sample);
+}
@@ -0,0 +1,228 @@
+/*!>
+ *  ____  ____      _    ____ ___ _   _  ___
+ *  |  _ \|  _ \    / \  / ___|_ _| \ | |/ _ \
+ *  | | | | |_) |  / _ \| |  _ | ||  \| | | | |
+ *  | |_| |  _ <  / ___ \ |_| || || |\  | |_| |
+ *  |____/|_| \_\/_/   \_\____|___|_| \_|\___/
+ *
+ * Dragino_gw_fwd -- An opensource lora gateway forward
+ *
+ * See http://www.dragino.com for more information about
+ * the lora gateway project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ *
+ * Maintainer: skerlan
+ *
+ */
+
+
+/*!>!
+ * \file
+ * \brief
+ *  Description: cost of the Semtech UDP I/O per datagram on loopback,
+ *  one send() per PUSH_DATA against sendmmsg of a batch, as
+ *  thread_push_send does, and one recv() per ACK against recvmmsg, as
+ *  push_ack_recv and pull_down_recv do. Connected sockets, like the
+ *  service sockets. Every datagram sent must be received.
+*/
+
+#define _GNU_SOURCE     /*!> sendmmsg, recvmmsg */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define PUSH_BATCH_NB       4           /*!> as fwd.h */
+#define RECV_BATCH_NB       8           /*!> as fwd.h */
+#define BATCH_MAX           64
+#define BURST               64          /*!> datagrams sent before the receiver drains them */
+#define ROUNDS_DEFAULT      2000
+#define DGRAM_MAX           1500
+
+static uint8_t tx_buf[BATCH_MAX][DGRAM_MAX];
+static uint8_t rx_buf[BATCH_MAX][DGRAM_MAX];
+
+static double now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*!> a pair of connected UDP sockets on loopback */
+static int sock_pair(int* tx, int* rx) {
+    struct sockaddr_in a;
+    socklen_t len = sizeof(a);
+    int rcvbuf = 4 * 1024 * 1024;
+
+    *tx = socket(AF_INET, SOCK_DGRAM, 0);
+    *rx = socket(AF_INET, SOCK_DGRAM, 0);
+    if (*tx < 0 || *rx < 0)
+        return -1;
+    setsockopt(*rx, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    memset(&a, 0, sizeof(a));
+    a.sin_family = AF_INET;
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(*rx, (struct sockaddr*)&a, sizeof(a)) < 0 || getsockname(*rx, (struct sockaddr*)&a, &len) < 0)
+        return -1;
+    if (connect(*tx, (struct sockaddr*)&a, sizeof(a)) < 0)
+        return -1;
+    if (getsockname(*tx, (struct sockaddr*)&a, &len) < 0 || connect(*rx, (struct sockaddr*)&a, sizeof(a)) < 0)
+        return -1;
+    return 0;
+}
+
+static int send_burst(int fd, int size, int batch, struct mmsghdr* msgs) {
+    int i, j, nb_sent = 0;
+
+    if (batch == 1) {
+        for (i = 0; i < BURST; i++)
+            if (send(fd, tx_buf[i % BATCH_MAX], size, 0) == size)
+                nb_sent++;
+        return nb_sent;
+    }
+
+    while (nb_sent < BURST) {
+        j = BURST - nb_sent < batch ? BURST - nb_sent : batch;
+        j = sendmmsg(fd, msgs, j, 0);
+        if (j <= 0)
+            break;
+        nb_sent += j;
+    }
+    return nb_sent;
+}
+
+static int recv_burst(int fd, int batch, struct mmsghdr* msgs) {
+    int nb, nb_recv = 0;
+
+    if (batch == 1) {
+        while (recv(fd, rx_buf[0], DGRAM_MAX, MSG_DONTWAIT) > 0)
+            nb_recv++;
+        return nb_recv;
+    }
+
+    do {
+        nb = recvmmsg(fd, msgs, batch, MSG_DONTWAIT, NULL);
+        if (nb > 0)
+            nb_recv += nb;
+    } while (nb == batch);
+    return nb_recv;
+}
+
+/*!> ns per datagram to send and to receive */
+static int run(int size, int batch, int rounds, double* t_send, double* t_recv) {
+    struct mmsghdr msgs[BATCH_MAX];
+    struct iovec tx_iov[BATCH_MAX], rx_iov[BATCH_MAX];
+    int tx, rx, r, nb_sent, nb_recv;
+    double t;
+
+    if (sock_pair(&tx, &rx) < 0) {
+        printf("ERROR: loopback sockets: %s\n", strerror(errno));
+        return -1;
+    }
+
+    *t_send = 0;
+    *t_recv = 0;
+    for (r = 0; r < rounds; r++) {
+        memset(msgs, 0, sizeof(msgs));
+        for (nb_sent = 0; nb_sent < batch; nb_sent++) {
+            tx_iov[nb_sent].iov_base = tx_buf[nb_sent];
+            tx_iov[nb_sent].iov_len = size;
+            msgs[nb_sent].msg_hdr.msg_iov = &tx_iov[nb_sent];
+            msgs[nb_sent].msg_hdr.msg_iovlen = 1;
+        }
+        t = now_ns();
+        nb_sent = send_burst(tx, size, batch, msgs);
+        *t_send += now_ns() - t;
+
+        memset(msgs, 0, sizeof(msgs));
+        for (nb_recv = 0; nb_recv < batch; nb_recv++) {
+            rx_iov[nb_recv].iov_base = rx_buf[nb_recv];
+            rx_iov[nb_recv].iov_len = DGRAM_MAX;
+            msgs[nb_recv].msg_hdr.msg_iov = &rx_iov[nb_recv];
+            msgs[nb_recv].msg_hdr.msg_iovlen = 1;
+        }
+        t = now_ns();
+        nb_recv = recv_burst(rx, batch, msgs);
+        *t_recv += now_ns() - t;
+
+        if (nb_sent != BURST || nb_recv != BURST) {
+            printf("FAIL %d bytes, batch %d: %d sent, %d received of %d\n", size, batch, nb_sent, nb_recv, BURST);
+            close(tx);
+            close(rx);
+            return -1;
+        }
+    }
+
+    *t_send /= (double)rounds * BURST;
+    *t_recv /= (double)rounds * BURST;
+    close(tx);
+    close(rx);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    static const int sizes[] = { 4, 250, 1400 };    /*!> ACK, one rxpk, a full PUSH_DATA */
+    int batches[] = { 1, PUSH_BATCH_NB, RECV_BATCH_NB, 0 };
+    int i, s, b, opt, rounds = ROUNDS_DEFAULT;
+    double t_send, t_recv, t_send1 = 0, t_recv1 = 0;
+
+    while ((opt = getopt(argc, argv, "hn:k:")) != -1) {
+        switch (opt) {
+            case 'h':
+                printf("Available options:\n");
+                printf(" -h print this help\n");
+                printf(" -n <uint>  bursts of %d datagrams per case, default %d\n", BURST, ROUNDS_DEFAULT);
+                printf(" -k <uint>  also measure this batch size [2..%d]\n", BATCH_MAX);
+                return EXIT_SUCCESS;
+            case 'n':
+                rounds = atoi(optarg);
+                break;
+            case 'k':
+                batches[3] = atoi(optarg);
+                if (batches[3] >= 2 && batches[3] <= BATCH_MAX)
+                    break;
+                /* fall through */
+            default:
+                printf("ERROR: argument parsing\n");
+                return EXIT_FAILURE;
+        }
+    }
+
+    for (i = 0; i < DGRAM_MAX; i++)
+        tx_buf[0][i] = i;
+    for (i = 1; i < BATCH_MAX; i++)
+        memcpy(tx_buf[i], tx_buf[0], DGRAM_MAX);
+
+    printf(" bytes | batch | send ns/dgram | recv ns/dgram | vs one call per datagram\n");
+    for (s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++) {
+        for (b = 0; b < 4 && batches[b] > 0; b++) {
+            if (run(sizes[s], batches[b], rounds, &t_send, &t_recv) < 0)
+                return EXIT_FAILURE;
+            if (batches[b] == 1) {
+                t_send1 = t_send;
+                t_recv1 = t_recv;
+            }
+            printf(" %5d | %5d | %13.0f | %13.0f | send x%.2f recv x%.2f\n",
+                    sizes[s], batches[b], t_send, t_recv, t_send1 / t_send, t_recv1 / t_recv);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,321 @@
+/*!>
+ *  ____  ____      _    ____ ___ _   _  ___
+ *  |  _ \|  _ \    / \  / ___|_ _| \ | |/ _ \
+ *  | | | | |_) |  / _ \| |  _ | ||  \| | | | |
+ *  | |_| |  _ <  / ___ \ |_| || || |\  | |_| |
+ *  |____/|_| \_\/_/   \_\____|___|_| \_|\___/
+ *
+ * Dragino_gw_fwd -- An opensource lora gateway forward
+ *
+ * See http://www.dragino.com for more information about
+ * the lora gateway project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ *
+ * Maintainer: skerlan
+ *
+ */
+
+
+/*!>!
+ * \file
+ * \brief
+ *  Description: rxpk_json_write against the snprintf chain it replaced in
+ *  push_up_batch. Random packets, the HAL value ranges included (snr in
+ *  quarter steps, CR0, FSK), must give the same bytes. With -b both
+ *  writers are timed on typical uplinks.
+*/
+
+#define _XOPEN_SOURCE 600
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "base64.h"
+#include "rxpk_json.h"
+
+#define ROUNDS_DEFAULT      1000000
+#define BENCH_LOOPS         500000
+#define REF_BUFF_SIZE       1024
+
+/*!> the rxpk object as push_up_batch wrote it with snprintf, valid packets only */
+static int rxpk_ref_write(char* buf, const struct lgw_pkt_rx_s* p, const struct timespec* utc) {
+    int i = 0, j;
+    struct tm* x;
+
+    buf[i++] = '{';
+    i += snprintf(buf + i, REF_BUFF_SIZE - i, "\"jver\":%d", PROTOCOL_JSON_RXPK_FRAME_FORMAT);
+    i += snprintf(buf + i, REF_BUFF_SIZE - i, ",\"tmst\":%u", p->count_us);
+
+    if (utc != NULL) {
+        x = gmtime(&(utc->tv_sec));
+        i += snprintf(buf + i, REF_BUFF_SIZE - i, ",\"time\":\"%04i-%02i-%02iT%02i:%02i:%02i.%06liZ\"", (x->tm_year)+1900, (x->tm_mon)+1, x->tm_mday, x->tm_hour, x->tm_min, x->tm_sec, (utc->tv_nsec)/1000);
+    }
+
+#ifdef SX1302MOD
+    i += snprintf(buf + i, REF_BUFF_SIZE - i, ",\"chan\":%1u,\"rfch\":%1u,\"freq\":%.6lf,\"mid\":%2u", p->if_chain, p->rf_chain, ((double)p->freq_hz / 1e6), p->modem_id);
+#else
+    i += snprintf(buf + i, REF_BUFF_SIZE - i, ",\"chan\":%1u,\"rfch\":%1u,\"freq\":%.6lf,\"mid\":0", p->if_chain, p->rf_chain, ((double)p->freq_hz / 1e6));
+#endif
+
+    switch (p->status) {
+        case STAT_CRC_OK:  i += snprintf(buf + i, REF_BUFF_SIZE - i, ",\"stat\":1"); break;
+        case STAT_CRC_BAD: i += snprintf(buf + i, REF_BUFF_SIZE - i, ",\"stat\":-1"); break;
+        case STAT_NO_CRC:  i += snprintf(buf + i, REF_BUFF_SIZE - i, ",\"stat\":0"); break;
+        default: return -1;
+    }
+
+    if (p->modulation == MOD_LORA) {
+        i += snprintf(buf + i, REF_BUFF_SIZE - i, ",\"modu\":\"LORA\"");
+        switch (p->datarate) {
+            case DR_LORA_SF5:  i += snprintf(buf + i, REF_BUFF_SIZE - i, ",\"datr\":\"SF5"); break;
+            case DR_LORA_SF6:  i += snprintf(buf + i, REF_BUFF_SIZE - i, ",\"datr\":\"SF6"); break;
+            case DR_LORA_SF7:  i += snprintf(buf + i, REF_BUFF_SIZE - i, ",\"datr\":\"SF7"); break;
+            case DR_LORA_SF8:  i += snprintf(buf + i, REF_BUFF_SIZE - i, ",\"datr\":\"SF8"); break;
+            case DR_LORA_SF9:  i += snprintf(buf + i, REF_BUFF_SIZE - i, ",\"datr\":\"SF9"); break;
+            case DR_LORA_SF10: i += snprintf(buf + i, REF_BUFF_SIZE - i, ",\"datr\":\"SF10"); break;
+            case DR_LORA_SF11: i += snprintf(buf + i, REF_BUFF_SIZE - i, ",\"datr\":\"SF11"); break;
+            case DR_LORA_SF12: i += snprintf(buf + i, REF_BUFF_SIZE - i, ",\"datr\":\"SF12"); break;
+            default: return -1;
+        }
+        switch (p->bandwidth) {
+            case BW_125KHZ: i += snprintf(buf + i, REF_BUFF_SIZE - i, "BW125\""); break;
+            case BW_250KHZ: i += snprintf(buf + i, REF_BUFF_SIZE - i, "BW250\""); break;
+            case BW_500KHZ: i += snprintf(buf + i, REF_BUFF_SIZE - i, "BW500\""); break;
+            default: return -1;
+        }
+        switch (p->coderate) {
+            case CR_LORA_4_5: i += snprintf(buf + i, REF_BUFF_SIZE - i, ",\"codr\":\"4/5\""); break;
+            case CR_LORA_4_6: i += snprintf(buf + i, REF_BUFF_SIZE - i, ",\"codr\":\"4/6\""); break;
+            case CR_LORA_4_7: i += snprintf(buf + i, REF_BUFF_SIZE - i, ",\"codr\":\"4/7\""); break;
+            case CR_LORA_4_8: i += snprintf(buf + i, REF_BUFF_SIZE - i, ",\"codr\":\"4/8\""); break;
+            case 0:           i += snprintf(buf + i, REF_BUFF_SIZE - i, ",\"codr\":\"OFF\""); break;
+            default: return -1;
+        }
+        i += snprintf(buf + i, REF_BUFF_SIZE - i, ",\"rssis\":%.0f", roundf(p->rssis));
+        i += snprintf(buf + i, REF_BUFF_SIZE - i, ",\"lsnr\":%.1f", p->snr);
+        i += snprintf(buf + i, REF_BUFF_SIZE - i, ",\"foff\":%d", p->freq_offset);
+    } else if (p->modulation == MOD_FSK) {
+        i += snprintf(buf + i, REF_BUFF_SIZE - i, ",\"modu\":\"FSK\"");
+        i += snprintf(buf + i, REF_BUFF_SIZE - i, ",\"datr\":%u", p->datarate);
+    } else {
+        return -1;
+    }
+
+    i += snprintf(buf + i, REF_BUFF_SIZE - i, ",\"rssi\":%.0f,\"size\":%u", roundf(p->rssic), p->size);
+
+    i += snprintf(buf + i, REF_BUFF_SIZE - i, ",\"data\":\"");
+    j = bin_to_b64(p->payload, p->size, buf + i, 341);
+    if (j < 0)
+        return -1;
+    i += j;
+    buf[i++] = '"';
+    buf[i++] = '}';
+
+    return i;
+}
+
+static uint32_t rand32(void) {
+    return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+static float rand_float(float lo, float hi) {
+    return lo + (hi - lo) * ((float)rand() / (float)RAND_MAX);
+}
+
+static void rand_pkt(struct lgw_pkt_rx_s* p) {
+    static const uint32_t dr[] = { DR_LORA_SF5, DR_LORA_SF6, DR_LORA_SF7, DR_LORA_SF8, DR_LORA_SF9, DR_LORA_SF10, DR_LORA_SF11, DR_LORA_SF12 };
+    static const uint8_t bw[] = { BW_125KHZ, BW_250KHZ, BW_500KHZ };
+    static const uint8_t cr[] = { CR_LORA_4_5, CR_LORA_4_6, CR_LORA_4_7, CR_LORA_4_8, 0 };
+    static const uint8_t st[] = { STAT_CRC_OK, STAT_CRC_BAD, STAT_NO_CRC };
+    int i;
+
+    memset(p, 0, sizeof(*p));
+    p->freq_hz = 100000000 + rand32() % 900000001;
+    p->if_chain = rand() % 10;
+    p->rf_chain = rand() % 2;
+    p->modem_id = rand() % 16;
+    p->status = st[rand() % 3];
+    p->count_us = rand32();
+    p->rssic = rand_float(-140.0, 10.0);
+    p->size = rand() % 256;
+    for (i = 0; i < p->size; i++)
+        p->payload[i] = rand();
+
+    if (rand() % 8 != 0) {
+        p->modulation = MOD_LORA;
+        p->datarate = dr[rand() % 8];
+        p->bandwidth = bw[rand() % 3];
+        p->coderate = cr[rand() % 5];
+        p->rssis = rand_float(-140.0, 10.0);
+        p->freq_offset = (int32_t)rand32() % 200000;
+        /*!> the sx1302 HAL gives snr in quarter steps, other HALs any float */
+        if (rand() & 1)
+            p->snr = (float)((int8_t)rand()) / 4;
+        else
+            p->snr = rand_float(-30.0, 30.0);
+        /*!> rounding edges: -0, ties of both formats */
+        switch (rand() % 16) {
+            case 0: p->snr = -0.02; break;
+            case 1: p->rssis = -0.3; break;
+            case 2: p->rssic = 0.5; p->rssis = -2.5; break;
+            default: break;
+        }
+    } else {
+        p->modulation = MOD_FSK;
+        p->datarate = 500 + rand32() % 300000;
+    }
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*!> typical uplink: SF7 to SF12, 23 bytes, with time */
+static void bench(void) {
+    struct lgw_pkt_rx_s p;
+    struct timespec utc = { 1700000000, 123456789 };
+    char buf[REF_BUFF_SIZE];
+    double t_ref, t_new;
+    int i, sum = 0;
+
+    memset(&p, 0, sizeof(p));
+    p.freq_hz = 868100000;
+    p.modulation = MOD_LORA;
+    p.datarate = DR_LORA_SF7;
+    p.bandwidth = BW_125KHZ;
+    p.coderate = CR_LORA_4_5;
+    p.status = STAT_CRC_OK;
+    p.count_us = 3512348611u;
+    p.rssic = -57.3;
+    p.rssis = -59.8;
+    p.snr = 9.25;
+    p.freq_offset = -312;
+    p.size = 23;
+    for (i = 0; i < p.size; i++)
+        p.payload[i] = i * 11;
+
+    t_ref = now_ns();
+    for (i = 0; i < BENCH_LOOPS; i++)
+        sum += rxpk_ref_write(buf, &p, &utc);
+    t_ref = (now_ns() - t_ref) / BENCH_LOOPS;
+
+    t_new = now_ns();
+    for (i = 0; i < BENCH_LOOPS; i++)
+        sum += rxpk_json_write(buf, &p, &utc);
+    t_new = (now_ns() - t_new) / BENCH_LOOPS;
+
+    printf("rxpk of 23 bytes: snprintf %.0f ns, rxpk_json_write %.0f ns (%d)\n", t_ref, t_new, sum & 1);
+}
+
+int main(int argc, char **argv) {
+    struct lgw_pkt_rx_s p;
+    struct timespec utc;
+    char ref[REF_BUFF_SIZE], out[RXPK_JSON_MAX_SIZE + 16];
+    int i, opt, n_ref, n_out, nb_fail = 0, rounds = ROUNDS_DEFAULT;
+    bool do_bench = false;
+
+    while ((opt = getopt(argc, argv, "hbn:s:")) != -1) {
+        switch (opt) {
+            case 'h':
+                printf("Available options:\n");
+                printf(" -h print this help\n");
+                printf(" -b         also time both writers\n");
+                printf(" -n <uint>  random packets, default %d\n", ROUNDS_DEFAULT);
+                printf(" -s <uint>  random seed, default 1\n");
+                return EXIT_SUCCESS;
+            case 'b':
+                do_bench = true;
+                break;
+            case 'n':
+                rounds = atoi(optarg);
+                break;
+            case 's':
+                srand(strtoul(optarg, NULL, 0));
+                break;
+            default:
+                return EXIT_FAILURE;
+        }
+    }
+
+    for (i = 0; i < rounds && nb_fail < 10; i++) {
+        rand_pkt(&p);
+        utc.tv_sec = rand32() % 4102444800u;     /*!> before 2100 */
+        utc.tv_nsec = rand32() % 1000000000;
+
+        n_ref = rxpk_ref_write(ref, &p, (i & 3) ? &utc : NULL);
+        /*!> canary after the worst case */
+        memset(out, 0x55, sizeof(out));
+        n_out = rxpk_json_write(out, &p, (i & 3) ? &utc : NULL);
+
+        if (n_out != n_ref || memcmp(out, ref, n_ref) != 0 || n_out > RXPK_JSON_MAX_SIZE ||
+            out[RXPK_JSON_MAX_SIZE] != 0x55) {
+            printf("FAIL packet %d\n  ref %.*s\n  new %.*s\n", i, n_ref, ref, n_out > 0 ? n_out : 0, out);
+            nb_fail++;
+        }
+    }
+
+    /*!> every field at its widest must fit RXPK_JSON_MAX_SIZE */
+    memset(&p, 0, sizeof(p));
+    p.freq_hz = 0xFFFFFFFF;
+    p.if_chain = 0xFF;
+    p.rf_chain = 0xFF;
+    p.modem_id = 0xFF;
+    p.count_us = 0xFFFFFFFF;
+    p.status = STAT_CRC_BAD;
+    p.modulation = MOD_LORA;
+    p.datarate = DR_LORA_SF12;
+    p.bandwidth = BW_500KHZ;
+    p.coderate = CR_LORA_4_5;
+    p.rssis = -2147483520.0;      /*!> widest float below INT32_MIN in magnitude */
+    p.rssic = -2147483520.0;
+    p.snr = -128.0;
+    p.freq_offset = INT32_MIN;
+    p.size = 255;
+    utc.tv_sec = 4102444799u;
+    utc.tv_nsec = 999999999;
+    n_ref = rxpk_ref_write(ref, &p, &utc);
+    memset(out, 0x55, sizeof(out));
+    n_out = rxpk_json_write(out, &p, &utc);
+    if (n_out != n_ref || memcmp(out, ref, n_ref) != 0 || n_out > RXPK_JSON_MAX_SIZE || out[RXPK_JSON_MAX_SIZE] != 0x55) {
+        printf("FAIL widest packet, %d chars\n  ref %.*s\n  new %.*s\n", n_ref, n_ref, ref, n_out > 0 ? n_out : 0, out);
+        nb_fail++;
+    } else {
+        printf("PASS widest packet, %d chars of %d\n", n_out, RXPK_JSON_MAX_SIZE);
+    }
+
+    /*!> values the writer can't describe are refused */
+    rand_pkt(&p);
+    p.modulation = MOD_LORA;
+    p.coderate = 0x7F;
+    if (rxpk_json_write(out, &p, NULL) != -1) {
+        printf("FAIL unknown coderate not refused\n");
+        nb_fail++;
+    }
+    p.modulation = 0;
+    if (rxpk_json_write(out, &p, NULL) != -1) {
+        printf("FAIL unknown modulation not refused\n");
+        nb_fail++;
+    }
+
+    printf("%s %d random packets against the snprintf writer\n", nb_fail ? "FAIL" : "PASS", i);
+
+    if (do_bench)
+        bench();
+
+    return nb_fail ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
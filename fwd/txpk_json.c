@@ -0,0 +1,351 @@
+/*!>
+ *  ____  ____      _    ____ ___ _   _  ___
+ *  |  _ \|  _ \    / \  / ___|_ _| \ | |/ _ \
+ *  | | | | |_) |  / _ \| |  _ | ||  \| | | | |
+ *  | |_| |  _ <  / ___ \ |_| || || |\  | |_| |
+ *  |____/|_| \_\/_/   \_\____|___|_| \_|\___/
+ *
+ * Dragino_gw_fwd -- An opensource lora gateway forward
+ *
+ * See http://www.dragino.com for more information about
+ * the lora gateway project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ *
+ * Maintainer: skerlan
+ *
+ */
+
+/*!>!
+ * \file
+ * \brief
+ *  Description: txpk JSON reader. The text is scanned once, the value of
+ *  each known field is kept as a span of the text and converted when the
+ *  object is closed, "data" is base64 decoded straight into the packet.
+ *  Anything unusual is left to the parson reader.
+*/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "fwd.h"
+#include "base64.h"
+#include "txpk_json.h"
+
+enum {
+    F_IMME, F_TMST, F_TMMS, F_NCRC, F_FREQ, F_RFCH, F_POWE, F_MODU,
+    F_DATR, F_CODR, F_IPOL, F_PREA, F_FDEV, F_SIZE, F_DATA, F_NB
+};
+
+/*!> all txpk fields have 4 chars names */
+static const char field_name[F_NB][4] = {
+    "imme", "tmst", "tmms", "ncrc", "freq", "rfch", "powe", "modu",
+    "datr", "codr", "ipol", "prea", "fdev", "size", "data",
+};
+
+typedef enum { V_NONE, V_NUMBER, V_STRING, V_TRUE, V_FALSE, V_OTHER } value_type_e;
+
+/*!> value of a field, strings are given without quotes */
+typedef struct {
+    value_type_e type;
+    const char* s;
+    int len;
+} span_s;
+
+static const char* skip_ws(const char* p) {
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+        p++;
+    return p;
+}
+
+/*!> p on the opening quote, returns after the closing one, escapes are left to parson */
+static const char* scan_string(const char* p, span_s* v) {
+    const char* s = ++p;
+    while (*p != '"') {
+        if (*p == '\0' || *p == '\\')
+            return NULL;
+        p++;
+    }
+    v->type = V_STRING;
+    v->s = s;
+    v->len = (int)(p - s);
+    return p + 1;
+}
+
+static const char* scan_number(const char* p, span_s* v) {
+    const char* s = p;
+    while ((*p >= '0' && *p <= '9') || *p == '-' || *p == '+' || *p == '.' || *p == 'e' || *p == 'E')
+        p++;
+    if (p == s)
+        return NULL;
+    v->type = V_NUMBER;
+    v->s = s;
+    v->len = (int)(p - s);
+    return p;
+}
+
+/*!> skip an object or array, strings are scanned so brackets inside them are ignored */
+static const char* skip_nested(const char* p) {
+    span_s tmp;
+    int depth = 0;
+
+    do {
+        switch (*p) {
+            case '{': case '[':
+                depth++;
+                p++;
+                break;
+            case '}': case ']':
+                depth--;
+                p++;
+                break;
+            case '"':
+                p = scan_string(p, &tmp);
+                if (p == NULL)
+                    return NULL;
+                break;
+            case '\0': case '/':
+                return NULL;
+            default:
+                p++;
+                break;
+        }
+    } while (depth > 0);
+
+    return p;
+}
+
+static const char* scan_value(const char* p, span_s* v) {
+    switch (*p) {
+        case '"':
+            return scan_string(p, v);
+        case 't':
+            if (strncmp(p, "true", 4))
+                return NULL;
+            v->type = V_TRUE;
+            return p + 4;
+        case 'f':
+            if (strncmp(p, "false", 5))
+                return NULL;
+            v->type = V_FALSE;
+            return p + 5;
+        case 'n':
+            if (strncmp(p, "null", 4))
+                return NULL;
+            v->type = V_OTHER;
+            return p + 4;
+        case '{': case '[':
+            v->type = V_OTHER;
+            return skip_nested(p);
+        default:
+            return scan_number(p, v);
+    }
+}
+
+static int field_index(const char* key, int len) {
+    int i;
+    if (len != 4)
+        return -1;
+    for (i = 0; i < F_NB; i++) {
+        if (memcmp(key, field_name[i], 4) == 0)
+            return i;
+    }
+    return -1;
+}
+
+/*!> p on '{', returns after '}'
+ *  root: members other than "txpk" are skipped, txpk members are kept in fields */
+static const char* scan_object(const char* p, span_s* fields, bool root, bool* found) {
+    span_s key, val;
+    int f;
+
+    p = skip_ws(p + 1);
+    if (*p == '}')
+        return p + 1;
+
+    while (1) {
+        if (*p != '"')
+            return NULL;
+        p = scan_string(p, &key);
+        if (p == NULL)
+            return NULL;
+        p = skip_ws(p);
+        if (*p != ':')
+            return NULL;
+        p = skip_ws(p + 1);
+
+        if (root) {
+            if (key.len == 4 && memcmp(key.s, "txpk", 4) == 0) {
+                if (*p != '{' || *found)
+                    return NULL;
+                *found = true;
+                p = scan_object(p, fields, false, NULL);
+            } else {
+                p = scan_value(p, &val);
+            }
+        } else {
+            f = field_index(key.s, key.len);
+            if (f >= 0) {
+                if (fields[f].type != V_NONE)   /*!> duplicate, parson refuses it */
+                    return NULL;
+                p = scan_value(p, &fields[f]);
+            } else {
+                p = scan_value(p, &val);
+            }
+        }
+        if (p == NULL)
+            return NULL;
+
+        p = skip_ws(p);
+        if (*p == '}')
+            return p + 1;
+        if (*p != ',')
+            return NULL;
+        p = skip_ws(p + 1);
+    }
+}
+
+static double span_number(const span_s* v) {
+    return strtod(v->s, NULL);
+}
+
+static bool span_is(const span_s* v, const char* str) {
+    return v->len == (int)strlen(str) && memcmp(v->s, str, v->len) == 0;
+}
+
+int txpk_json_parse(const char* json, struct lgw_pkt_tx_s* txpkt, txpk_when_s* when, int8_t antenna_gain) {
+    span_s f[F_NB];
+    bool found = false;
+    const char* p;
+    int i;
+    short x0, x1;
+
+    memset(f, 0, sizeof(f));
+
+    p = skip_ws(json);
+    if (*p != '{')
+        return -1;
+    p = scan_object(p, f, true, &found);
+    if (p == NULL || !found || *skip_ws(p) != '\0')
+        return -1;
+
+    /*!> "immediate" tag, or target timestamp, or GPS time */
+    if (f[F_IMME].type == V_TRUE) {
+        when->imme = true;
+    } else if (f[F_TMST].type != V_NONE) {
+        if (f[F_TMST].type != V_NUMBER)
+            return -1;
+        txpkt->count_us = (uint32_t)span_number(&f[F_TMST]);
+    } else if (f[F_TMMS].type == V_NUMBER) {
+        when->tmms = true;
+        when->gps_ms = (uint64_t)span_number(&f[F_TMMS]);
+    } else {
+        return -1;
+    }
+
+    /*!> fields given with an unexpected type are left to parson */
+    if (f[F_NCRC].type != V_NONE) {
+        if (f[F_NCRC].type != V_TRUE && f[F_NCRC].type != V_FALSE)
+            return -1;
+        txpkt->no_crc = f[F_NCRC].type == V_TRUE;
+    }
+
+    if (f[F_FREQ].type != V_NUMBER || f[F_RFCH].type != V_NUMBER)
+        return -1;
+    txpkt->freq_hz = (uint32_t)((double)(1.0e6) * span_number(&f[F_FREQ]));
+    txpkt->rf_chain = (uint8_t)span_number(&f[F_RFCH]);
+
+    if (f[F_POWE].type != V_NONE) {
+        if (f[F_POWE].type != V_NUMBER)
+            return -1;
+        txpkt->rf_power = (int8_t)span_number(&f[F_POWE]) - antenna_gain;
+    }
+
+    if (f[F_MODU].type != V_STRING)
+        return -1;
+    if (span_is(&f[F_MODU], "LORA")) {
+        txpkt->modulation = MOD_LORA;
+
+        /*!> "SF12BW500" at most, the quote after it ends sscanf */
+        if (f[F_DATR].type != V_STRING || f[F_DATR].len > 9)
+            return -1;
+        if (sscanf(f[F_DATR].s, "SF%2hdBW%3hd", &x0, &x1) != 2)
+            return -1;
+        switch (x0) {
+            case  5: txpkt->datarate = DR_LORA_SF5;  break;
+            case  6: txpkt->datarate = DR_LORA_SF6;  break;
+            case  7: txpkt->datarate = DR_LORA_SF7;  break;
+            case  8: txpkt->datarate = DR_LORA_SF8;  break;
+            case  9: txpkt->datarate = DR_LORA_SF9;  break;
+            case 10: txpkt->datarate = DR_LORA_SF10; break;
+            case 11: txpkt->datarate = DR_LORA_SF11; break;
+            case 12: txpkt->datarate = DR_LORA_SF12; break;
+            default: return -1;
+        }
+        switch (x1) {
+            case 125: txpkt->bandwidth = BW_125KHZ; break;
+            case 250: txpkt->bandwidth = BW_250KHZ; break;
+            case 500: txpkt->bandwidth = BW_500KHZ; break;
+            default: return -1;
+        }
+
+        if (f[F_CODR].type != V_STRING)
+            return -1;
+        if      (span_is(&f[F_CODR], "4/5")) txpkt->coderate = CR_LORA_4_5;
+        else if (span_is(&f[F_CODR], "4/6")) txpkt->coderate = CR_LORA_4_6;
+        else if (span_is(&f[F_CODR], "2/3")) txpkt->coderate = CR_LORA_4_6;
+        else if (span_is(&f[F_CODR], "4/7")) txpkt->coderate = CR_LORA_4_7;
+        else if (span_is(&f[F_CODR], "4/8")) txpkt->coderate = CR_LORA_4_8;
+        else if (span_is(&f[F_CODR], "1/2")) txpkt->coderate = CR_LORA_4_8;
+        else return -1;
+
+        if (f[F_IPOL].type != V_NONE) {
+            if (f[F_IPOL].type != V_TRUE && f[F_IPOL].type != V_FALSE)
+                return -1;
+            txpkt->invert_pol = f[F_IPOL].type == V_TRUE;
+        }
+
+        /*!> optimum min value enforced */
+        if (f[F_PREA].type == V_NONE) {
+            txpkt->preamble = (uint16_t)STD_LORA_PREAMB;
+        } else {
+            if (f[F_PREA].type != V_NUMBER)
+                return -1;
+            i = (int)span_number(&f[F_PREA]);
+            txpkt->preamble = (uint16_t)(i >= MIN_LORA_PREAMB ? i : MIN_LORA_PREAMB);
+        }
+    } else if (span_is(&f[F_MODU], "FSK")) {
+        txpkt->modulation = MOD_FSK;
+
+        if (f[F_DATR].type != V_NUMBER || f[F_FDEV].type != V_NUMBER)
+            return -1;
+        txpkt->datarate = (uint32_t)span_number(&f[F_DATR]);
+        txpkt->f_dev = (uint8_t)(span_number(&f[F_FDEV]) / 1000.0); /*!> JSON value in Hz, txpkt.f_dev in kHz */
+
+        if (f[F_PREA].type == V_NONE) {
+            txpkt->preamble = (uint16_t)STD_FSK_PREAMB;
+        } else {
+            if (f[F_PREA].type != V_NUMBER)
+                return -1;
+            i = (int)span_number(&f[F_PREA]);
+            txpkt->preamble = (uint16_t)(i >= MIN_FSK_PREAMB ? i : MIN_FSK_PREAMB);
+        }
+    } else {
+        return -1;
+    }
+
+    if (f[F_SIZE].type != V_NUMBER || f[F_DATA].type != V_STRING)
+        return -1;
+    txpkt->size = (uint16_t)span_number(&f[F_SIZE]);
+
+    /*!> size mismatch is warned by parson reader */
+    i = b64_to_bin(f[F_DATA].s, f[F_DATA].len, txpkt->payload, sizeof(txpkt->payload));
+    if (i != txpkt->size)
+        return -1;
+
+    return 0;
+}
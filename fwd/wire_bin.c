@@ -0,0 +1,271 @@
+/*!>
+ *  ____  ____      _    ____ ___ _   _  ___
+ *  |  _ \|  _ \    / \  / ___|_ _| \ | |/ _ \
+ *  | | | | |_) |  / _ \| |  _ | ||  \| | | | |
+ *  | |_| |  _ <  / ___ \ |_| || || |\  | |_| |
+ *  |____/|_| \_\/_/   \_\____|___|_| \_|\___/
+ *
+ * Dragino_gw_fwd -- An opensource lora gateway forward
+ *
+ * See http://www.dragino.com for more information about
+ * the lora gateway project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ *
+ * Maintainer: skerlan
+ *
+ */
+
+/*!>!
+ * \file
+ * \brief
+ *  Description: binary records of rxpk, stat, txpk and txpk_ack, the
+ *  layouts are described in wire_bin.h
+*/
+
+#include <string.h>
+#include <math.h>
+
+#include "fwd.h"
+#include "wire_bin.h"
+
+/*!> HAL value and its number on the wire */
+typedef struct {
+    uint32_t hal;
+    uint32_t wire;
+} wire_map_s;
+
+static const wire_map_s sf_map[] = {
+    { DR_LORA_SF5,  5 }, { DR_LORA_SF6,  6 }, { DR_LORA_SF7,  7 }, { DR_LORA_SF8,  8 },
+    { DR_LORA_SF9,  9 }, { DR_LORA_SF10, 10 }, { DR_LORA_SF11, 11 }, { DR_LORA_SF12, 12 },
+};
+
+static const wire_map_s bw_map[] = {
+    { BW_125KHZ, 125 }, { BW_250KHZ, 250 }, { BW_500KHZ, 500 },
+};
+
+static const wire_map_s cr_map[] = {
+    { CR_LORA_4_5, 5 }, { CR_LORA_4_6, 6 }, { CR_LORA_4_7, 7 }, { CR_LORA_4_8, 8 },
+    { 0, 0 },   /*!> CR0 case (mostly false sync) */
+};
+
+#define MAP_NB(m)   (int)(sizeof(m) / sizeof(m[0]))
+
+static int to_wire(const wire_map_s* map, int nb, uint32_t hal, uint32_t* wire) {
+    int i;
+    for (i = 0; i < nb; i++) {
+        if (map[i].hal == hal) {
+            *wire = map[i].wire;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int to_hal(const wire_map_s* map, int nb, uint32_t wire, uint32_t* hal) {
+    int i;
+    for (i = 0; i < nb; i++) {
+        if (map[i].wire == wire) {
+            *hal = map[i].hal;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static uint8_t* put_u16(uint8_t* d, uint16_t v) {
+    d[0] = v & 0xFF;
+    d[1] = v >> 8;
+    return d + 2;
+}
+
+static uint8_t* put_u32(uint8_t* d, uint32_t v) {
+    d[0] = v & 0xFF;
+    d[1] = (v >> 8) & 0xFF;
+    d[2] = (v >> 16) & 0xFF;
+    d[3] = v >> 24;
+    return d + 4;
+}
+
+static uint8_t* put_u64(uint8_t* d, uint64_t v) {
+    d = put_u32(d, (uint32_t)v);
+    return put_u32(d, (uint32_t)(v >> 32));
+}
+
+static uint16_t get_u16(const uint8_t* s) {
+    return (uint16_t)(s[0] | (s[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t* s) {
+    return (uint32_t)s[0] | ((uint32_t)s[1] << 8) | ((uint32_t)s[2] << 16) | ((uint32_t)s[3] << 24);
+}
+
+static uint64_t get_u64(const uint8_t* s) {
+    return (uint64_t)get_u32(s) | ((uint64_t)get_u32(s + 4) << 32);
+}
+
+/*!> 0.1 unit, clamped to int16 */
+static uint16_t deci16(float v) {
+    long t = lroundf(v * 10);
+    if (t > INT16_MAX)
+        t = INT16_MAX;
+    else if (t < INT16_MIN)
+        t = INT16_MIN;
+    return (uint16_t)(int16_t)t;
+}
+
+static uint8_t* put_rec_hdr(uint8_t* d, uint8_t type, uint16_t len) {
+    *d++ = type;
+    return put_u16(d, len);
+}
+
+int wire_bin_rec_size(const uint8_t* buf) {
+    return WIRE_BIN_REC_HDR + get_u16(buf + 1);
+}
+
+int wire_bin_rxpk_write(uint8_t* buf, const struct lgw_pkt_rx_s* p, const struct timespec* utc) {
+    uint8_t* d = buf + WIRE_BIN_REC_HDR;
+    uint32_t datr, bw = 0, codr = 0;
+    int8_t stat;
+    uint8_t modu;
+
+    switch (p->status) {
+        case STAT_CRC_OK:   stat = 1;  break;
+        case STAT_CRC_BAD:  stat = -1; break;
+        case STAT_NO_CRC:   stat = 0;  break;
+        default:            return -1;
+    }
+
+    if (p->modulation == MOD_LORA) {
+        modu = WIRE_BIN_MOD_LORA;
+        if (to_wire(sf_map, MAP_NB(sf_map), p->datarate, &datr) ||
+            to_wire(bw_map, MAP_NB(bw_map), p->bandwidth, &bw) ||
+            to_wire(cr_map, MAP_NB(cr_map), p->coderate, &codr))
+            return -1;
+    } else if (p->modulation == MOD_FSK) {
+        modu = WIRE_BIN_MOD_FSK;
+        datr = p->datarate;
+    } else {
+        return -1;
+    }
+
+    d = put_u32(d, p->count_us);
+    d = put_u64(d, utc != NULL ? (uint64_t)utc->tv_sec * 1000000 + utc->tv_nsec / 1000 : 0);
+    d = put_u32(d, p->freq_hz);
+    d = put_u32(d, datr);
+    d = put_u32(d, (uint32_t)p->freq_offset);
+    d = put_u16(d, modu == WIRE_BIN_MOD_LORA ? deci16(p->rssis) : 0);
+    d = put_u16(d, deci16(p->rssic));
+    d = put_u16(d, modu == WIRE_BIN_MOD_LORA ? deci16(p->snr) : 0);
+    d = put_u16(d, (uint16_t)bw);
+    *d++ = p->if_chain;
+    *d++ = p->rf_chain;
+#ifdef SX1302MOD
+    *d++ = p->modem_id;
+#else
+    *d++ = 0;
+#endif
+    *d++ = (uint8_t)stat;
+    *d++ = modu;
+    *d++ = (uint8_t)codr;
+    *d++ = (uint8_t)p->size;
+    memcpy(d, p->payload, p->size);
+    d += p->size;
+
+    put_rec_hdr(buf, WIRE_BIN_RXPK, (uint16_t)(d - buf - WIRE_BIN_REC_HDR));
+    return (int)(d - buf);
+}
+
+int wire_bin_stat_write(uint8_t* buf, const wire_bin_stat_s* st) {
+    uint8_t* d = put_rec_hdr(buf, WIRE_BIN_STAT, WIRE_BIN_STAT_SIZE);
+
+    d = put_u64(d, (uint64_t)st->time);
+    *d++ = st->coord_ok ? WIRE_BIN_STAT_GPS : 0;
+    d = put_u32(d, st->coord_ok ? (uint32_t)(int32_t)lround(st->lat * 1e5) : 0);
+    d = put_u32(d, st->coord_ok ? (uint32_t)(int32_t)lround(st->lon * 1e5) : 0);
+    d = put_u16(d, st->coord_ok ? (uint16_t)st->alt : 0);
+    d = put_u32(d, st->rxnb);
+    d = put_u32(d, st->rxok);
+    d = put_u32(d, st->rxfw);
+    d = put_u16(d, (uint16_t)lroundf(st->ackr * 10));
+    d = put_u32(d, st->dwnb);
+    d = put_u32(d, st->txnb);
+
+    return (int)(d - buf);
+}
+
+int wire_bin_txack_write(uint8_t* buf, uint8_t error, int32_t value) {
+    uint8_t* d = put_rec_hdr(buf, WIRE_BIN_TXACK, WIRE_BIN_TXACK_SIZE);
+
+    *d++ = error;
+    d = put_u32(d, (uint32_t)value);
+
+    return (int)(d - buf);
+}
+
+int wire_bin_txpk_read(const uint8_t* buf, int len, struct lgw_pkt_tx_s* txpkt, txpk_when_s* when) {
+    const uint8_t* s = buf + WIRE_BIN_REC_HDR;
+    uint8_t flags;
+    uint16_t prea;
+    uint32_t v;
+    int rec_len;
+
+    if (len < WIRE_BIN_REC_HDR + WIRE_BIN_TXPK_HDR || buf[0] != WIRE_BIN_TXPK)
+        return -1;
+    rec_len = get_u16(buf + 1);
+    if (rec_len < WIRE_BIN_TXPK_HDR || rec_len > len - WIRE_BIN_REC_HDR)
+        return -1;
+    if (WIRE_BIN_TXPK_HDR + s[29] > rec_len)
+        return -1;
+
+    flags = s[0];
+    when->imme = (flags & WIRE_BIN_TX_IMME) != 0;
+    when->tmms = !when->imme && (flags & WIRE_BIN_TX_TMMS) != 0;
+    when->gps_ms = get_u64(s + 1);
+    txpkt->count_us = (uint32_t)when->gps_ms;
+
+    txpkt->no_crc = (flags & WIRE_BIN_TX_NCRC) != 0;
+    txpkt->freq_hz = get_u32(s + 9);
+    txpkt->rf_chain = s[25];
+    txpkt->rf_power = (int8_t)s[26];
+    prea = get_u16(s + 23);
+
+    switch (s[27]) {
+        case WIRE_BIN_MOD_LORA:
+            txpkt->modulation = MOD_LORA;
+            if (to_hal(sf_map, MAP_NB(sf_map), get_u32(s + 13), &v))
+                return -1;
+            txpkt->datarate = v;
+            if (to_hal(bw_map, MAP_NB(bw_map), get_u16(s + 21), &v))
+                return -1;
+            txpkt->bandwidth = (uint8_t)v;
+            if (s[28] == 0 || to_hal(cr_map, MAP_NB(cr_map), s[28], &v))
+                return -1;
+            txpkt->coderate = (uint8_t)v;
+            txpkt->invert_pol = (flags & WIRE_BIN_TX_IPOL) != 0;
+            if (prea == 0)
+                txpkt->preamble = STD_LORA_PREAMB;
+            else
+                txpkt->preamble = prea < MIN_LORA_PREAMB ? MIN_LORA_PREAMB : prea;
+            break;
+        case WIRE_BIN_MOD_FSK:
+            txpkt->modulation = MOD_FSK;
+            txpkt->datarate = get_u32(s + 13);
+            txpkt->f_dev = (uint8_t)(get_u32(s + 17) / 1000);   /*!> wire in Hz, txpkt.f_dev in kHz */
+            if (prea == 0)
+                txpkt->preamble = STD_FSK_PREAMB;
+            else
+                txpkt->preamble = prea < MIN_FSK_PREAMB ? MIN_FSK_PREAMB : prea;
+            break;
+        default:
+            return -1;
+    }
+
+    txpkt->size = s[29];
+    memcpy(txpkt->payload, s + WIRE_BIN_TXPK_HDR, txpkt->size);
+
+    return 0;
+}
@@ -100,6 +100,19 @@ return_type aes_cbc_encrypt( const unsigned char *in,
                          int n_block,
                          unsigned char iv[N_BLOCK],
                          const aes_context ctx[1] );
+
+/*  Encrypt n_block independent blocks (ECB), the hardware backends keep
+    several blocks in flight, in and out may be the same buffer
+*/
+return_type aes_encrypt_blocks( const unsigned char *in,
+                         unsigned char *out,
+                         int n_block,
+                         const aes_context ctx[1] );
+
+/*  Name of the block function picked for this cpu: "aes-ni", "armv8-ce",
+    "t-tables" or "bytes" (AES_NO_HW / AES_NO_TTABLES turn backends off)
+*/
+const char *aes_encrypt_backend( void );
 #endif
 
 #if defined( AES_DEC_PREKEYED )
@@ -0,0 +1,73 @@
+/*!>
+ *  ____  ____      _    ____ ___ _   _  ___
+ *  |  _ \|  _ \    / \  / ___|_ _| \ | |/ _ \
+ *  | | | | |_) |  / _ \| |  _ | ||  \| | | | |
+ *  | |_| |  _ <  / ___ \ |_| || || |\  | |_| |
+ *  |____/|_| \_\/_/   \_\____|___|_| \_|\___/
+ *
+ * Dragino_gw_fwd -- An opensource lora gateway forward
+ *
+ * See http://www.dragino.com for more information about
+ * the lora gateway project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ *
+ * Maintainer: skerlan
+ *
+ */
+
+/*!>!
+ * \file
+ * \brief concentrator access scheduler: callers name the operation they
+ *        need the concentrator for, TX lane operations get it before
+ *        waiting RX fetches, scans and counter reads
+ */
+
+#ifndef _CONCENT_H
+#define _CONCENT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+    CONCENT_TX,                                   /*!> TX status check, upload and arm, TX lane */
+    CONCENT_FETCH,                                /*!> lgw_receive */
+    CONCENT_COUNTER,                              /*!> counter reads, time base and GPS sync */
+    CONCENT_SCAN,                                 /*!> spectral scan */
+    CONCENT_OTHER,                                /*!> status report... */
+    CONCENT_OP_NB
+} concent_op_e;
+
+/*!> waits for the concentrator of one operation */
+typedef struct {
+    uint32_t nb;
+    uint32_t wait_max_us;
+    uint64_t wait_sum_us;
+} concent_wait_s;
+
+/*!>
+ * \brief get the concentrator for op, a TX lane request passes all other waiters
+ * \note GW.hal.mx_concent is held on return, the calling thread can't be
+ *       cancelled until concent_unlock
+ */
+void concent_lock(concent_op_e op);
+
+/*!>
+ * \brief release the concentrator
+ */
+void concent_unlock(void);
+
+/*!>
+ * \brief copy the wait stats of each operation, and reset them if asked
+ */
+void concent_stat(concent_wait_s st[CONCENT_OP_NB], bool reset);
+
+/*!>
+ * \brief short name of op, for reports
+ */
+const char* concent_op_name(concent_op_e op);
+
+#endif  /* _CONCENT_H */
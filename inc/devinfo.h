@@ -0,0 +1,56 @@
+/*!>
+ *  ____  ____      _    ____ ___ _   _  ___
+ *  |  _ \|  _ \    / \  / ___|_ _| \ | |/ _ \
+ *  | | | | |_) |  / _ \| |  _ | ||  \| | | | |
+ *  | |_| |  _ <  / ___ \ |_| || || |\  | |_| |
+ *  |____/|_| \_\/_/   \_\____|___|_| \_|\___/
+ *
+ * Dragino_gw_fwd -- An opensource lora gateway forward
+ *
+ * See http://www.dragino.com for more information about
+ * the lora gateway project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ *
+ * Maintainer: skerlan
+ *
+ */
+
+
+/*!>!
+ * \file
+ * \brief ABP device keys indexed by DevAddr, read from the devskey
+ *        database into memory so decode does not query sqlite per packet
+ */
+
+#ifndef _DEVINFO_H
+#define _DEVINFO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "mac-header-decode.h"
+
+/*!>
+ * \brief keys of a device, lock free, the index can be reloaded meanwhile.
+ *        For decode_mac_pkt_up, with LoRaMacSKeysGet for the expanded keys
+ * \retval true if the device is known, info is filled
+ */
+bool devinfo_get(uint32_t devaddr, devinfo_s* info);
+
+/*!>
+ * \brief read the abpdevs table and reload it when the devskey database
+ *        changes, see devskey_poll
+ * \retval number of devices, -1 on error
+ */
+int devinfo_init(void);
+
+/*!>
+ * \brief release the index, once nothing looks it up anymore
+ */
+void devinfo_free(void);
+
+#endif  /* _DEVINFO_H */
@@ -0,0 +1,98 @@
+/*!>
+ *  ____  ____      _    ____ ___ _   _  ___
+ *  |  _ \|  _ \    / \  / ___|_ _| \ | |/ _ \
+ *  | | | | |_) |  / _ \| |  _ | ||  \| | | | |
+ *  | |_| |  _ <  / ___ \ |_| || || |\  | |_| |
+ *  |____/|_| \_\/_/   \_\____|___|_| \_|\___/
+ *
+ * Dragino_gw_fwd -- An opensource lora gateway forward
+ *
+ * See http://www.dragino.com for more information about
+ * the lora gateway project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ *
+ * Maintainer: skerlan
+ *
+ */
+
+
+/*!>!
+ * \file
+ * \brief devskey database watcher: the tables read from /etc/lora/devskey
+ *        (ABP keys, uplink filters) are rebuilt when the file changes and
+ *        published to lock free readers
+ */
+
+#ifndef _DEVSKEY_H
+#define _DEVSKEY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sqlite3.h>
+
+#define DEVSKEY_DB_PATH             "/etc/lora/devskey"
+#define DEVSKEY_CHECK_MS            5000          /*!> least time between two checks of the file */
+#define DEVSKEY_LOADER_NB           4
+
+/*!> read a table from the opened database and publish it, -1 on error */
+typedef int (*devskey_load_cb)(sqlite3* db);
+
+/*!>
+ * \brief table published to readers that take no lock
+ *
+ * A replaced table is released at the following swap. Swaps of a table
+ * are made by devskey_poll, DEVSKEY_CHECK_MS apart at least, or once by
+ * devskey_watch before any table was published. Readers must hold a
+ * table for a single lookup only, far shorter than DEVSKEY_CHECK_MS, and
+ * never keep a pointer into it.
+ */
+typedef struct {
+    void* cur;                                    /*!> read by lookups */
+    void* old;                                    /*!> replaced, released at next swap */
+    void (*release)(void* tab);
+} devskey_tab_s;
+
+#define DEVSKEY_TAB_INIT(rel)       { NULL, NULL, (rel) }
+
+static inline const void* devskey_tab_read(devskey_tab_s* t) {
+    return __atomic_load_n(&t->cur, __ATOMIC_ACQUIRE);
+}
+
+/*!>
+ * \brief publish a new table, the one before the current one is released
+ */
+void devskey_tab_swap(devskey_tab_s* t, void* tab);
+
+/*!>
+ * \brief release both tables, once no reader is left
+ */
+void devskey_tab_free(devskey_tab_s* t);
+
+/*!>
+ * \brief run a loader now and again each time the database file changes
+ * \retval result of the first load
+ */
+int devskey_watch(devskey_load_cb cb);
+
+/*!>
+ * \brief main loop, checks the database file every DEVSKEY_CHECK_MS and
+ *        runs all loaders when it changed
+ */
+void devskey_poll(void);
+
+/*!>
+ * \retval value of an hex digit, -1 if c is not one
+ */
+int hex_digit(char c);
+
+/*!>
+ * \brief hex string of exactly 2 * len digits to bytes
+ * \retval 0 on success, -1 on a bad digit or length
+ */
+int hex_to_bin(const char* hex, uint8_t* bin, int len);
+
+#endif  /* _DEVSKEY_H */
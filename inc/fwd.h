@@ -38,7 +38,6 @@
 #include "db.h"
 
 #define PROTOCOL_VERSION                    2	        /* v1.3 */
-#define PROTOCOL_JSON_RXPK_FRAME_FORMAT     1
 
 #define MIN_LORA_PREAMB                     6		    /* minimum Lora preamble length for this application */
 #define STD_LORA_PREAMB                     8
@@ -67,11 +66,11 @@
 
 #define DEFAULT_FETCH_SLEEP_MS              10	        /* number of ms waited when a fetch return no packets */
 
-#define DEFAULT_BEACON_POLL_MS              50	        /* time in ms between polling of beacon TX status */
+#define JIT_PEEK_WINDOW_US                  40000	    /* TX_JIT_DELAY of jitqueue, jit_peek hands a packet out this long before count_us */
 
-#define DEFAULT_RXPKTS_LIST_SIZE            32           
+#define JIT_IDLE_WAIT_MS                    1000	    /* longest sleep of jit thread when no packet is due */
 
-#define  MAX_RXPKTS_LIST_SIZE               128         /* MAX sizeof RXPKTS */
+#define DEFAULT_BEACON_POLL_MS              50	        /* time in ms between polling of beacon TX status */
 
 #define TX_BUFF_SIZE                        ((540 * NB_PKT_MAX) + 30 + STATUS_SIZE)
 
@@ -84,8 +83,6 @@
 
 #define ACK_BUFF_SIZE                       64
 
-#define NB_LBT_QUEUE                        8
-
 #define UNIX_GPS_EPOCH_OFFSET               315964800 
 
 #define XERR_INIT_AVG       128	/* number of measurements the XTAL correction is averaged on as initial value */
@@ -102,16 +99,20 @@
 #define MAX_PTHREADS_COUNT        48
 #endif
 
+#define DEFAULT_PUSH_MTU          1400        /*!> PUSH_DATA datagram size limit of each service */
+#define MIN_PUSH_MTU              680         /*!> room for one rxpk object at least */
+#define PUSH_BATCH_NB             4           /*!> PUSH_DATA datagrams flushed by one sendmmsg */
+#define RECV_BATCH_NB             8           /*!> datagrams drained by one recvmmsg */
+
 #define IF_DELAY            31  /*!> DELAY channel */
 
-/*!> relay payload defined 
- * Bytes  | Function
- * :------:|---------------------------------------------------------------------
- * 0      | payload direction 
- * 1-end  | payload
- */
-#define RELAY_UP  0x00          /*!> relay up payload send from as_relay gateway */
-#define RELAY_DN  0x01          /*!> relay down payload send from has_relay gateway */
+/*!> statistics counters are bumped without mx_report, the report thread
+ * takes each counter and clears it in one atomic step */
+#define STAT_INC(c)         __atomic_add_fetch(&(c), 1, __ATOMIC_RELAXED)
+#define STAT_ADD(c, v)      __atomic_add_fetch(&(c), (v), __ATOMIC_RELAXED)
+#define STAT_GET(c)         __atomic_load_n(&(c), __ATOMIC_RELAXED)
+#define STAT_TAKE(c)        __atomic_exchange_n(&(c), 0, __ATOMIC_RELAXED)
+
                                                                           
 /*!
  * \brief Register a function to be executed before Asterisk exits.
@@ -153,6 +154,12 @@ void lgw_unregister_atexit(void (*func)(void));
  */
 int send_tx_ack(serv_s* serv, uint8_t token_h, uint8_t token_l, enum jit_error_e error, int32_t error_value);
 
+/*!
+ * \brief wake up jit thread, call after a successful jit_enqueue with the
+ *        rf_chain and count_us of the packet as enqueued
+ */
+void jit_notify(uint8_t rf_chain, uint32_t count_us);
+
 /*!
  * \brief 
  */
@@ -169,8 +176,20 @@ double difftimespec(struct timespec end, struct timespec beginning);
 int get_tx_gain_lut_index(uint8_t rf_chain, int8_t rf_power, uint8_t * lut_index);
 
 /*!
- * \brief 
+ * \brief reference the next batch of the rxpkts ring not yet read by serv_ct->serv
+ * \retval number of packets in serv_ct->rxpkt, 0 if the service is up to date
+ * \note the batch is hold until put_rxpkt, don't keep it longer than serialization
  */
 int get_rxpkt(serv_ct_s* serv_ct);
 
+/*!
+ * \brief release the batch referenced by get_rxpkt
+ */
+void put_rxpkt(serv_ct_s* serv_ct);
+
+/*!
+ * \brief start reading the rxpkts ring from the newest batch
+ */
+void rxpkt_cursor_init(serv_s* serv);
+
 #endif							/* _DR_PKT_FWD_H_ */
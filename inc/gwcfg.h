@@ -52,6 +52,16 @@
 #define NB_PKT_MAX                  32            /*!> max number of packets per fetch/send cycle */
 #endif
 
+#define RXPKTS_RING_SIZE            32            /*!> batches kept for services, must be power of 2 */
+#define RXPKTS_BIND_WAIT_MS         5             /*!> thread_up waits for a held slot, then skips it */
+
+#define FETCH_HIST_NB               6             /*!> buckets of fetch latency: <1,<2,<5,<10,<20,>=20 ms */
+#define JIT_HIST_NB                 6             /*!> buckets of jit dispatch lateness, same bounds */
+
+#define PUSH_QUEUE_SIZE             64            /*!> rxpk objects a service can hold for its sender, oldest dropped */
+#define PUSH_INFLIGHT_NB            8             /*!> PUSH_DATA datagrams waiting for their PUSH_ACK */
+#define DOWN_DECODE_NB              8             /*!> downlinks a service keeps for its up thread to decode, oldest dropped */
+
 typedef enum {
     semtech,
     ttn,
@@ -93,13 +103,26 @@ typedef enum {     /*!> thread type for control thread head */
 } thread_type;
 
 typedef struct _rxpkts {   /*!> rx packages receive from radio or socke */
+    uint32_t seq;          //写入序号，正在写入时为 RXPKTS_SEQ_BUSY
+    int bind;              //正在读取这批数据的服务数，为0时才可以覆盖
     uint32_t entry_us;     //插入添加时间
-    uint8_t stamps;        //这个指示当前有什么服务对这个包打上了印记
     uint8_t nb_pkt;
     struct lgw_pkt_rx_s rxpkt[NB_PKT_MAX];
-    LGW_LIST_ENTRY(_rxpkts) list;
 } rxpkts_s;
 
+#define RXPKTS_SEQ_BUSY             0xFFFFFFFF
+
+/*!> single producer (thread_up), every service reads with its own cursor.
+ *   a slow service lose the oldest batches. A slot a service still holds
+ *   blocks thread_up RXPKTS_BIND_WAIT_MS at most, then it is skipped.
+ *   batches are read in place by services and never modified after publish.
+ */
+typedef struct {
+    uint32_t head;                          /*!> sequence of the next batch to write */
+    uint32_t nb_skip;                       /*!> slots skipped because still held */
+    rxpkts_s slot[RXPKTS_RING_SIZE];
+} rxpkts_ring_s;
+
 typedef enum {
     NOFILTER,
     INCLUDE,
@@ -130,10 +153,9 @@ typedef struct {
     int  pull_interval;                     // send a PULL_DATA request every X seconds 
     struct timeval push_timeout_half;       /*!> time-out value (in ms) for upstream datagrams */
     struct timeval pull_timeout;
+    uint8_t wire_format;                    /*!> wire_format_e, payload encoding of datagrams */
 } serv_net_s;
 
-LGW_LIST_HEAD(rxpkts_list, _rxpkts);        //定义一个数据链头，用来保存接收到的数据包         
-
 /*!>!
  * \brief server是一个描述什么样服务的数据结构
  * 
@@ -170,12 +192,38 @@ typedef struct _server {
     struct {
         pthread_t t_down;			// downstream thread
         pthread_t t_up;				// upstream thread
+        pthread_t t_send;           // upstream datagram sender
         sem_t sema;				    // semaphore for sending data
         bool stop_sig;
     } thread;
 
+    struct {                                    /*!> rxpk queue between upstream thread and sender */
+        pthread_mutex_t mx_queue;
+        pthread_cond_t cd_queue;                /*!> signaled when rxpk objects or a report are pending */
+        struct _push_item* items;               /*!> serialized rxpk objects, ring of PUSH_QUEUE_SIZE */
+        uint16_t head;
+        uint16_t nb_item;
+        uint16_t mtu;                           /*!> max size of a PUSH_DATA datagram */
+        uint32_t nb_drop;                       /*!> rxpk objects dropped because the queue was full */
+        bool reconnect;                         /*!> sockets closed by keepalive, reopened by the sender */
+        struct {
+            bool wait;                          /*!> PUSH_ACK not yet received */
+            uint8_t token_h;
+            uint8_t token_l;
+            struct timespec send_time;
+        } inflight[PUSH_INFLIGHT_NB];           /*!> datagrams sent, matched by token */
+        uint8_t inflight_idx;
+    } push;
+
+    struct {
+        uint32_t cursor;            /*!> sequence of the next batch to read from rxpkts ring */
+        uint32_t nb_lost;           /*!> batches overwritten before this service read them */
+    } rx;
+
     serv_net_s* net;
 
+    struct _semtech_down* down;     /*!> semtech downstream state, used by reactor callbacks */
+
     report_s* report;
 
     LGW_LIST_ENTRY(_server) list;
@@ -184,9 +232,10 @@ typedef struct _server {
 
 LGW_LIST_HEAD_NOLOCK(serv_list, _server);  // pkts list head of rxpkts for server 
 
-typedef struct {
+typedef struct _serv_ct {
     int nb_pkt;
-    struct lgw_pkt_rx_s rxpkt[NB_PKT_MAX];
+    const struct lgw_pkt_rx_s* rxpkt;  /*!> packets of batch, read only */
+    rxpkts_s* batch;                   /*!> batch referenced in rxpkts ring, release by put_rxpkt */
     serv_s* serv;
 } serv_ct_s;
 
@@ -203,12 +252,6 @@ typedef struct _thread_info {
 
 LGW_LIST_HEAD(pthread_list, _thread_info);     //定义一个数据链头，用来控制线程数量         
 
-struct lbt_chan_stat {
-    uint32_t freq_hz;
-    uint32_t count_us;                         // 时间
-    bool chan_is_free;
-};
-
 typedef struct {
     struct {
         char gateway_id[17];                /*!> string form of gateway mac address */
@@ -259,6 +302,7 @@ typedef struct {
         char        tty_path[64];            /*!> tty port for relay device (sx126x) */
         int         tty_fd;                  /*!> uart open fd  for relay device */
         uint32_t    tty_baude;               /*!> bauderate */
+        uint8_t     frame;                   /*!> relay_frame_e, downlink framing on the uart */
         uint32_t    freq_hz;                 /*!> relay channel equal to if_chain_8 (loar service channel) */
         bool        invert_pol;
         uint8_t     bw;      
@@ -283,6 +327,27 @@ typedef struct {
         pthread_mutex_t mx_meas_gps;    /*!> control access to the GPS statistics */
     } gps;
 
+    /*!> uplink fetch scheduler of thread_up */
+    struct {
+        bool     adaptive;                  /*!> re-poll at once after packets, backoff when idle; false = fixed sleep */
+        uint16_t min_sleep_ms;              /*!> first idle wait of backoff */
+        uint16_t max_sleep_ms;              /*!> idle wait upper bound, fixed sleep if not adaptive */
+        char     irq_gpio[64];              /*!> sysfs gpio value file (edge set), wake up fetch on RX irq */
+        uint32_t lat_hist[FETCH_HIST_NB];   /*!> batches by max wait since previous fetch */
+        pthread_mutex_t mx_hist;
+    } fetch;
+
+    /*!> deadline scheduler of thread_jit */
+    struct {
+        pthread_mutex_t mx_wake;
+        pthread_cond_t  cd_wake;            /*!> on CLOCK_MONOTONIC, signaled by jit_notify */
+        bool     kick;                      /*!> packet enqueued since the last queue scan */
+        uint32_t due[LGW_RF_CHAIN_NB][JIT_QUEUE_MAX]; /*!> count_us of the packets given to jit_notify */
+        int      nb_due[LGW_RF_CHAIN_NB];
+        uint32_t late_hist[JIT_HIST_NB];    /*!> dequeued packets by delay after their dispatch deadline */
+        pthread_mutex_t mx_hist;
+    } jit;
+
     struct {
         bool   lbt_tty_enabled;         /*!> enable LBT */
         char   lbt_tty_path[64];        /*!> path of the TTY port LBT is connected on */
@@ -291,7 +356,6 @@ typedef struct {
         uint32_t lbt_tty_baude;         /*!> bauderate */
         uint32_t lbt_freq_hz;               
         uint16_t lbt_scan_time_ms;      /*!> scan time for LBT */
-        struct lbt_chan_stat lbt_stat[16];
     } lbt;
 
     struct {
@@ -332,7 +396,7 @@ typedef struct {
     spectral_scan_t spectral_scan_params; //Spectral Scan
 #endif
 
-    struct rxpkts_list rxpkts_list;
+    rxpkts_ring_s rxpkts;
 
     struct serv_list serv_list;
 } gw_s;
@@ -362,7 +426,9 @@ typedef struct {
                               .cfg.time_diff = "8",                                  \
                               .relay.as_relay = false,                               \
                               .relay.has_relay = false,                              \
+                              .relay.tty_fd = -1,                                    \
                               .relay.tty_baude = 9600,                               \
+                              .relay.frame = 0,                                      \
                               .relay.invert_pol = true,                              \
                               .relay.freq_hz = 868300000,                            \
                               .relay.bw = 0,                                         \
@@ -371,6 +437,14 @@ typedef struct {
                               .gps.time_ref = false,                                 \
                               .gps.mx_timeref  = PTHREAD_MUTEX_INITIALIZER,          \
                               .gps.mx_meas_gps = PTHREAD_MUTEX_INITIALIZER,          \
+                              .fetch.adaptive = true,                                \
+                              .fetch.min_sleep_ms = 1,                               \
+                              .fetch.max_sleep_ms = DEFAULT_FETCH_SLEEP_MS,          \
+                              .fetch.irq_gpio[0] = 0,                                \
+                              .fetch.mx_hist = PTHREAD_MUTEX_INITIALIZER,            \
+                              .jit.mx_wake = PTHREAD_MUTEX_INITIALIZER,              \
+                              .jit.kick = false,                                     \
+                              .jit.mx_hist = PTHREAD_MUTEX_INITIALIZER,              \
                               .lbt.lbt_tty_enabled = false,                          \
                               .lbt.lbt_tty_path[0] = 0,                              \
                               .lbt.lbt_tty_fd = -1,                                  \
@@ -394,7 +468,6 @@ typedef struct {
                               .log.nb_pkt_received_fsk   = 0,                        \
                               .log.mx_report = PTHREAD_MUTEX_INITIALIZER,            \
                               .serv_list = LGW_LIST_HEAD_NOLOCK_INIT_VALUE,          \
-                              .rxpkts_list = LGW_LIST_HEAD_INIT_VALUE,               \
                           }
 
 #define DECLARE_GW extern gw_s GW
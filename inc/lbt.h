@@ -0,0 +1,96 @@
+/*!>
+ *  ____  ____      _    ____ ___ _   _  ___
+ *  |  _ \|  _ \    / \  / ___|_ _| \ | |/ _ \
+ *  | | | | |_) |  / _ \| |  _ | ||  \| | | | |
+ *  | |_| |  _ <  / ___ \ |_| || || |\  | |_| |
+ *  |____/|_| \_\/_/   \_\____|___|_| \_|\___/
+ *
+ * Dragino_gw_fwd -- An opensource lora gateway forward
+ *
+ * See http://www.dragino.com for more information about
+ * the lora gateway project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ *
+ * Maintainer: skerlan
+ *
+ */
+
+
+/*!>!
+ * \file
+ * \brief LBT scheduler for the external LBT module on a tty: each queued
+ *        downlink gets a channel assessment started ahead of its JIT
+ *        dispatch, the verdict is kept for that JIT entry
+ */
+
+#ifndef _LBT_H
+#define _LBT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define LBT_SLOT_NB                 16            /*!> downlinks waiting for their verdict */
+#define LBT_FREQ_NB                 16            /*!> frequencies with their own stats */
+#define LBT_LEAD_GUARD_US           5000          /*!> verdict ready this long before jit dispatch */
+#define LBT_LAT_INIT_US             50000         /*!> scan latency assumed before the first scan */
+#define LBT_LAT_FILT                8             /*!> low-pass coefficient of scan latency estimate */
+#define LBT_VERDICT_WAIT_MS         20            /*!> jit waits this long for a scan in progress */
+#define LBT_IDLE_WAIT_MS            1000          /*!> longest sleep of the scheduler */
+
+typedef enum {
+    LBT_FREE,
+    LBT_BUSY,
+    LBT_NO_VERDICT                                /*!> not scheduled, or not scanned in time */
+} lbt_verdict_e;
+
+/*!> assessments of one frequency */
+typedef struct {
+    uint32_t freq_hz;
+    uint32_t nb_scan;
+    uint32_t nb_busy;
+    uint32_t lat_max_us;                          /*!> command sent to answer read */
+    uint64_t lat_sum_us;
+} lbt_freq_stat_s;
+
+/*!> scheduler stats since the previous lbt_stat */
+typedef struct {
+    uint32_t nb_sched;                            /*!> downlinks scheduled */
+    uint32_t nb_full;                             /*!> refused, no free slot */
+    uint32_t nb_missed;                           /*!> dispatched without verdict */
+    int nb_freq;
+    lbt_freq_stat_s freq[LBT_FREQ_NB];
+} lbt_stat_s;
+
+/*!>
+ * \brief schedule the assessment of a downlink, after jit_enqueue since
+ *        the queue sets count_us of immediate packets
+ * \retval 0 on success, -1 if no slot is free
+ */
+int lbt_schedule(uint8_t rf_chain, uint32_t count_us, uint32_t freq_hz);
+
+/*!>
+ * \brief verdict of a dequeued downlink, the slot is released
+ * \note waits up to LBT_VERDICT_WAIT_MS when the scan is in progress
+ */
+lbt_verdict_e lbt_verdict(uint8_t rf_chain, uint32_t count_us, uint32_t freq_hz);
+
+/*!>
+ * \brief scheduler thread, scans the channels over the LBT tty until lbt_stop
+ */
+void thread_lbt_scan(void);
+
+/*!>
+ * \brief ask thread_lbt_scan to end
+ */
+void lbt_stop(void);
+
+/*!>
+ * \brief copy the scheduler stats, and reset them if asked
+ */
+void lbt_stat(lbt_stat_s* st, bool reset);
+
+#endif  /* _LBT_H */
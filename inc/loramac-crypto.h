@@ -6,9 +6,41 @@
  * \{
  */
 #include <stdint.h>
+#include <stdbool.h>
 #ifndef __LORAMAC_CRYPTO_H__
 #define __LORAMAC_CRYPTO_H__
 
+#include "aes.h"
+#include "cmac.h"
+
+/*!
+ * Session keys cache size of each thread, 2^LORAMAC_SKEYS_CACHE_BITS devices
+ */
+#define LORAMAC_SKEYS_CACHE_BITS                    6
+#define LORAMAC_SKEYS_CACHE_NB                      ( 1 << LORAMAC_SKEYS_CACHE_BITS )
+
+/*!
+ * Counter blocks ciphered in one call, 256 bytes of payload
+ */
+#define LORAMAC_CTR_BLOCKS                          16
+
+/*!
+ * Session keys of a device with their expanded schedules. Once set it is
+ * only read, any number of threads can use it at the same time.
+ */
+typedef struct sLoRaMacSKeys
+{
+    uint32_t DevAddr;
+    uint8_t NwkSKey[16];
+    uint8_t AppSKey[16];
+    /*!
+     * Keyed CMAC context, the running state is reset on each MIC
+     */
+    AES_CMAC_CTX NwkSKeyCmac;
+    aes_context AppSKeyAes;
+    struct sLoRaMacSKeys *Next;                     /* retired entries of a cache */
+} LoRaMacSKeys_t;
+
 /*!
  * Computes the LoRaMAC frame MIC field
  *
@@ -48,6 +80,102 @@ void LoRaMacPayloadEncrypt( const uint8_t *buffer, uint16_t size, const uint8_t
  */
 void LoRaMacPayloadDecrypt( const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *decBuffer );
 
+/*!
+ * Expands the session keys of a device
+ *
+ * \param [OUT] sKeys           - Session keys to set
+ * \param [IN]  devAddr         - Device address
+ * \param [IN]  nwkSKey         - Network session key
+ * \param [IN]  appSKey         - Application session key
+ */
+void LoRaMacSKeysSet( LoRaMacSKeys_t *sKeys, uint32_t devAddr, const uint8_t *nwkSKey, const uint8_t *appSKey );
+
+/*!
+ * Gets the expanded session keys of a device from the cache of the calling
+ * thread, they are expanded and cached on a miss or when the keys changed.
+ * No lock is taken. The entry stays valid until the thread calls
+ * LoRaMacSKeysRelease, even if a later lookup evicts it.
+ *
+ * \param [IN]  devAddr         - Device address
+ * \param [IN]  nwkSKey         - Network session key
+ * \param [IN]  appSKey         - Application session key
+ * \retval cached session keys, NULL if out of memory
+ */
+const LoRaMacSKeys_t *LoRaMacSKeysGet( uint32_t devAddr, const uint8_t *nwkSKey, const uint8_t *appSKey );
+
+/*!
+ * Frees the entries the calling thread evicted from its cache, once it
+ * holds no pointer returned by LoRaMacSKeysGet anymore
+ */
+void LoRaMacSKeysRelease( void );
+
+/*!
+ * Drops every cached session key, after the keys table is reloaded. Each
+ * thread empties its cache at its next lookup.
+ */
+void LoRaMacSKeysFlush( void );
+
+/*!
+ * Computes the LoRaMAC frame MIC field with a keyed CMAC context
+ *
+ * \param [IN]  keyed           - CMAC context after AES_CMAC_SetKey, not modified
+ * \param [IN]  buffer          - Data buffer
+ * \param [IN]  size            - Data buffer size
+ * \param [IN]  address         - Frame address
+ * \param [IN]  dir             - Frame direction [0: uplink, 1: downlink]
+ * \param [IN]  sequenceCounter - Frame sequence counter
+ * \param [OUT] mic             - Computed MIC field
+ */
+void LoRaMacComputeMicCtx( const AES_CMAC_CTX *keyed, const uint8_t *buffer, uint16_t size, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint32_t *mic );
+
+/*!
+ * Computes the LoRaMAC payload encryption with an expanded key
+ *
+ * \param [IN]  aes             - Key schedule, not modified
+ * \param [IN]  buffer          - Data buffer
+ * \param [IN]  size            - Data buffer size
+ * \param [IN]  address         - Frame address
+ * \param [IN]  dir             - Frame direction [0: uplink, 1: downlink]
+ * \param [IN]  sequenceCounter - Frame sequence counter
+ * \param [OUT] encBuffer       - Encrypted buffer
+ */
+void LoRaMacPayloadEncryptCtx( const aes_context *aes, const uint8_t *buffer, uint16_t size, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *encBuffer );
+
+/*!
+ * Computes the LoRaMAC payload decryption with an expanded key
+ *
+ * \param [IN]  aes             - Key schedule, not modified
+ * \param [IN]  buffer          - Data buffer
+ * \param [IN]  size            - Data buffer size
+ * \param [IN]  address         - Frame address
+ * \param [IN]  dir             - Frame direction [0: uplink, 1: downlink]
+ * \param [IN]  sequenceCounter - Frame sequence counter
+ * \param [OUT] decBuffer       - Decrypted buffer
+ */
+void LoRaMacPayloadDecryptCtx( const aes_context *aes, const uint8_t *buffer, uint16_t size, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *decBuffer );
+
+/*!
+ * One frame of a batch decryption
+ */
+typedef struct sLoRaMacDecryptJob
+{
+    const aes_context *Aes;                         /* AppSKeyAes, or NwkSKey schedule for FPort 0 */
+    const uint8_t *Buffer;
+    uint16_t Size;
+    uint32_t Address;
+    uint8_t Dir;
+    uint32_t SequenceCounter;
+    uint8_t *DecBuffer;
+} LoRaMacDecryptJob_t;
+
+/*!
+ * Decrypts the payloads of a batch of frames, each with its own key
+ *
+ * \param [IN]  jobs            - Frames to decrypt
+ * \param [IN]  nb              - Number of frames
+ */
+void LoRaMacPayloadDecryptBatch( const LoRaMacDecryptJob_t *jobs, int nb );
+
 /*!
  * Computes the LoRaMAC Join Request frame MIC field
  *
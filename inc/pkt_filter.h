@@ -0,0 +1,59 @@
+/*!>
+ *  ____  ____      _    ____ ___ _   _  ___
+ *  |  _ \|  _ \    / \  / ___|_ _| \ | |/ _ \
+ *  | | | | |_) |  / _ \| |  _ | ||  \| | | | |
+ *  | |_| |  _ <  / ___ \ |_| || || |\  | |_| |
+ *  |____/|_| \_\/_/   \_\____|___|_| \_|\___/
+ *
+ * Dragino_gw_fwd -- An opensource lora gateway forward
+ *
+ * See http://www.dragino.com for more information about
+ * the lora gateway project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ *
+ * Maintainer: skerlan
+ *
+ */
+
+
+/*!>!
+ * \file
+ * \brief uplink filters of the services, compiled from the filter table
+ *        of the devskey database into sets checked without lock
+ */
+
+#ifndef _PKT_FILTER_H
+#define _PKT_FILTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "gwcfg.h"
+#include "mac-header-decode.h"
+
+/*!>
+ * \brief apply the filters of a service to a parsed uplink, data frames are
+ *        checked by fport, devaddr and nwkid, join requests by deveui and
+ *        joineui. A filter set to INCLUDE drops the packets it lists, set
+ *        to EXCLUDE it forwards only those
+ * \retval true if the packet must not be forwarded
+ */
+bool pkt_filter_drop(const serv_s* serv, const LoRaMacMessageData_t* macmsg);
+
+/*!>
+ * \brief compile the filter table and recompile it when the devskey
+ *        database changes, see devskey_poll
+ * \retval number of rules, -1 on error
+ */
+int pkt_filter_init(void);
+
+/*!>
+ * \brief release the filters, once no service checks packets anymore
+ */
+void pkt_filter_free(void);
+
+#endif  /* _PKT_FILTER_H */
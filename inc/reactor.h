@@ -0,0 +1,78 @@
+/*!>
+ *  ____  ____      _    ____ ___ _   _  ___
+ *  |  _ \|  _ \    / \  / ___|_ _| \ | |/ _ \
+ *  | | | | |_) |  / _ \| |  _ | ||  \| | | | |
+ *  | |_| |  _ <  / ___ \ |_| || || |\  | |_| |
+ *  |____/|_| \_\/_/   \_\____|___|_| \_|\___/
+ *
+ * Dragino_gw_fwd -- An opensource lora gateway forward
+ *
+ * See http://www.dragino.com for more information about
+ * the lora gateway project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ *
+ * Maintainer: skerlan
+ *
+ */
+
+/*!>!
+ * \file
+ * \brief network event loop of the forwarder: one epoll thread owns the
+ *        service sockets and timers and calls back the services
+ */
+
+#ifndef _REACTOR_H
+#define _REACTOR_H
+
+#include <stdint.h>
+
+#define REACTOR_MAX_EVENTS          16            /*!> events handled per epoll_wait */
+
+/*!> called in reactor thread when fd is readable (events is the epoll mask), no reactor
+ *   lock is held so callbacks must not block: every service downlink waits behind them */
+typedef void (*reactor_fd_cb)(int fd, uint32_t events, void* arg);
+
+/*!> called in reactor thread on each expiration of a timer */
+typedef void (*reactor_timer_cb)(void* arg);
+
+/*!>
+ * \brief create the epoll instance and start the reactor thread
+ * \retval 0 on success, -1 on failure
+ */
+int reactor_start(void);
+
+/*!>
+ * \brief stop the reactor thread and release all handlers
+ */
+void reactor_stop(void);
+
+/*!>
+ * \brief watch a socket for input
+ * \retval 0 on success, -1 on failure
+ */
+int reactor_add_fd(int fd, reactor_fd_cb cb, void* arg);
+
+/*!>
+ * \brief stop watching a socket, the callback is not called any more when this returns
+ *        and is not running anymore, unless this is called from the callback itself
+ * \note the socket is not closed
+ */
+void reactor_del_fd(int fd);
+
+/*!>
+ * \brief add a periodic timer, first expiration after interval_ms
+ * \retval timer id (>= 0), -1 on failure
+ */
+int reactor_add_timer(int interval_ms, reactor_timer_cb cb, void* arg);
+
+/*!>
+ * \brief remove a timer, the callback is not called any more when this returns
+ *        and is not running anymore, unless this is called from the callback itself
+ */
+void reactor_del_timer(int timer);
+
+#endif  /* _REACTOR_H */
@@ -0,0 +1,93 @@
+/*!>
+ *  ____  ____      _    ____ ___ _   _  ___
+ *  |  _ \|  _ \    / \  / ___|_ _| \ | |/ _ \
+ *  | | | | |_) |  / _ \| |  _ | ||  \| | | | |
+ *  | |_| |  _ <  / ___ \ |_| || || |\  | |_| |
+ *  |____/|_| \_\/_/   \_\____|___|_| \_|\___/
+ *
+ * Dragino_gw_fwd -- An opensource lora gateway forward
+ *
+ * See http://www.dragino.com for more information about
+ * the lora gateway project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ *
+ * Maintainer: skerlan
+ *
+ */
+
+
+/*!>!
+ * \file
+ * \brief relay forwarding engine: relay protocol uplinks heard on the
+ *        relay channel are deduplicated, then forwarded one hop further
+ *        or given to the services, everything written to the relay uart
+ *        goes through one queue ordered by deadline
+ */
+
+#ifndef _RELAY_FWD_H
+#define _RELAY_FWD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "loragw_hal.h"
+
+#define RELAY_MAX_HOP               3             /*!> uplinks are not forwarded past this hop count */
+#define RELAY_DEDUP_NB              256           /*!> uplinks remembered, power of 2 */
+#define RELAY_DEDUP_PROBE           8             /*!> entries looked at for one uplink */
+#define RELAY_DEDUP_WINDOW_MS       5000          /*!> same uplink within this time is a duplicate */
+#define RELAY_QUEUE_NB              16            /*!> writes waiting for the uart */
+#define RELAY_UP_DEADLINE_MS        1000          /*!> forwarded uplink is dropped when not written by then */
+#define RELAY_DN_LEAD_MS            50            /*!> downlink on the relay uart this long before its TX instant */
+#define RELAY_IDLE_WAIT_MS          1000          /*!> longest sleep of the uart thread */
+
+/*!> engine stats since the previous relay_fwd_stat */
+typedef struct {
+    uint32_t nb_up_rcv;                           /*!> relay uplinks heard */
+    uint32_t nb_up_dup;                           /*!> dropped, seen within the window */
+    uint32_t nb_up_hop;                           /*!> dropped, hop limit reached */
+    uint32_t nb_up_fwd;                           /*!> queued for the next hop */
+    uint32_t nb_up_deliver;                       /*!> given to the services */
+    uint32_t nb_dn_queued;                        /*!> downlinks queued */
+    uint32_t nb_sent;                             /*!> writes done on the uart */
+    uint32_t nb_late;                             /*!> dropped, too late to be written in time */
+    uint32_t nb_full;                             /*!> dropped, queue full of earlier deadlines */
+} relay_fwd_stat_s;
+
+/*!>
+ * \brief handle a relay protocol uplink received on the relay channel
+ * \note a delivered packet is rewritten in place to the device frame with
+ *       its first hop radio metadata, count_us stays the local one
+ * \retval true if the packet is to be published, false if it is dropped
+ *         or forwarded
+ */
+bool relay_fwd_uplink(struct lgw_pkt_rx_s* p);
+
+/*!>
+ * \brief queue a downlink for the relay, due when its uart transfer at
+ *        relay_tty_baude must start to end RELAY_DN_LEAD_MS before count_us
+ * \retval 0 on success, -1 if it can't be framed, is already late or
+ *         can't be queued
+ */
+int relay_fwd_downlink(const struct lgw_pkt_tx_s* txpkt);
+
+/*!>
+ * \brief uart thread, writes the queue to the relay tty until relay_fwd_stop
+ */
+void thread_relay_fwd(void);
+
+/*!>
+ * \brief ask thread_relay_fwd to end
+ */
+void relay_fwd_stop(void);
+
+/*!>
+ * \brief copy the engine stats, and reset them if asked
+ */
+void relay_fwd_stat(relay_fwd_stat_s* st, bool reset);
+
+#endif  /* _RELAY_FWD_H */
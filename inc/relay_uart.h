@@ -0,0 +1,90 @@
+/*!>
+ *  ____  ____      _    ____ ___ _   _  ___
+ *  |  _ \|  _ \    / \  / ___|_ _| \ | |/ _ \
+ *  | | | | |_) |  / _ \| |  _ | ||  \| | | | |
+ *  | |_| |  _ <  / ___ \ |_| || || |\  | |_| |
+ *  |____/|_| \_\/_/   \_\____|___|_| \_|\___/
+ *
+ * Dragino_gw_fwd -- An opensource lora gateway forward
+ *
+ * See http://www.dragino.com for more information about
+ * the lora gateway project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ *
+ * Maintainer: skerlan
+ *
+ */
+
+
+/*!>!
+ * \file
+ * \brief packets handed to the relay module on its uart, downlinks as the
+ *        AT+SEND hex command or as a binary frame carrying a relay protocol
+ *        packet, forwarded uplinks as binary frames only
+ */
+
+#ifndef _RELAY_UART_H
+#define _RELAY_UART_H
+
+#include <stdint.h>
+
+#include "loragw_hal.h"
+#include "lora_relay_protocol.h"
+
+/*!> relay payload defined 
+ * Bytes  | Function
+ * :------:|---------------------------------------------------------------------
+ * 0      | payload direction 
+ * 1-end  | payload
+ */
+#define RELAY_UP  0x00          /*!> relay up payload send from as_relay gateway */
+#define RELAY_DN  0x01          /*!> relay down payload send from has_relay gateway */
+
+/*!> binary frame on the uart
+ * Bytes  | Function
+ * :------:|---------------------------------------------------------------------
+ * 0      | RELAY_FRAME_SOF
+ * 1-2    | length n of the relay packet, big endian as the relay protocol
+ * 3-n+2  | relay protocol packet (encode_downlink_packet, encode_uplink_packet)
+ * n+3-n+4| CRC-16/CCITT of bytes 1 to n+2, big endian
+ */
+#define RELAY_FRAME_SOF             0xA5
+#define RELAY_FRAME_OVERHEAD        5
+#define RELAY_FRAME_MAX             (RELAY_FRAME_OVERHEAD + RELAY_DW_HDR_LEN + MAX_PHY_PAYLOAD_LEN)
+#define RELAY_TX_MAX                544           /*!> largest uart write, AT+SEND of a full payload */
+
+typedef enum {
+    RELAY_FRAME_AT,                               /*!> AT+SEND with hex payload, default */
+    RELAY_FRAME_BIN
+} relay_frame_e;
+
+/*!>
+ * \brief binary frame of a downlink
+ * \retval frame length, -1 if the payload doesn't fit a relay packet or buf
+ */
+int relay_frame_downlink(uint8_t* buf, int size, const struct lgw_pkt_tx_s* txpkt);
+
+/*!>
+ * \brief binary frame of a relay protocol uplink
+ * \retval frame length, -1 if it doesn't fit buf
+ */
+int relay_frame_uplink(uint8_t* buf, int size, const uplink_packet_t* up);
+
+/*!>
+ * \brief AT+SEND command of a downlink, NUL terminated
+ * \retval bytes to write, the NUL included
+ */
+int relay_at_downlink(char* buf, int size, const struct lgw_pkt_tx_s* txpkt);
+
+/*!>
+ * \brief downlink ready for the relay uart, framed as frame says
+ * \param size  RELAY_TX_MAX is always enough
+ * \retval bytes to write, -1 on error
+ */
+int relay_format_downlink(uint8_t* buf, int size, const struct lgw_pkt_tx_s* txpkt, relay_frame_e frame);
+
+#endif  /* _RELAY_UART_H */
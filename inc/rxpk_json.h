@@ -0,0 +1,51 @@
+/*!>
+ *  ____  ____      _    ____ ___ _   _  ___
+ *  |  _ \|  _ \    / \  / ___|_ _| \ | |/ _ \
+ *  | | | | |_) |  / _ \| |  _ | ||  \| | | | |
+ *  | |_| |  _ <  / ___ \ |_| || || |\  | |_| |
+ *  |____/|_| \_\/_/   \_\____|___|_| \_|\___/
+ *
+ * Dragino_gw_fwd -- An opensource lora gateway forward
+ *
+ * See http://www.dragino.com for more information about
+ * the lora gateway project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ *
+ * Maintainer: skerlan
+ *
+ */
+
+/*!>!
+ * \file
+ * \brief semtech rxpk JSON object writer, no snprintf
+ */
+
+#ifndef _RXPK_JSON_H
+#define _RXPK_JSON_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include "loragw_hal.h"
+
+#define PROTOCOL_JSON_RXPK_FRAME_FORMAT     1
+
+/*!> largest rxpk object: metadata up to 263 chars (every number at its widest)
+ *   + 255 bytes payload = 340 chars in b64 + "}, rounded up */
+#define RXPK_JSON_MAX_SIZE          640
+
+/*!>
+ * \brief write one received packet as a rxpk JSON object ("{...}")
+ * \param buf  output buffer, must have RXPK_JSON_MAX_SIZE bytes free
+ * \param p    packet to serialize
+ * \param utc  packet time, NULL if not available ("time" is not written)
+ * \retval number of chars written (no null char), -1 if status, modulation,
+ *         datarate, bandwidth or coderate can't be described
+ */
+int rxpk_json_write(char* buf, const struct lgw_pkt_rx_s* p, const struct timespec* utc);
+
+#endif  /* _RXPK_JSON_H */
@@ -0,0 +1,71 @@
+/*!>
+ *  ____  ____      _    ____ ___ _   _  ___
+ *  |  _ \|  _ \    / \  / ___|_ _| \ | |/ _ \
+ *  | | | | |_) |  / _ \| |  _ | ||  \| | | | |
+ *  | |_| |  _ <  / ___ \ |_| || || |\  | |_| |
+ *  |____/|_| \_\/_/   \_\____|___|_| \_|\___/
+ *
+ * Dragino_gw_fwd -- An opensource lora gateway forward
+ *
+ * See http://www.dragino.com for more information about
+ * the lora gateway project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ *
+ * Maintainer: skerlan
+ *
+ */
+
+/*!>!
+ * \file
+ * \brief concentrator time base: the SX1302 counter is sampled from time
+ *        to time and extrapolated on CLOCK_MONOTONIC, readers don't touch
+ *        the SPI bus
+ */
+
+#ifndef _TIMEBASE_H
+#define _TIMEBASE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define TIMEBASE_SAMPLE_MS          1000          /*!> counter sampling period */
+#define TIMEBASE_MAX_AGE_MS         3000          /*!> an older base is resampled by the reader */
+#define TIMEBASE_MAX_DRIFT_PPM      200           /*!> larger measured drift means a counter reset, base restarts */
+#define TIMEBASE_DRIFT_FILT         8             /*!> low-pass coefficient of drift estimate */
+#define TIMEBASE_READ_JITTER_US     1000          /*!> error allowed on top of drift before a resync */
+
+/*!> accuracy of the base since the previous timebase_stat */
+typedef struct {
+    uint32_t nb_sample;                           /*!> counter readings on the bus */
+    uint32_t nb_read;                             /*!> counter values given from the base */
+    uint32_t nb_resync;                           /*!> base restarted (first sample, reset, failed read) */
+    uint32_t err_max_us;                          /*!> largest |extrapolated - read| at a sample */
+    double   err_avg_us;
+    double   drift_ppm;                           /*!> current estimate, counter against monotonic clock */
+} timebase_stat_s;
+
+/*!>
+ * \brief read the counter on the bus and update the base
+ * \note gets the concentrator (CONCENT_COUNTER), must not be called holding it
+ * \retval 0 on success, -1 if the counter can't be read (base is invalidated)
+ */
+int timebase_sample(void);
+
+/*!>
+ * \brief current concentrator counter, extrapolated from the base
+ * \note falls back to timebase_sample when the base is missing or too old,
+ *       on SX1301 this is get_concentrator_time
+ * \retval 0 on success, -1 if the counter is unknown
+ */
+int timebase_now(uint32_t* count_us);
+
+/*!>
+ * \brief copy the accuracy stats, and reset them if asked
+ */
+void timebase_stat(timebase_stat_s* st, bool reset);
+
+#endif  /* _TIMEBASE_H */
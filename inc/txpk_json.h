@@ -0,0 +1,45 @@
+/*!>
+ *  ____  ____      _    ____ ___ _   _  ___
+ *  |  _ \|  _ \    / \  / ___|_ _| \ | |/ _ \
+ *  | | | | |_) |  / _ \| |  _ | ||  \| | | | |
+ *  | |_| |  _ <  / ___ \ |_| || || |\  | |_| |
+ *  |____/|_| \_\/_/   \_\____|___|_| \_|\___/
+ *
+ * Dragino_gw_fwd -- An opensource lora gateway forward
+ *
+ * See http://www.dragino.com for more information about
+ * the lora gateway project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ *
+ * Maintainer: skerlan
+ *
+ */
+
+/*!>!
+ * \file
+ * \brief semtech txpk JSON reader, one pass and no allocation
+ */
+
+#ifndef _TXPK_JSON_H
+#define _TXPK_JSON_H
+
+#include <stdint.h>
+
+#include "loragw_hal.h"
+#include "wire_bin.h"
+
+/*!>
+ * \brief read the txpk object of a PULL_RESP straight into txpkt
+ * \param json          null terminated JSON text
+ * \param antenna_gain  removed from "powe" when it is given
+ * \retval 0 on success, -1 when the text is not a well formed txpk this
+ *         reader knows (missing field, bad value, escape, comment...), the
+ *         caller falls back to the parson reader which tells why
+ */
+int txpk_json_parse(const char* json, struct lgw_pkt_tx_s* txpkt, txpk_when_s* when, int8_t antenna_gain);
+
+#endif  /* _TXPK_JSON_H */
@@ -0,0 +1,141 @@
+/*!>
+ *  ____  ____      _    ____ ___ _   _  ___
+ *  |  _ \|  _ \    / \  / ___|_ _| \ | |/ _ \
+ *  | | | | |_) |  / _ \| |  _ | ||  \| | | | |
+ *  | |_| |  _ <  / ___ \ |_| || || |\  | |_| |
+ *  |____/|_| \_\/_/   \_\____|___|_| \_|\___/
+ *
+ * Dragino_gw_fwd -- An opensource lora gateway forward
+ *
+ * See http://www.dragino.com for more information about
+ * the lora gateway project. Please do not directly contact
+ * any of the maintainers of this project for assistance;
+ *
+ * This program is free software, distributed under the terms of
+ * the GNU General Public License Version 2. See the LICENSE file
+ * at the top of the source tree.
+ *
+ * Maintainer: skerlan
+ *
+ */
+
+/*!>!
+ * \file
+ * \brief compact binary payload of the semtech UDP protocol
+ *
+ *  Datagram headers are the semtech ones, with WIRE_BIN_VERSION as protocol
+ *  version. Payload is a list of records: type (1 byte), value length
+ *  (2 bytes) and value. All numbers are little endian.
+ *
+ *  rxpk value (WIRE_BIN_RXPK_HDR bytes then payload):
+ *   0 tmst u32 | 4 time u64, us since 1970 (0: unknown) | 12 freq u32 Hz
+ *  16 datr u32, SF or bit/s | 20 foff i32 Hz | 24 rssis i16 | 26 rssi i16
+ *  28 lsnr i16, all three 0.1 dB | 30 bw u16 kHz (0: FSK) | 32 chan u8
+ *  33 rfch u8 | 34 mid u8 | 35 stat i8 | 36 modu u8 | 37 codr u8, 4/x (0: OFF)
+ *  38 size u8 | 39 payload
+ *
+ *  stat value (WIRE_BIN_STAT_SIZE bytes):
+ *   0 time u64, s since 1970 | 8 flags u8 | 9 lati i32 | 13 long i32, 1e-5 deg
+ *  17 alti i16 m | 19 rxnb u32 | 23 rxok u32 | 27 rxfw u32 | 31 ackr u16 0.1%
+ *  33 dwnb u32 | 37 txnb u32
+ *
+ *  txpk value (WIRE_BIN_TXPK_HDR bytes then payload):
+ *   0 flags u8 | 1 time u64, tmst or tmms | 9 freq u32 Hz | 13 datr u32
+ *  17 fdev u32 Hz | 21 bw u16 kHz | 23 prea u16 (0: default) | 25 rfch u8
+ *  26 powe i8 | 27 modu u8 | 28 codr u8 | 29 size u8 | 30 payload
+ *
+ *  txpk_ack value: 0 error u8 (jit_error_e) | 1 value i32
+ */
+
+#ifndef _WIRE_BIN_H
+#define _WIRE_BIN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "loragw_hal.h"
+
+#define WIRE_BIN_VERSION            0x82          /*!> protocol version of binary datagrams */
+
+#define WIRE_BIN_RXPK               0x01          /*!> record types */
+#define WIRE_BIN_STAT               0x02
+#define WIRE_BIN_TXPK               0x03
+#define WIRE_BIN_TXACK              0x04
+
+#define WIRE_BIN_REC_HDR            3             /*!> type + length */
+#define WIRE_BIN_RXPK_HDR           39
+#define WIRE_BIN_STAT_SIZE          41
+#define WIRE_BIN_TXPK_HDR           30
+#define WIRE_BIN_TXACK_SIZE         5
+
+#define WIRE_BIN_MOD_LORA           1             /*!> modu values */
+#define WIRE_BIN_MOD_FSK            2
+
+#define WIRE_BIN_STAT_GPS           0x01          /*!> stat flags: coordinates are valid */
+
+#define WIRE_BIN_TX_IMME            0x01          /*!> txpk flags */
+#define WIRE_BIN_TX_TMMS            0x02          /*!> time is GPS time in ms, else tmst */
+#define WIRE_BIN_TX_NCRC            0x04
+#define WIRE_BIN_TX_IPOL            0x08
+
+typedef enum {
+    WIRE_FORMAT_JSON,                             /*!> semtech JSON, default */
+    WIRE_FORMAT_BIN
+} wire_format_e;
+
+/*!> protocol version byte of datagrams exchanged with a server */
+#define WIRE_VERSION(fmt)           ((fmt) == WIRE_FORMAT_BIN ? WIRE_BIN_VERSION : PROTOCOL_VERSION)
+
+/*!> when a downlink is to be sent */
+typedef struct {
+    bool imme;                                    /*!> immediately, class C */
+    bool tmms;                                    /*!> on GPS time gps_ms, class B */
+    uint64_t gps_ms;                              /*!> else on txpkt count_us, class A */
+} txpk_when_s;
+
+/*!> status report values */
+typedef struct {
+    time_t time;
+    bool coord_ok;
+    double lat, lon;
+    int16_t alt;
+    uint32_t rxnb, rxok, rxfw;
+    float ackr;                                   /*!> percent */
+    uint32_t dwnb, txnb;
+} wire_bin_stat_s;
+
+/*!>
+ * \brief size of the record starting at buf, header included
+ */
+int wire_bin_rec_size(const uint8_t* buf);
+
+/*!>
+ * \brief write one received packet as a rxpk record
+ * \param buf  output buffer, must have WIRE_BIN_REC_HDR + WIRE_BIN_RXPK_HDR + 255 bytes free
+ * \param utc  packet time, NULL if not available
+ * \retval record size, -1 if status, modulation, datarate, bandwidth or coderate can't be described
+ */
+int wire_bin_rxpk_write(uint8_t* buf, const struct lgw_pkt_rx_s* p, const struct timespec* utc);
+
+/*!>
+ * \brief write the status report as a stat record
+ * \retval record size
+ */
+int wire_bin_stat_write(uint8_t* buf, const wire_bin_stat_s* st);
+
+/*!>
+ * \brief write a txpk_ack record
+ * \retval record size
+ */
+int wire_bin_txack_write(uint8_t* buf, uint8_t error, int32_t value);
+
+/*!>
+ * \brief read a txpk record, preamble is set to a default or raised to its minimum
+ * \param len  bytes available at buf
+ * \retval 0 on success, -1 on truncated record or unknown value
+ * \note rf_power is the one asked by server, antenna gain is not removed
+ */
+int wire_bin_txpk_read(const uint8_t* buf, int len, struct lgw_pkt_tx_s* txpkt, txpk_when_s* when);
+
+#endif  /* _WIRE_BIN_H */
@@ -11,36 +11,35 @@
 #include <stdlib.h>
 #include <stdbool.h>
 
-/* 检查系统字节序 */
-static bool is_big_endian(void)
+/*
+ * 多字节字段按协议以大端写入/读出。使用移位而不是运行时字节序判断，
+ * 与主机字节序无关，编译器在编译期即可优化为字节交换指令。
+ */
+static inline uint8_t *put_be16(uint8_t *d, uint16_t v)
 {
-	union {
-		uint32_t i;
-		char c[4];
-	} bint = {0x01020304};
+	d[0] = v >> 8;
+	d[1] = v & 0xFF;
+	return d + 2;
+}
 
-	return bint.c[0] == 1;
+static inline uint8_t *put_be32(uint8_t *d, uint32_t v)
+{
+	d[0] = v >> 24;
+	d[1] = (v >> 16) & 0xFF;
+	d[2] = (v >> 8) & 0xFF;
+	d[3] = v & 0xFF;
+	return d + 4;
 }
 
-/* 将大端字节序转换为主机字节序（32位） */
-static uint32_t be_to_host32(uint32_t value)
+static inline uint16_t get_be16(const uint8_t *s)
 {
-	if (is_big_endian())
-		return value;
-	else {
-		/* 小端系统，进行字节交换 */
-		return ((value & 0x000000FF) << 24) |
-		       ((value & 0x0000FF00) << 8)  |
-		       ((value & 0x00FF0000) >> 8)  |
-		       ((value & 0xFF000000) >> 24);
-	}
+	return (uint16_t)((s[0] << 8) | s[1]);
 }
 
-/* 将主机字节序转换为大端字节序（32位） */
-static uint32_t host_to_be32(uint32_t value)
+static inline uint32_t get_be32(const uint8_t *s)
 {
-	/* 与be_to_host32相同，因为我们需要确保数据以大端格式发送 */
-	return be_to_host32(value);
+	return ((uint32_t)s[0] << 24) | ((uint32_t)s[1] << 16) |
+	       ((uint32_t)s[2] << 8)  | (uint32_t)s[3];
 }
 
 /**
@@ -262,6 +261,42 @@ bool parse_mhdr(uint8_t mhdr_byte, meta_type_t *meta_type,
 	return true;
 }
 
+/**
+ * @brief 编码上发协议包到调用者提供的缓冲区
+ *
+ * @param[in] packet 指向uplink_packet结构体的指针
+ * @param[out] buf 输出缓冲区
+ * @param[in] size 输出缓冲区长度
+ * @return 成功返回编码后的长度，失败返回-1
+ * @note 不分配内存，缓冲区长度至少为RELAY_UP_HDR_LEN + payload_len
+ */
+int encode_uplink_packet(const uplink_packet_t *packet, uint8_t *buf, uint16_t size)
+{
+	uint8_t *d = buf;
+
+	/* 参数合法性检查 */
+	if (!packet || !buf || packet->payload_len > MAX_PHY_PAYLOAD_LEN)
+		return -1;
+	if (packet->payload_type != UPLINK_TYPE || packet->meta_type != LORAWAN_TYPE)
+		return -1;
+	if (size < RELAY_UP_HDR_LEN + packet->payload_len)
+		return -1;
+
+	/* MHDR */
+	*d++ = build_mhdr(packet->meta_type, packet->payload_type, packet->hop_count);
+
+	/* Uplink META: uplink_id(12位)|data_rate(4位), rssi, snr, channel */
+	d = put_be16(d, (uint16_t)((packet->uplink_id << 4) | (packet->data_rate & 0x0F)));
+	*d++ = (uint8_t)packet->rssi;
+	*d++ = (uint8_t)packet->snr;
+	*d++ = packet->channel;
+
+	/* PHY payload */
+	memcpy(d, packet->phy_payload, packet->payload_len);
+
+	return RELAY_UP_HDR_LEN + packet->payload_len;
+}
+
 /**
  * @brief 打包上发协议包
  *
@@ -270,52 +305,28 @@ bool parse_mhdr(uint8_t mhdr_byte, meta_type_t *meta_type,
  * @param[in] packet 指向uplink_packet结构体的指针
  * @param[out] out_len 输出打包后的字节流长度
  * @return 成功返回动态分配的字节流缓冲区，失败返回NULL
- * @note 调用者必须在使用完毕后释放返回的缓冲区
+ * @note 调用者必须在使用完毕后释放返回的缓冲区，热路径请使用encode_uplink_packet
  * @warning 当payload_len超过MAX_PHY_PAYLOAD_LEN时返回NULL
  */
 uint8_t *pack_uplink_packet(const uplink_packet_t *packet, uint16_t *out_len)
 {
-	/* 参数合法性检查 */
+	uint8_t *buffer;
+	int len;
+
 	if (!packet || !out_len || packet->payload_len > MAX_PHY_PAYLOAD_LEN)
 		return NULL;
-	
-	/* 验证包类型是否正确 */
-	if (packet->payload_type != UPLINK_TYPE)
-		return NULL;
-	
-	/* 验证meta_type是否为LORAWAN_TYPE */
-	if (packet->meta_type != LORAWAN_TYPE)
-		return NULL;
-	
-	/* 计算总长度: MHDR(1) + Uplink META(5) + PHY payload(n) */
-	*out_len = 1 + 5 + packet->payload_len;
-	uint8_t *buffer = (uint8_t *)malloc(*out_len);
+
+	buffer = (uint8_t *)malloc(RELAY_UP_HDR_LEN + packet->payload_len);
 	if (!buffer)
 		return NULL;	/* 内存分配失败 */
-	
-	uint8_t index = 0;
-	
-	/* 打包MHDR */
-	buffer[index++] = build_mhdr(packet->meta_type, packet->payload_type, packet->hop_count);
-	
-	/* 打包Uplink META */
-	/* 第1-2字节: uplink_id(12位，位15-4)和data_rate(4位，位3-0) */
-	buffer[index++] = (packet->uplink_id >> 4) & 0xFF;	/* uplink_id高8位 */
-	buffer[index++] = ((packet->uplink_id & 0x0F) << 4) | (packet->data_rate & 0x0F);
-	
-	/* 第3字节: rssi */
-	buffer[index++] = (uint8_t)packet->rssi;
-	
-	/* 第4字节: snr */
-	buffer[index++] = (uint8_t)packet->snr;
-	
-	/* 第5字节: channel */
-	buffer[index++] = packet->channel;
-	
-	/* 打包PHY payload */
-	memcpy(&buffer[index], packet->phy_payload, packet->payload_len);
-	index += packet->payload_len;
-	
+
+	len = encode_uplink_packet(packet, buffer, RELAY_UP_HDR_LEN + packet->payload_len);
+	if (len < 0) {
+		free(buffer);
+		return NULL;
+	}
+	*out_len = (uint16_t)len;
+
 	return buffer;
 }
 
@@ -333,7 +344,7 @@ uint8_t *pack_uplink_packet(const uplink_packet_t *packet, uint16_t *out_len)
 bool unpack_uplink_packet(const uint8_t *data, uint16_t len, uplink_packet_t *packet)
 {
 	/* 参数合法性检查 */
-	if (!data || !packet || len < 6)	/* 最小长度: 1+5=6字节 */
+	if (!data || !packet || len < RELAY_UP_HDR_LEN)	/* 最小长度: 1+5=6字节 */
 		return false;
 	
 	uint8_t index = 0;
@@ -352,7 +363,7 @@ bool unpack_uplink_packet(const uint8_t *data, uint16_t len, uplink_packet_t *pa
 	
 	/* 解析Uplink META */
 	/* 解析uplink_id(12位，位15-4)和data_rate(4位，位3-0) */
-	packet->uplink_id = (data[index] << 4) | ((data[index+1] >> 4) & 0x0F);
+	packet->uplink_id = get_be16(&data[index]) >> 4;
 	packet->data_rate = data[index+1] & 0x0F;
 	index += 2;
 	
@@ -376,6 +387,44 @@ bool unpack_uplink_packet(const uint8_t *data, uint16_t len, uplink_packet_t *pa
 	return true;
 }
 
+/**
+ * @brief 编码下发协议包到调用者提供的缓冲区
+ *
+ * @param[in] packet 指向downlink_packet结构体的指针
+ * @param[out] buf 输出缓冲区
+ * @param[in] size 输出缓冲区长度
+ * @return 成功返回编码后的长度，失败返回-1
+ * @note 不分配内存，缓冲区长度至少为RELAY_DW_HDR_LEN + payload_len
+ */
+int encode_downlink_packet(const downlink_packet_t *packet, uint8_t *buf, uint16_t size)
+{
+	uint8_t *d = buf;
+
+	/* 参数合法性检查 */
+	if (!packet || !buf || packet->payload_len > MAX_PHY_PAYLOAD_LEN)
+		return -1;
+	if (packet->payload_type != DOWNLINK_TYPE || packet->meta_type != LORAWAN_TYPE)
+		return -1;
+	if (size < RELAY_DW_HDR_LEN + packet->payload_len)
+		return -1;
+
+	/* MHDR */
+	*d++ = build_mhdr(packet->meta_type, packet->payload_type, packet->hop_count);
+
+	/* Dwlink META: dwlink_id(12位)|data_rate(4位), frequency, txpow(4位)|delay(4位) */
+	d = put_be16(d, (uint16_t)((packet->dwlink_id << 4) | (packet->data_rate & 0x0F)));
+	d = put_be32(d, packet->frequency);
+	*d++ = ((packet->tx_power & 0x0F) << 4) | (packet->delay & 0x0F);
+
+	/* count_us */
+	d = put_be32(d, packet->count_us);
+
+	/* PHY payload */
+	memcpy(d, packet->phy_payload, packet->payload_len);
+
+	return RELAY_DW_HDR_LEN + packet->payload_len;
+}
+
 /**
  * @brief 打包下发协议包
  *
@@ -384,60 +433,28 @@ bool unpack_uplink_packet(const uint8_t *data, uint16_t len, uplink_packet_t *pa
  * @param[in] packet 指向downlink_packet结构体的指针
  * @param[out] out_len 输出打包后的字节流长度
  * @return 成功返回动态分配的字节流缓冲区，失败返回NULL
- * @note 调用者必须在使用完毕后释放返回的缓冲区
+ * @note 调用者必须在使用完毕后释放返回的缓冲区，热路径请使用encode_downlink_packet
  * @warning 当payload_len超过MAX_PHY_PAYLOAD_LEN时返回NULL
  */
 uint8_t *pack_downlink_packet(const downlink_packet_t *packet, uint16_t *out_len)
 {
-	/* 参数合法性检查 */
+	uint8_t *buffer;
+	int len;
+
 	if (!packet || !out_len || packet->payload_len > MAX_PHY_PAYLOAD_LEN)
 		return NULL;
-	
-	/* 验证包类型是否正确 */
-	if (packet->payload_type != DOWNLINK_TYPE)
-		return NULL;
-	
-	/* 验证meta_type是否为LORAWAN_TYPE */
-	if (packet->meta_type != LORAWAN_TYPE)
-		return NULL;
-	
-	/* 计算总长度: MHDR(1) + Dwlink META(7) + count_us(4) + PHY payload(n) */
-	*out_len = 1 + 7 + 4 + packet->payload_len;
-	uint8_t *buffer = (uint8_t *)malloc(*out_len);
+
+	buffer = (uint8_t *)malloc(RELAY_DW_HDR_LEN + packet->payload_len);
 	if (!buffer)
 		return NULL;	/* 内存分配失败 */
-	
-	uint8_t index = 0;
-	
-	/* 打包MHDR */
-	buffer[index++] = build_mhdr(packet->meta_type, packet->payload_type, packet->hop_count);
-	
-	/* 打包Dwlink META */
-	/* 第1-2字节: dwlink_id(12位，位15-4)和data_rate(4位，位3-0) */
-	buffer[index++] = (packet->dwlink_id >> 4) & 0xFF;	/* dwlink_id高8位 */
-	buffer[index++] = ((packet->dwlink_id & 0x0F) << 4) | (packet->data_rate & 0x0F);
-	
-	/* 第3-6字节: frequency(32位，大端模式) */
-	uint32_t freq_be = host_to_be32(packet->frequency);
-	buffer[index++] = (freq_be >> 24) & 0xFF;
-	buffer[index++] = (freq_be >> 16) & 0xFF;
-	buffer[index++] = (freq_be >> 8) & 0xFF;
-	buffer[index++] = freq_be & 0xFF;
-	
-	/* 第7字节: txpow(4位)和delay(4位) */
-	buffer[index++] = ((packet->tx_power & 0x0F) << 4) | (packet->delay & 0x0F);
-	
-	/* 打包count_us(4字节，大端模式) */
-	uint32_t count_us_be = host_to_be32(packet->count_us);
-	buffer[index++] = (count_us_be >> 24) & 0xFF;
-	buffer[index++] = (count_us_be >> 16) & 0xFF;
-	buffer[index++] = (count_us_be >> 8) & 0xFF;
-	buffer[index++] = count_us_be & 0xFF;
-	
-	/* 打包PHY payload */
-	memcpy(&buffer[index], packet->phy_payload, packet->payload_len);
-	index += packet->payload_len;
-	
+
+	len = encode_downlink_packet(packet, buffer, RELAY_DW_HDR_LEN + packet->payload_len);
+	if (len < 0) {
+		free(buffer);
+		return NULL;
+	}
+	*out_len = (uint16_t)len;
+
 	return buffer;
 }
 
@@ -455,7 +472,7 @@ uint8_t *pack_downlink_packet(const downlink_packet_t *packet, uint16_t *out_len
 bool unpack_downlink_packet(const uint8_t *data, uint16_t len, downlink_packet_t *packet)
 {
 	/* 参数合法性检查 */
-	if (!data || !packet || len < 12)	/* 最小长度: 1+7+4=12字节 */
+	if (!data || !packet || len < RELAY_DW_HDR_LEN)	/* 最小长度: 1+7+4=12字节 */
 		return false;
 	
 	uint8_t index = 0;
@@ -474,29 +491,21 @@ bool unpack_downlink_packet(const uint8_t *data, uint16_t len, downlink_packet_t
 	
 	/* 解析Dwlink META */
 	/* 解析dwlink_id(12位，位15-4)和data_rate(4位，位3-0) */
-	packet->dwlink_id = (data[index] << 4) | ((data[index+1] >> 4) & 0x0F);
+	packet->dwlink_id = get_be16(&data[index]) >> 4;
 	packet->data_rate = data[index+1] & 0x0F;
 	index += 2;
 	
-	/* 解析frequency(32位，大端模式转主机字节序) */
-	uint32_t freq_be = 0;
-	freq_be = (uint32_t)data[index++] << 24;
-	freq_be |= (uint32_t)data[index++] << 16;
-	freq_be |= (uint32_t)data[index++] << 8;
-	freq_be |= (uint32_t)data[index++];
-	packet->frequency = be_to_host32(freq_be);
+	/* 解析frequency(32位，大端模式) */
+	packet->frequency = get_be32(&data[index]);
+	index += 4;
 	
 	/* 解析txpow和delay */
 	packet->tx_power = (data[index] >> 4) & 0x0F;
 	packet->delay = data[index++] & 0x0F;
 	
-	/* 解析count_us(32位，大端模式转主机字节序) */
-	uint32_t count_us_be = 0;
-	count_us_be = (uint32_t)data[index++] << 24;
-	count_us_be |= (uint32_t)data[index++] << 16;
-	count_us_be |= (uint32_t)data[index++] << 8;
-	count_us_be |= (uint32_t)data[index++];
-	packet->count_us = be_to_host32(count_us_be);
+	/* 解析count_us(32位，大端模式) */
+	packet->count_us = get_be32(&data[index]);
+	index += 4;
 	
 	/* 解析PHY payload */
 	packet->payload_len = len - index;
@@ -507,6 +516,40 @@ bool unpack_downlink_packet(const uint8_t *data, uint16_t len, downlink_packet_t
 	return true;
 }
 
+/**
+ * @brief 编码事件协议包到调用者提供的缓冲区
+ *
+ * @param[in] packet 指向event_packet结构体的指针
+ * @param[out] buf 输出缓冲区
+ * @param[in] size 输出缓冲区长度
+ * @return 成功返回编码后的长度，失败返回-1
+ * @note 不分配内存，缓冲区长度至少为RELAY_EV_HDR_LEN + payload_len
+ */
+int encode_event_packet(const event_packet_t *packet, uint8_t *buf, uint16_t size)
+{
+	uint8_t *d = buf;
+
+	/* 参数合法性检查 */
+	if (!packet || !buf || packet->payload_len > MAX_EVENT_PAYLOAD_LEN)
+		return -1;
+	if (packet->payload_type != EVENT_TYPE || packet->meta_type != LORAWAN_TYPE)
+		return -1;
+	if (size < RELAY_EV_HDR_LEN + packet->payload_len)
+		return -1;
+
+	/* MHDR */
+	*d++ = build_mhdr(packet->meta_type, packet->payload_type, packet->hop_count);
+
+	/* Event META: eventID, event type */
+	d = put_be16(d, packet->event_id);
+	*d++ = (uint8_t)packet->event_type;
+
+	/* EVENT payload */
+	memcpy(d, packet->event_payload, packet->payload_len);
+
+	return RELAY_EV_HDR_LEN + packet->payload_len;
+}
+
 /**
  * @brief 打包事件协议包
  *
@@ -515,46 +558,28 @@ bool unpack_downlink_packet(const uint8_t *data, uint16_t len, downlink_packet_t
  * @param[in] packet 指向event_packet结构体的指针
  * @param[out] out_len 输出打包后的字节流长度
  * @return 成功返回动态分配的字节流缓冲区，失败返回NULL
- * @note 调用者必须在使用完毕后释放返回的缓冲区
+ * @note 调用者必须在使用完毕后释放返回的缓冲区，热路径请使用encode_event_packet
  * @warning 当payload_len超过MAX_EVENT_PAYLOAD_LEN时返回NULL
  */
 uint8_t *pack_event_packet(const event_packet_t *packet, uint16_t *out_len)
 {
-	/* 参数合法性检查 */
+	uint8_t *buffer;
+	int len;
+
 	if (!packet || !out_len || packet->payload_len > MAX_EVENT_PAYLOAD_LEN)
 		return NULL;
-	
-	/* 验证包类型是否正确 */
-	if (packet->payload_type != EVENT_TYPE)
-		return NULL;
-	
-	/* 验证meta_type是否为LORAWAN_TYPE */
-	if (packet->meta_type != LORAWAN_TYPE)
-		return NULL;
-	
-	/* 计算总长度: MHDR(1) + Event META(3) + EVENT payload(n) */
-	*out_len = 1 + 3 + packet->payload_len;
-	uint8_t *buffer = (uint8_t *)malloc(*out_len);
+
+	buffer = (uint8_t *)malloc(RELAY_EV_HDR_LEN + packet->payload_len);
 	if (!buffer)
 		return NULL;	/* 内存分配失败 */
-	
-	uint8_t index = 0;
-	
-	/* 打包MHDR */
-	buffer[index++] = build_mhdr(packet->meta_type, packet->payload_type, packet->hop_count);
-	
-	/* 打包Event META */
-	/* 第1-2字节: eventID(大端模式) */
-	buffer[index++] = (packet->event_id >> 8) & 0xFF;
-	buffer[index++] = packet->event_id & 0xFF;
-	
-	/* 第3字节: event type */
-	buffer[index++] = (uint8_t)packet->event_type;
-	
-	/* 打包EVENT payload */
-	memcpy(&buffer[index], packet->event_payload, packet->payload_len);
-	index += packet->payload_len;
-	
+
+	len = encode_event_packet(packet, buffer, RELAY_EV_HDR_LEN + packet->payload_len);
+	if (len < 0) {
+		free(buffer);
+		return NULL;
+	}
+	*out_len = (uint16_t)len;
+
 	return buffer;
 }
 
@@ -572,7 +597,7 @@ uint8_t *pack_event_packet(const event_packet_t *packet, uint16_t *out_len)
 bool unpack_event_packet(const uint8_t *data, uint16_t len, event_packet_t *packet)
 {
 	/* 参数合法性检查 */
-	if (!data || !packet || len < 4)	/* 最小长度: 1+3=4字节 */
+	if (!data || !packet || len < RELAY_EV_HDR_LEN)	/* 最小长度: 1+3=4字节 */
 		return false;
 	
 	uint8_t index = 0;
@@ -591,8 +616,8 @@ bool unpack_event_packet(const uint8_t *data, uint16_t len, event_packet_t *pack
 	
 	/* 解析Event META */
 	/* 解析eventID(大端模式转主机字节序) */
-	packet->event_id = (uint16_t)data[index++] << 8;
-	packet->event_id |= (uint16_t)data[index++];
+	packet->event_id = get_be16(&data[index]);
+	index += 2;
 	
 	/* 解析event type */
 	packet->event_type = (event_type_t)data[index++];
@@ -5,8 +5,11 @@
  * 定义了LoraRelay协议栈的三种协议包（上发、下发和事件）的数据结构
  * 以及相关的打包、解包函数声明。
  *
- * 协议采用大端字节序进行网络传输，代码中已实现自动字节序转换，
- * 可在大端和小端系统上正确运行。
+ * 协议采用大端字节序进行网络传输，字段按字节移位读写，与主机字节序
+ * 无关，可在大端和小端系统上正确运行。
+ *
+ * encode_*_packet编码到调用者提供的缓冲区，unpack_*_packet解码到调用者
+ * 提供的结构体，均不分配内存。
  */
 
 #ifndef LORA_RELAY_PROTOCOL_H
@@ -22,6 +25,9 @@
  */
 #define MAX_PHY_PAYLOAD_LEN    245  /* PHY最大负载长度 255 - relay_payload_len(8bytes) */
 #define MAX_EVENT_PAYLOAD_LEN  240  /* 事件最大负载长度 */
+#define RELAY_UP_HDR_LEN       6    /* MHDR(1) + Uplink META(5) */
+#define RELAY_DW_HDR_LEN       12   /* MHDR(1) + Dwlink META(7) + count_us(4) */
+#define RELAY_EV_HDR_LEN       4    /* MHDR(1) + Event META(3) */
 /** @} */
 
 /**
@@ -260,6 +266,16 @@ uint8_t build_mhdr(meta_type_t meta_type, payload_type_t payload_type, uint8_t h
 bool parse_mhdr(uint8_t mhdr_byte, meta_type_t *meta_type,
                payload_type_t *payload_type, uint8_t *hop_count);
 
+/**
+ * @brief 编码上发协议包到调用者提供的缓冲区
+ *
+ * @param[in] packet 指向UplinkPacket结构体的指针
+ * @param[out] buf 输出缓冲区
+ * @param[in] size 输出缓冲区长度
+ * @return 成功返回编码后的长度，失败返回-1
+ */
+int encode_uplink_packet(const uplink_packet_t *packet, uint8_t *buf, uint16_t size);
+
 /**
  * @brief 打包上发协议包
  *
@@ -283,6 +299,16 @@ uint8_t *pack_uplink_packet(const uplink_packet_t *packet, uint16_t *out_len);
  */
 bool unpack_uplink_packet(const uint8_t *data, uint16_t len, uplink_packet_t *packet);
 
+/**
+ * @brief 编码下发协议包到调用者提供的缓冲区
+ *
+ * @param[in] packet 指向DownlinkPacket结构体的指针
+ * @param[out] buf 输出缓冲区
+ * @param[in] size 输出缓冲区长度
+ * @return 成功返回编码后的长度，失败返回-1
+ */
+int encode_downlink_packet(const downlink_packet_t *packet, uint8_t *buf, uint16_t size);
+
 /**
  * @brief 打包下发协议包
  *
@@ -306,6 +332,16 @@ uint8_t *pack_downlink_packet(const downlink_packet_t *packet, uint16_t *out_len
  */
 bool unpack_downlink_packet(const uint8_t *data, uint16_t len, downlink_packet_t *packet);
 
+/**
+ * @brief 编码事件协议包到调用者提供的缓冲区
+ *
+ * @param[in] packet 指向EventPacket结构体的指针
+ * @param[out] buf 输出缓冲区
+ * @param[in] size 输出缓冲区长度
+ * @return 成功返回编码后的长度，失败返回-1
+ */
+int encode_event_packet(const event_packet_t *packet, uint8_t *buf, uint16_t size);
+
 /**
  * @brief 打包事件协议包
  *
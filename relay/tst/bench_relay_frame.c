@@ -0,0 +1,167 @@
+/**
+ * @file bench_relay_frame.c
+ * @brief relay uart downlink framing, AT+SEND hex against the binary frame
+ *
+ * Both framings of fwd/relay_uart.c are run on the same downlinks. The
+ * binary frame is checked (SOF, length, CRC, relay packet) and for each
+ * payload size the bytes on the uart, the uart time and the formatting
+ * time of both are printed.
+ */
+
+#define _XOPEN_SOURCE 600
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "relay_uart.h"
+
+#define BENCH_LOOPS     200000
+
+static const int sizes[] = { 10, 23, 50, 115, 222 };
+
+#define SIZES_NB        (sizeof(sizes) / sizeof(sizes[0]))
+
+static void usage(void)
+{
+	printf("Available options:\n");
+	printf(" -h print this help\n");
+	printf(" -n <uint>  formatting loops per size, default %d\n", BENCH_LOOPS);
+}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* reference CRC-16/CCITT-FALSE, check value 0x29B1 for "123456789" */
+static uint16_t crc_ref(const uint8_t *d, int len)
+{
+	uint16_t crc = 0xFFFF;
+	int i;
+
+	while (len--) {
+		crc ^= (uint16_t)*d++ << 8;
+		for (i = 0; i < 8; i++)
+			crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+	return crc;
+}
+
+static void make_txpkt(struct lgw_pkt_tx_s *tx, int size)
+{
+	int i;
+
+	memset(tx, 0, sizeof(*tx));
+	tx->freq_hz = 869525000;
+	tx->modulation = MOD_LORA;
+	tx->datarate = DR_LORA_SF12;
+	tx->bandwidth = BW_125KHZ;
+	tx->count_us = 0x12345678;
+	tx->size = size;
+	for (i = 0; i < size; i++)
+		tx->payload[i] = (uint8_t)(i * 7 + 1);
+}
+
+/* the binary frame must carry the downlink as the relay protocol says */
+static bool check_frame(const uint8_t *f, int len, const struct lgw_pkt_tx_s *tx)
+{
+	downlink_packet_t dp;
+	int n;
+
+	if (len != RELAY_FRAME_OVERHEAD + RELAY_DW_HDR_LEN + tx->size || f[0] != RELAY_FRAME_SOF)
+		return false;
+	n = (f[1] << 8) | f[2];
+	if (n != len - RELAY_FRAME_OVERHEAD)
+		return false;
+	if (crc_ref(f + 1, n + 2) != ((f[n + 3] << 8) | f[n + 4]))
+		return false;
+	if (!unpack_downlink_packet(f + 3, n, &dp))
+		return false;
+
+	return dp.data_rate == 12 && dp.frequency == tx->freq_hz && dp.count_us == tx->count_us &&
+	       dp.payload_len == tx->size && memcmp(dp.phy_payload, tx->payload, tx->size) == 0;
+}
+
+/* 10 bits a byte on the uart, 8N1 */
+static double uart_ms(int len, int baud)
+{
+	return len * 10 * 1000.0 / baud;
+}
+
+int main(int argc, char **argv)
+{
+	struct lgw_pkt_tx_s tx;
+	uint8_t buf[RELAY_TX_MAX];
+	int i, opt, len_at, len_bin, loops = BENCH_LOOPS;
+	unsigned int s;
+	double t_at, t_bin;
+	int nb_fail = 0;
+
+	while ((opt = getopt(argc, argv, "hn:")) != -1) {
+		switch (opt) {
+		case 'h':
+			usage();
+			return EXIT_SUCCESS;
+		case 'n':
+			loops = atoi(optarg);
+			if (loops > 0)
+				break;
+			/* fall through */
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (crc_ref((const uint8_t *)"123456789", 9) != 0x29B1) {
+		printf("FAIL reference crc\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("payload |  AT bytes  bin bytes | AT ms@9600 bin ms@9600 | AT ms@115200 bin ms@115200 |  AT ns  bin ns\n");
+
+	for (s = 0; s < SIZES_NB; s++) {
+		make_txpkt(&tx, sizes[s]);
+
+		len_bin = relay_format_downlink(buf, sizeof(buf), &tx, RELAY_FRAME_BIN);
+		if (!check_frame(buf, len_bin, &tx)) {
+			printf("FAIL binary frame of %d bytes\n", sizes[s]);
+			nb_fail++;
+		}
+		len_at = relay_format_downlink(buf, sizeof(buf), &tx, RELAY_FRAME_AT);
+		if (len_at != (int)strlen((char *)buf) + 1 || strncmp((char *)buf, "AT+SEND=0,0112345678", 20) != 0) {
+			printf("FAIL AT+SEND of %d bytes: %s\n", sizes[s], (char *)buf);
+			nb_fail++;
+		}
+
+		t_at = now_ns();
+		for (i = 0; i < loops; i++)
+			relay_format_downlink(buf, sizeof(buf), &tx, RELAY_FRAME_AT);
+		t_at = (now_ns() - t_at) / loops;
+
+		t_bin = now_ns();
+		for (i = 0; i < loops; i++)
+			relay_format_downlink(buf, sizeof(buf), &tx, RELAY_FRAME_BIN);
+		t_bin = (now_ns() - t_bin) / loops;
+
+		printf("%7d | %9d %10d | %10.1f %11.1f | %12.2f %13.2f | %6.0f %6.0f\n",
+		       sizes[s], len_at, len_bin,
+		       uart_ms(len_at, 9600), uart_ms(len_bin, 9600),
+		       uart_ms(len_at, 115200), uart_ms(len_bin, 115200),
+		       t_at, t_bin);
+	}
+
+	if (nb_fail > 0) {
+		printf("%d check(s) failed\n", nb_fail);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
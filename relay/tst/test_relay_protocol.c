@@ -0,0 +1,318 @@
+/**
+ * @file test_relay_protocol.c
+ * @brief round trip test of the relay protocol packets
+ *
+ * Fixed vectors pin the big endian wire layout (frequency and count_us
+ * included), random packets go through encode and unpack and back, buffers
+ * one byte short are refused and random bytes fed to unpack_* must either
+ * be refused or encode back to the same bytes. Build it with ASan/UBSan
+ * (make check) so any read or write past a buffer stops the test.
+ */
+
+#define _XOPEN_SOURCE 600
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "lora_relay_protocol.h"
+
+#define ROUNDS_DEFAULT  1000000
+#define FUZZ_LEN_MAX    300
+
+static int nb_fail = 0;
+
+#define CHECK(cond, ...) do {                           \
+	if (!(cond)) {                                  \
+		printf("FAIL %s:%d ", __func__, __LINE__); \
+		printf(__VA_ARGS__);                    \
+		printf("\n");                           \
+		nb_fail++;                              \
+	}                                               \
+} while (0)
+
+static void usage(void)
+{
+	printf("Available options:\n");
+	printf(" -h print this help\n");
+	printf(" -n <uint>  random round trips and fuzz inputs, default %d\n", ROUNDS_DEFAULT);
+	printf(" -s <uint>  random seed, default 1\n");
+}
+
+static void dump(const char *label, const uint8_t *b, int len)
+{
+	int i;
+
+	printf("    %s", label);
+	for (i = 0; i < len; i++)
+		printf(" %02x", b[i]);
+	printf("\n");
+}
+
+/* fixed vectors, the layout of lora_relay_protocol.h byte by byte */
+static void test_vectors(void)
+{
+	static const uint8_t up_ref[] = {
+		0xE3,                           /* LORAWAN_TYPE, UPLINK_TYPE, hop 3 */
+		0x12, 0x3A,                     /* uplink_id 0x123, data_rate 10 */
+		0xA6,                           /* rssi -90 */
+		0xF6,                           /* snr -10 */
+		0x05,                           /* channel */
+		0x40, 0x41
+	};
+	static const uint8_t dw_ref[] = {
+		0xEA,                           /* LORAWAN_TYPE, DOWNLINK_TYPE, hop 2 */
+		0xAB, 0xCC,                     /* dwlink_id 0xABC, data_rate 12 */
+		0x33, 0xD3, 0xE6, 0x08,         /* frequency 869525000, big endian */
+		0x31,                           /* tx_power 3, delay 1 */
+		0x12, 0x34, 0x56, 0x78,         /* count_us 0x12345678, big endian */
+		0x01, 0x02
+	};
+	static const uint8_t ev_ref[] = {
+		0xF9,                           /* LORAWAN_TYPE, EVENT_TYPE, hop 1 */
+		0xBE, 0xEF,                     /* event_id */
+		0x03,                           /* EVENT_ERROR */
+		0x7F
+	};
+	uplink_packet_t up, up2;
+	downlink_packet_t dw, dw2;
+	event_packet_t ev, ev2;
+	uint8_t buf[32];
+	int len;
+
+	init_uplink_packet(&up);
+	up.hop_count = 3;
+	up.uplink_id = 0x123;
+	up.data_rate = 10;
+	up.rssi = -90;
+	up.snr = -10;
+	up.channel = 5;
+	up.payload_len = 2;
+	up.phy_payload[0] = 0x40;
+	up.phy_payload[1] = 0x41;
+	len = encode_uplink_packet(&up, buf, sizeof(buf));
+	CHECK(len == sizeof(up_ref) && memcmp(buf, up_ref, len) == 0, "uplink vector");
+	if (len > 0 && memcmp(buf, up_ref, len) != 0)
+		dump("got", buf, len);
+	CHECK(unpack_uplink_packet(up_ref, sizeof(up_ref), &up2) && up2.uplink_id == 0x123 &&
+	      up2.data_rate == 10 && up2.rssi == -90 && up2.snr == -10 && up2.channel == 5 &&
+	      up2.hop_count == 3 && up2.payload_len == 2 && up2.phy_payload[1] == 0x41, "uplink vector unpack");
+
+	init_downlink_packet(&dw);
+	dw.hop_count = 2;
+	dw.dwlink_id = 0xABC;
+	dw.data_rate = 12;
+	dw.frequency = 869525000;
+	dw.tx_power = 3;
+	dw.delay = 1;
+	dw.count_us = 0x12345678;
+	dw.payload_len = 2;
+	dw.phy_payload[0] = 0x01;
+	dw.phy_payload[1] = 0x02;
+	len = encode_downlink_packet(&dw, buf, sizeof(buf));
+	CHECK(len == sizeof(dw_ref) && memcmp(buf, dw_ref, len) == 0, "downlink vector");
+	if (len > 0 && memcmp(buf, dw_ref, len) != 0)
+		dump("got", buf, len);
+	CHECK(unpack_downlink_packet(dw_ref, sizeof(dw_ref), &dw2) && dw2.dwlink_id == 0xABC &&
+	      dw2.data_rate == 12 && dw2.frequency == 869525000 && dw2.tx_power == 3 && dw2.delay == 1 &&
+	      dw2.count_us == 0x12345678 && dw2.hop_count == 2 && dw2.payload_len == 2, "downlink vector unpack");
+
+	memset(&ev, 0, sizeof(ev));
+	ev.meta_type = LORAWAN_TYPE;
+	ev.payload_type = EVENT_TYPE;
+	ev.hop_count = 1;
+	ev.event_id = 0xBEEF;
+	ev.event_type = EVENT_ERROR;
+	ev.payload_len = 1;
+	ev.event_payload[0] = 0x7F;
+	len = encode_event_packet(&ev, buf, sizeof(buf));
+	CHECK(len == sizeof(ev_ref) && memcmp(buf, ev_ref, len) == 0, "event vector");
+	if (len > 0 && memcmp(buf, ev_ref, len) != 0)
+		dump("got", buf, len);
+	CHECK(unpack_event_packet(ev_ref, sizeof(ev_ref), &ev2) && ev2.event_id == 0xBEEF &&
+	      ev2.event_type == EVENT_ERROR && ev2.hop_count == 1 && ev2.payload_len == 1, "event vector unpack");
+
+	/* the packet type is checked both ways */
+	CHECK(!unpack_uplink_packet(dw_ref, sizeof(dw_ref), &up2), "downlink taken as uplink");
+	CHECK(!unpack_downlink_packet(up_ref, sizeof(up_ref), &dw2), "uplink taken as downlink");
+	CHECK(!unpack_event_packet(up_ref, sizeof(up_ref), &ev2), "uplink taken as event");
+}
+
+/* random packets of every size: encode, unpack, compare, encode again */
+static void test_round_trip(int rounds)
+{
+	uplink_packet_t up, up2;
+	downlink_packet_t dw, dw2;
+	event_packet_t ev, ev2;
+	uint8_t buf[RELAY_DW_HDR_LEN + MAX_PHY_PAYLOAD_LEN], buf2[sizeof(buf)], *heap;
+	uint16_t heap_len;
+	int i, j, len, len2;
+
+	for (i = 0; i < rounds && nb_fail < 10; i++) {
+		init_uplink_packet(&up);
+		up.hop_count = rand() & 0x07;
+		up.uplink_id = rand() & 0x0FFF;
+		up.data_rate = rand() & 0x0F;
+		up.rssi = (int8_t)rand();
+		up.snr = (rand() & 0x3F) - 32;
+		up.channel = rand();
+		up.payload_len = rand() % (MAX_PHY_PAYLOAD_LEN + 1);
+		for (j = 0; j < up.payload_len; j++)
+			up.phy_payload[j] = rand();
+
+		len = encode_uplink_packet(&up, buf, RELAY_UP_HDR_LEN + up.payload_len);
+		CHECK(len == RELAY_UP_HDR_LEN + up.payload_len, "uplink length %d", len);
+		CHECK(encode_uplink_packet(&up, buf2, RELAY_UP_HDR_LEN + up.payload_len - 1) == -1, "uplink short buffer");
+		CHECK(unpack_uplink_packet(buf, len, &up2), "uplink unpack");
+		CHECK(up2.hop_count == up.hop_count && up2.uplink_id == up.uplink_id && up2.data_rate == up.data_rate &&
+		      up2.rssi == up.rssi && up2.snr == up.snr && up2.channel == up.channel &&
+		      up2.payload_len == up.payload_len && memcmp(up2.phy_payload, up.phy_payload, up.payload_len) == 0,
+		      "uplink fields");
+		len2 = encode_uplink_packet(&up2, buf2, sizeof(buf2));
+		CHECK(len2 == len && memcmp(buf, buf2, len) == 0, "uplink re-encode");
+		heap = pack_uplink_packet(&up, &heap_len);
+		CHECK(heap != NULL && heap_len == len && memcmp(heap, buf, len) == 0, "pack_uplink_packet");
+		free(heap);
+
+		init_downlink_packet(&dw);
+		dw.hop_count = rand() & 0x07;
+		dw.dwlink_id = rand() & 0x0FFF;
+		dw.data_rate = rand() & 0x0F;
+		dw.frequency = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+		dw.tx_power = rand() & 0x0F;
+		dw.delay = rand() & 0x0F;
+		dw.count_us = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+		dw.payload_len = rand() % (MAX_PHY_PAYLOAD_LEN + 1);
+		for (j = 0; j < dw.payload_len; j++)
+			dw.phy_payload[j] = rand();
+
+		len = encode_downlink_packet(&dw, buf, RELAY_DW_HDR_LEN + dw.payload_len);
+		CHECK(len == RELAY_DW_HDR_LEN + dw.payload_len, "downlink length %d", len);
+		CHECK(encode_downlink_packet(&dw, buf2, RELAY_DW_HDR_LEN + dw.payload_len - 1) == -1, "downlink short buffer");
+		CHECK(buf[3] == dw.frequency >> 24 && buf[6] == (dw.frequency & 0xFF) &&
+		      buf[8] == dw.count_us >> 24 && buf[11] == (dw.count_us & 0xFF), "downlink byte order");
+		CHECK(unpack_downlink_packet(buf, len, &dw2), "downlink unpack");
+		CHECK(dw2.hop_count == dw.hop_count && dw2.dwlink_id == dw.dwlink_id && dw2.data_rate == dw.data_rate &&
+		      dw2.frequency == dw.frequency && dw2.tx_power == dw.tx_power && dw2.delay == dw.delay &&
+		      dw2.count_us == dw.count_us && dw2.payload_len == dw.payload_len &&
+		      memcmp(dw2.phy_payload, dw.phy_payload, dw.payload_len) == 0, "downlink fields");
+		len2 = encode_downlink_packet(&dw2, buf2, sizeof(buf2));
+		CHECK(len2 == len && memcmp(buf, buf2, len) == 0, "downlink re-encode");
+		heap = pack_downlink_packet(&dw, &heap_len);
+		CHECK(heap != NULL && heap_len == len && memcmp(heap, buf, len) == 0, "pack_downlink_packet");
+		free(heap);
+
+		memset(&ev, 0, sizeof(ev));
+		ev.meta_type = LORAWAN_TYPE;
+		ev.payload_type = EVENT_TYPE;
+		ev.hop_count = rand() & 0x07;
+		ev.event_id = rand();
+		ev.event_type = (event_type_t)(1 + rand() % 4);
+		ev.payload_len = rand() % (MAX_EVENT_PAYLOAD_LEN + 1);
+		for (j = 0; j < ev.payload_len; j++)
+			ev.event_payload[j] = rand();
+
+		len = encode_event_packet(&ev, buf, RELAY_EV_HDR_LEN + ev.payload_len);
+		CHECK(len == RELAY_EV_HDR_LEN + ev.payload_len, "event length %d", len);
+		CHECK(encode_event_packet(&ev, buf2, RELAY_EV_HDR_LEN + ev.payload_len - 1) == -1, "event short buffer");
+		CHECK(unpack_event_packet(buf, len, &ev2), "event unpack");
+		CHECK(ev2.hop_count == ev.hop_count && ev2.event_id == ev.event_id && ev2.event_type == ev.event_type &&
+		      ev2.payload_len == ev.payload_len && memcmp(ev2.event_payload, ev.event_payload, ev.payload_len) == 0,
+		      "event fields");
+		heap = pack_event_packet(&ev, &heap_len);
+		CHECK(heap != NULL && heap_len == len && memcmp(heap, buf, len) == 0, "pack_event_packet");
+		free(heap);
+	}
+
+	/* payloads over the limit are refused */
+	init_uplink_packet(&up);
+	up.payload_len = MAX_PHY_PAYLOAD_LEN + 1;
+	CHECK(encode_uplink_packet(&up, buf, sizeof(buf)) == -1, "uplink payload over limit");
+	init_downlink_packet(&dw);
+	dw.payload_len = MAX_PHY_PAYLOAD_LEN + 1;
+	CHECK(encode_downlink_packet(&dw, buf, sizeof(buf)) == -1, "downlink payload over limit");
+}
+
+/* random bytes: refused, or a packet that encodes back to the same bytes */
+static void test_fuzz(int rounds)
+{
+	uplink_packet_t up;
+	downlink_packet_t dw;
+	event_packet_t ev;
+	uint8_t *in, out[FUZZ_LEN_MAX];
+	int i, j, len, n, nb_ok = 0;
+
+	for (i = 0; i < rounds && nb_fail < 10; i++) {
+		len = rand() % (FUZZ_LEN_MAX + 1);
+		/* exact size allocation, ASan catches any read past the input */
+		in = malloc(len > 0 ? len : 1);
+		if (in == NULL)
+			return;
+		for (j = 0; j < len; j++)
+			in[j] = rand();
+		/* most inputs should get past the MHDR check */
+		if (len > 0 && (rand() & 1))
+			in[0] = build_mhdr(LORAWAN_TYPE, (payload_type_t)(rand() & 0x03), rand() & 0x07);
+
+		if (unpack_uplink_packet(in, len, &up)) {
+			n = encode_uplink_packet(&up, out, sizeof(out));
+			CHECK(n == len && memcmp(in, out, len) == 0, "uplink of %d random bytes", len);
+			nb_ok++;
+		}
+		if (unpack_downlink_packet(in, len, &dw)) {
+			n = encode_downlink_packet(&dw, out, sizeof(out));
+			CHECK(n == len && memcmp(in, out, len) == 0, "downlink of %d random bytes", len);
+			nb_ok++;
+		}
+		if (unpack_event_packet(in, len, &ev)) {
+			n = encode_event_packet(&ev, out, sizeof(out));
+			CHECK(n == len && memcmp(in, out, len) == 0, "event of %d random bytes", len);
+			nb_ok++;
+		}
+		free(in);
+	}
+
+	printf("     %d of %d random inputs unpacked\n", nb_ok, rounds);
+}
+
+int main(int argc, char **argv)
+{
+	int opt, rounds = ROUNDS_DEFAULT;
+	unsigned int seed = 1;
+
+	while ((opt = getopt(argc, argv, "hn:s:")) != -1) {
+		switch (opt) {
+		case 'h':
+			usage();
+			return EXIT_SUCCESS;
+		case 'n':
+			rounds = atoi(optarg);
+			break;
+		case 's':
+			seed = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+	srand(seed);
+
+	test_vectors();
+	printf("%s fixed vectors\n", nb_fail ? "FAIL" : "PASS");
+
+	test_round_trip(rounds);
+	printf("%s %d random round trips\n", nb_fail ? "FAIL" : "PASS", rounds);
+
+	test_fuzz(rounds);
+	printf("%s %d random inputs to unpack\n", nb_fail ? "FAIL" : "PASS", rounds);
+
+	if (nb_fail > 0) {
+		printf("%d check(s) failed\n", nb_fail);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -513,6 +513,30 @@ the protocol.
 */
 int lgw_send(struct lgw_pkt_tx_s * pkt_data);
 
+/**
+@brief First phase of lgw_send: check the packet and program everything but the trigger
+@param pkt_data structure containing the data and metadata for the packet to send
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+
+LBT is started when enabled, then modem, RF and power settings are written and
+the payload is uploaded to the TX buffer of the RF chain, so it may be done well
+ahead of the TX time. The RF chain must not be emitting: the TX buffer is shared
+with the ongoing TX. A new prepare on the same RF chain replaces the previous
+one.
+*/
+int lgw_tx_prepare(struct lgw_pkt_tx_s * pkt_data);
+
+/**
+@brief Second phase of lgw_send: trigger the TX prepared on rf_chain
+@param rf_chain RF chain given to lgw_tx_prepare
+@return LGW_HAL_ERROR id the operation failed or nothing is prepared,
+LGW_LBT_NOT_ALLOWED if LBT denied the TX, LGW_HAL_SUCCESS else
+
+Only the trigger registers are written, then the LBT verdict is read and LBT
+stopped when enabled. A prepared TX is armed once, lgw_abort_tx drops it.
+*/
+int lgw_tx_arm(uint8_t rf_chain);
+
 /**
 @brief Give the the status of different part of the LoRa concentrator
 @param select is used to select what status we want to know
@@ -437,6 +437,22 @@ int sx1302_tx_configure(lgw_radio_type_t radio_type);
 */
 int sx1302_send(lgw_radio_type_t radio_type, struct lgw_tx_gain_lut_s * tx_lut, bool lwan_public, struct lgw_conf_rxif_s * context_fsk, struct lgw_pkt_tx_s * pkt_data);
 
+/**
+@brief Program everything of a TX but its trigger: modem, RF and power settings, payload upload
+@param tx_start_delay TX start delay applied, to be given to sx1302_tx_arm
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
+*/
+int sx1302_tx_prepare(lgw_radio_type_t radio_type, struct lgw_tx_gain_lut_s * tx_lut, bool lwan_public, struct lgw_conf_rxif_s * context_fsk, struct lgw_pkt_tx_s * pkt_data, uint16_t * tx_start_delay);
+
+/**
+@brief Trigger a TX prepared by sx1302_tx_prepare on rf_chain
+@param tx_mode        IMMEDIATE, TIMESTAMPED or ON_GPS
+@param count_us       counter value to start TX on, TIMESTAMPED only
+@param tx_start_delay as given by sx1302_tx_prepare
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
+*/
+int sx1302_tx_arm(uint8_t rf_chain, uint8_t tx_mode, uint32_t count_us, uint16_t tx_start_delay);
+
 /**
 @brief TODO
 @param TODO
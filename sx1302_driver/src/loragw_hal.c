@@ -214,6 +214,13 @@ static uint8_t ts_addr = 0xFF;
 /* I2C AD5338 handles */
 static int     ad_fd = -1;
 
+/* TX prepared by lgw_tx_prepare, waiting for lgw_tx_arm */
+static struct {
+    bool prepared;
+    uint16_t start_delay;
+    struct lgw_pkt_tx_s pkt;
+} tx_staged[LGW_RF_CHAIN_NB];
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
 
@@ -1344,9 +1351,8 @@ int lgw_receive(uint8_t max_pkt, struct lgw_pkt_rx_s *pkt_data) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int lgw_send(struct lgw_pkt_tx_s * pkt_data) {
+int lgw_tx_prepare(struct lgw_pkt_tx_s * pkt_data) {
     int err;
-    bool lbt_tx_allowed;
     /* performances variables */
     struct timeval tm;
 
@@ -1430,7 +1436,16 @@ int lgw_send(struct lgw_pkt_tx_s * pkt_data) {
         printf("INFO: AD5338R: Set DAC output to 0x%02X 0x%02X\n", (uint8_t)VOLTAGE2HEX_H(2.51), (uint8_t)VOLTAGE2HEX_L(2.51));
     }
 
-    /* Start Listen-Before-Talk */
+    /* Stop Listen-Before-Talk of the TX this one replaces */
+    if (tx_staged[pkt_data->rf_chain].prepared == true && CONTEXT_SX1261.lbt_conf.enable == true) {
+        err = lgw_lbt_stop();
+        if (err != 0) {
+            printf("ERROR: %s: Failed to stop LBT\n", __FUNCTION__);
+        }
+    }
+    tx_staged[pkt_data->rf_chain].prepared = false;
+
+    /* Start Listen-Before-Talk, before the TX is programmed as lgw_send always did */
     if (CONTEXT_SX1261.lbt_conf.enable == true) {
         err = lgw_lbt_start(&CONTEXT_SX1261, pkt_data);
         if (err != 0) {
@@ -1439,8 +1454,66 @@ int lgw_send(struct lgw_pkt_tx_s * pkt_data) {
         }
     }
 
-    /* Send the TX request to the concentrator */
-    err = sx1302_send(CONTEXT_RF_CHAIN[pkt_data->rf_chain].type, &CONTEXT_TX_GAIN_LUT[pkt_data->rf_chain], CONTEXT_LWAN_PUBLIC, &CONTEXT_FSK, pkt_data);
+    /* Program the TX, only the trigger is left */
+    err = sx1302_tx_prepare(CONTEXT_RF_CHAIN[pkt_data->rf_chain].type, &CONTEXT_TX_GAIN_LUT[pkt_data->rf_chain], CONTEXT_LWAN_PUBLIC, &CONTEXT_FSK, pkt_data, &tx_staged[pkt_data->rf_chain].start_delay);
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: %s: Failed to prepare packet\n", __FUNCTION__);
+
+        if (CONTEXT_SX1261.lbt_conf.enable == true) {
+            err = lgw_lbt_stop();
+            if (err != 0) {
+                printf("ERROR: %s: Failed to stop LBT\n", __FUNCTION__);
+            }
+        }
+
+        return LGW_HAL_ERROR;
+    }
+    tx_staged[pkt_data->rf_chain].pkt = *pkt_data;
+    tx_staged[pkt_data->rf_chain].prepared = true;
+
+    _meas_time_stop(1, tm, __FUNCTION__);
+
+    DEBUG_PRINTF(" --- %s\n", "OUT");
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_tx_arm(uint8_t rf_chain) {
+    int err;
+    bool lbt_tx_allowed;
+    struct lgw_pkt_tx_s * pkt_data;
+    /* performances variables */
+    struct timeval tm;
+
+    DEBUG_PRINTF(" --- %s\n", "IN");
+
+    /* Record function start time */
+    _meas_time_start(&tm);
+
+    /* check if the concentrator is running */
+    if (CONTEXT_STARTED == false) {
+        printf("ERROR: CONCENTRATOR IS NOT RUNNING, START IT BEFORE SENDING\n");
+        return LGW_HAL_ERROR;
+    }
+
+    /* check input range (segfault prevention) */
+    if (rf_chain >= LGW_RF_CHAIN_NB) {
+        printf("ERROR: INVALID RF_CHAIN TO SEND PACKETS\n");
+        return LGW_HAL_ERROR;
+    }
+
+    /* a prepared TX is armed once */
+    if (tx_staged[rf_chain].prepared == false) {
+        printf("ERROR: NO PACKET PREPARED ON RF_CHAIN %u\n", rf_chain);
+        return LGW_HAL_ERROR;
+    }
+    tx_staged[rf_chain].prepared = false;
+    pkt_data = &tx_staged[rf_chain].pkt;
+
+    /* Trigger the TX, LBT was started by lgw_tx_prepare */
+    err = sx1302_tx_arm(rf_chain, pkt_data->tx_mode, pkt_data->count_us, tx_staged[rf_chain].start_delay);
     if (err != LGW_REG_SUCCESS) {
         printf("ERROR: %s: Failed to send packet\n", __FUNCTION__);
 
@@ -1495,6 +1568,19 @@ int lgw_send(struct lgw_pkt_tx_s * pkt_data) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int lgw_send(struct lgw_pkt_tx_s * pkt_data) {
+    int err;
+
+    err = lgw_tx_prepare(pkt_data);
+    if (err != LGW_HAL_SUCCESS) {
+        return err;
+    }
+
+    return lgw_tx_arm(pkt_data->rf_chain);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int lgw_status(uint8_t rf_chain, uint8_t select, uint8_t *code) {
     //DEBUG_PRINTF(" --- %s\n", "IN");
 
@@ -1542,7 +1628,13 @@ int lgw_abort_tx(uint8_t rf_chain) {
         return LGW_HAL_ERROR;
     }
 
-    /* Abort current TX */
+    /* Abort current TX, and forget a prepared one with its LBT */
+    if (tx_staged[rf_chain].prepared == true && CONTEXT_SX1261.lbt_conf.enable == true) {
+        if (lgw_lbt_stop() != 0) {
+            DEBUG_MSG("ERROR: FAILED TO STOP LBT\n");
+        }
+    }
+    tx_staged[rf_chain].prepared = false;
     err = sx1302_tx_abort(rf_chain);
 
     DEBUG_PRINTF(" --- %s\n", "OUT");
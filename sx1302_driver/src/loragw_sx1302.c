@@ -2395,19 +2395,17 @@ int sx1302_tx_configure(lgw_radio_type_t radio_type) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int sx1302_send(lgw_radio_type_t radio_type, struct lgw_tx_gain_lut_s * tx_lut, bool lwan_public, struct lgw_conf_rxif_s * context_fsk, struct lgw_pkt_tx_s * pkt_data) {
+int sx1302_tx_prepare(lgw_radio_type_t radio_type, struct lgw_tx_gain_lut_s * tx_lut, bool lwan_public, struct lgw_conf_rxif_s * context_fsk, struct lgw_pkt_tx_s * pkt_data, uint16_t * tx_start_delay) {
     int err;
     uint32_t freq_reg, fdev_reg;
     uint32_t freq_dev;
     uint32_t fsk_br_reg;
     uint64_t fsk_sync_word_reg;
     uint16_t mem_addr;
-    uint32_t count_us;
     uint8_t power;
     uint8_t pow_index;
     uint8_t mod_bw;
     uint8_t pa_en;
-    uint16_t tx_start_delay;
     uint8_t chirp_lowpass = 0;
     uint8_t buff[2]; /* for 16-bits register write operation */
     /* performances variables */
@@ -2419,6 +2417,7 @@ int sx1302_send(lgw_radio_type_t radio_type, struct lgw_tx_gain_lut_s * tx_lut,
     /* Check input parameters */
     CHECK_NULL(tx_lut);
     CHECK_NULL(pkt_data);
+    CHECK_NULL(tx_start_delay);
 
     /* Setting BULK write mode (to speed up configuration on USB) */
     err = lgw_com_set_write_mode(LGW_COM_WRITE_MODE_BULK);
@@ -2726,7 +2725,7 @@ int sx1302_send(lgw_radio_type_t radio_type, struct lgw_tx_gain_lut_s * tx_lut,
     }
 
     /* Set TX start delay */
-    err = sx1302_tx_set_start_delay(pkt_data->rf_chain, radio_type, pkt_data->modulation, pkt_data->bandwidth, chirp_lowpass, &tx_start_delay);
+    err = sx1302_tx_set_start_delay(pkt_data->rf_chain, radio_type, pkt_data->modulation, pkt_data->bandwidth, chirp_lowpass, tx_start_delay);
     CHECK_ERR(err);
 
     /* Write payload in transmit buffer */
@@ -2745,37 +2744,66 @@ int sx1302_send(lgw_radio_type_t radio_type, struct lgw_tx_gain_lut_s * tx_lut,
     err = lgw_reg_w(SX1302_REG_TX_TOP_TX_CTRL_WRITE_BUFFER(pkt_data->rf_chain), 0x00);
     CHECK_ERR(err);
 
+    /* Flush write (USB BULK mode) */
+    err = lgw_com_flush();
+    CHECK_ERR(err);
+
+    /* Setting back to SINGLE BULK write mode */
+    err = lgw_com_set_write_mode(LGW_COM_WRITE_MODE_SINGLE);
+    CHECK_ERR(err);
+
+    /* Compute time spent in this function */
+    _meas_time_stop(2, tm, __FUNCTION__);
+
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int sx1302_tx_arm(uint8_t rf_chain, uint8_t tx_mode, uint32_t count_us, uint16_t tx_start_delay) {
+    int err;
+    uint32_t trig_count;
+    /* performances variables */
+    struct timeval tm;
+
+    /* Record function start time */
+    _meas_time_start(&tm);
+
+    /* Setting BULK write mode (to speed up configuration on USB) */
+    err = lgw_com_set_write_mode(LGW_COM_WRITE_MODE_BULK);
+    CHECK_ERR(err);
+
     /* Trigger transmit */
-    DEBUG_PRINTF("Start Tx: Freq:%u %s%u size:%u preamb:%u\n", pkt_data->freq_hz, (pkt_data->modulation == MOD_LORA) ? "SF" : "DR:", pkt_data->datarate, pkt_data->size, pkt_data->preamble);
-    switch (pkt_data->tx_mode) {
+    DEBUG_PRINTF("Start Tx: rf_chain:%u mode:%u count_us:%u\n", rf_chain, tx_mode, count_us);
+    switch (tx_mode) {
         case IMMEDIATE:
-            err = lgw_reg_w(SX1302_REG_TX_TOP_TX_TRIG_TX_TRIG_IMMEDIATE(pkt_data->rf_chain), 0x00); /* reset state machine */
+            err = lgw_reg_w(SX1302_REG_TX_TOP_TX_TRIG_TX_TRIG_IMMEDIATE(rf_chain), 0x00); /* reset state machine */
             CHECK_ERR(err);
-            err = lgw_reg_w(SX1302_REG_TX_TOP_TX_TRIG_TX_TRIG_IMMEDIATE(pkt_data->rf_chain), 0x01);
+            err = lgw_reg_w(SX1302_REG_TX_TOP_TX_TRIG_TX_TRIG_IMMEDIATE(rf_chain), 0x01);
             CHECK_ERR(err);
             break;
         case TIMESTAMPED:
-            count_us = pkt_data->count_us * 32 - tx_start_delay;
-            DEBUG_PRINTF("--> programming trig delay at %u (%u)\n", pkt_data->count_us - (tx_start_delay / 32), count_us);
+            trig_count = count_us * 32 - tx_start_delay;
+            DEBUG_PRINTF("--> programming trig delay at %u (%u)\n", count_us - (tx_start_delay / 32), trig_count);
 
-            err = lgw_reg_w(SX1302_REG_TX_TOP_TIMER_TRIG_BYTE0_TIMER_DELAYED_TRIG(pkt_data->rf_chain), (uint8_t)((count_us >>  0) & 0x000000FF));
+            err = lgw_reg_w(SX1302_REG_TX_TOP_TIMER_TRIG_BYTE0_TIMER_DELAYED_TRIG(rf_chain), (uint8_t)((trig_count >>  0) & 0x000000FF));
             CHECK_ERR(err);
-            err = lgw_reg_w(SX1302_REG_TX_TOP_TIMER_TRIG_BYTE1_TIMER_DELAYED_TRIG(pkt_data->rf_chain), (uint8_t)((count_us >>  8) & 0x000000FF));
+            err = lgw_reg_w(SX1302_REG_TX_TOP_TIMER_TRIG_BYTE1_TIMER_DELAYED_TRIG(rf_chain), (uint8_t)((trig_count >>  8) & 0x000000FF));
             CHECK_ERR(err);
-            err = lgw_reg_w(SX1302_REG_TX_TOP_TIMER_TRIG_BYTE2_TIMER_DELAYED_TRIG(pkt_data->rf_chain), (uint8_t)((count_us >> 16) & 0x000000FF));
+            err = lgw_reg_w(SX1302_REG_TX_TOP_TIMER_TRIG_BYTE2_TIMER_DELAYED_TRIG(rf_chain), (uint8_t)((trig_count >> 16) & 0x000000FF));
             CHECK_ERR(err);
-            err = lgw_reg_w(SX1302_REG_TX_TOP_TIMER_TRIG_BYTE3_TIMER_DELAYED_TRIG(pkt_data->rf_chain), (uint8_t)((count_us >> 24) & 0x000000FF));
+            err = lgw_reg_w(SX1302_REG_TX_TOP_TIMER_TRIG_BYTE3_TIMER_DELAYED_TRIG(rf_chain), (uint8_t)((trig_count >> 24) & 0x000000FF));
             CHECK_ERR(err);
 
-            err = lgw_reg_w(SX1302_REG_TX_TOP_TX_TRIG_TX_TRIG_DELAYED(pkt_data->rf_chain), 0x00); /* reset state machine */
+            err = lgw_reg_w(SX1302_REG_TX_TOP_TX_TRIG_TX_TRIG_DELAYED(rf_chain), 0x00); /* reset state machine */
             CHECK_ERR(err);
-            err = lgw_reg_w(SX1302_REG_TX_TOP_TX_TRIG_TX_TRIG_DELAYED(pkt_data->rf_chain), 0x01);
+            err = lgw_reg_w(SX1302_REG_TX_TOP_TX_TRIG_TX_TRIG_DELAYED(rf_chain), 0x01);
             CHECK_ERR(err);
             break;
         case ON_GPS:
-            err = lgw_reg_w(SX1302_REG_TX_TOP_TX_TRIG_TX_TRIG_GPS(pkt_data->rf_chain), 0x00); /* reset state machine */
+            err = lgw_reg_w(SX1302_REG_TX_TOP_TX_TRIG_TX_TRIG_GPS(rf_chain), 0x00); /* reset state machine */
             CHECK_ERR(err);
-            err = lgw_reg_w(SX1302_REG_TX_TOP_TX_TRIG_TX_TRIG_GPS(pkt_data->rf_chain), 0x01);
+            err = lgw_reg_w(SX1302_REG_TX_TOP_TX_TRIG_TX_TRIG_GPS(rf_chain), 0x01);
             CHECK_ERR(err);
             break;
         default:
@@ -2799,6 +2827,18 @@ int sx1302_send(lgw_radio_type_t radio_type, struct lgw_tx_gain_lut_s * tx_lut,
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int sx1302_send(lgw_radio_type_t radio_type, struct lgw_tx_gain_lut_s * tx_lut, bool lwan_public, struct lgw_conf_rxif_s * context_fsk, struct lgw_pkt_tx_s * pkt_data) {
+    int err;
+    uint16_t tx_start_delay;
+
+    err = sx1302_tx_prepare(radio_type, tx_lut, lwan_public, context_fsk, pkt_data, &tx_start_delay);
+    CHECK_ERR(err);
+
+    return sx1302_tx_arm(pkt_data->rf_chain, pkt_data->tx_mode, pkt_data->count_us, tx_start_delay);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int sx1302_set_gpio(uint8_t gpio_reg_val) {
     int err;
 
@@ -57,6 +57,17 @@
 #  define USE_TABLES
 #endif
 
+/* define to encrypt with 32-bit T-tables instead of byte operations */
+#if !defined( AES_NO_TTABLES )
+#  define USE_TTABLES
+#endif
+
+/* define to encrypt with AES-NI (x86) or the ARMv8 crypto extensions
+   (aarch64) when the cpu has them, checked once at the first block */
+#if !defined( AES_NO_HW )
+#  define USE_AES_HW
+#endif
+
 /*  On Intel Core 2 duo VERSION_1 is faster */
 
 /* alternative versions (test for performance on your system) */
@@ -70,6 +81,23 @@
   typedef unsigned uint_32t;  // Edited by Semtech - David Roe 1 Dec 13
 #endif
 
+#if defined( USE_TTABLES ) && defined( HAVE_UINT_32T )
+#  define ENC_TTABLES
+#endif
+
+#if defined( USE_AES_HW ) && defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#  define AES_HW_X86
+#  include <cpuid.h>
+#  include <wmmintrin.h>
+#elif defined( USE_AES_HW ) && defined( __GNUC__ ) && defined( __aarch64__ ) && defined( __linux__ )
+#  define AES_HW_ARM
+#  include <sys/auxv.h>
+#  include <arm_neon.h>
+#  ifndef HWCAP_AES
+#    define HWCAP_AES   (1 << 3)
+#  endif
+#endif
+
 /* functions for finite field multiplication in the AES Galois field    */
 
 #define WPOLY   0x011b
@@ -196,8 +224,10 @@
 static const uint_8t sbox[256]  =  sb_data(f1);
 static const uint_8t isbox[256] = isb_data(f1);
 
+#if !defined( ENC_TTABLES ) || defined( AES_ENC_128_OTFK ) || defined( AES_ENC_256_OTFK )
 static const uint_8t gfm2_sbox[256] = sb_data(f2);
 static const uint_8t gfm3_sbox[256] = sb_data(f3);
+#endif
 
 static const uint_8t gfmul_9[256] = mm_data(f9);
 static const uint_8t gfmul_b[256] = mm_data(fb);
@@ -403,6 +433,8 @@ static void add_round_key( uint_8t d[N_BLOCK], const uint_8t k[N_BLOCK] )
 	xor_block(d, k);
 }
 
+#if !defined( ENC_TTABLES ) || defined( AES_ENC_128_OTFK ) || defined( AES_ENC_256_OTFK )
+
 static void shift_sub_rows( uint_8t st[N_BLOCK] )
 {   uint_8t tt;
 
@@ -419,6 +451,8 @@ static void shift_sub_rows( uint_8t st[N_BLOCK] )
 	st[ 7] = s_box(st[ 3]); st[ 3] = s_box( tt );
 }
 
+#endif
+
 static void inv_shift_sub_rows( uint_8t st[N_BLOCK] )
 {   uint_8t tt;
 
@@ -435,6 +469,8 @@ static void inv_shift_sub_rows( uint_8t st[N_BLOCK] )
 	st[11] = is_box(st[15]); st[15] = is_box( tt );
 }
 
+#if !defined( ENC_TTABLES ) || defined( AES_ENC_128_OTFK ) || defined( AES_ENC_256_OTFK )
+
 #if defined( VERSION_1 )
   static void mix_sub_columns( uint_8t dt[N_BLOCK] )
   { uint_8t st[N_BLOCK];
@@ -464,6 +500,8 @@ static void inv_shift_sub_rows( uint_8t st[N_BLOCK] )
 	dt[15] = gfm3_sb(st[12]) ^ s_box(st[1]) ^ s_box(st[6]) ^ gfm2_sb(st[11]);
   }
 
+#endif
+
 #if defined( VERSION_1 )
   static void inv_mix_sub_columns( uint_8t dt[N_BLOCK] )
   { uint_8t st[N_BLOCK];
@@ -550,32 +588,301 @@ return_type aes_set_key( const unsigned char key[], length_type keylen, aes_cont
 
 #if defined( AES_ENC_PREKEYED )
 
-/*  Encrypt a single block of 16 bytes */
+typedef void (*enc_block_f)( const uint_8t in[N_BLOCK], uint_8t out[N_BLOCK], const aes_context ctx[1] );
 
-return_type aes_encrypt( const unsigned char in[N_BLOCK], unsigned char  out[N_BLOCK], const aes_context ctx[1] )
+#if !defined( ENC_TTABLES )
+
+/*  Encrypt a single block of 16 bytes with byte operations */
+
+static void enc_block_bytes( const uint_8t in[N_BLOCK], uint_8t out[N_BLOCK], const aes_context ctx[1] )
 {
-	if( ctx->rnd )
+	uint_8t s1[N_BLOCK], r;
+	copy_and_key( s1, in, ctx->ksch );
+
+	for( r = 1 ; r < ctx->rnd ; ++r )
+#if defined( VERSION_1 )
 	{
-		uint_8t s1[N_BLOCK], r;
-		copy_and_key( s1, in, ctx->ksch );
+		mix_sub_columns( s1 );
+		add_round_key( s1, ctx->ksch + r * N_BLOCK);
+	}
+#else
+	{   uint_8t s2[N_BLOCK];
+		mix_sub_columns( s2, s1 );
+		copy_and_key( s1, s2, ctx->ksch + r * N_BLOCK);
+	}
+#endif
+	shift_sub_rows( s1 );
+	copy_and_key( out, s1, ctx->ksch + r * N_BLOCK );
+}
+
+#  define ENC_BLOCK_SW  enc_block_bytes
+#  define ENC_NAME_SW   "bytes"
+
+#else
+
+/*  One column of mix columns over the s box, a state column is a little
+	endian word of its 4 bytes (row 0 in the low byte), whatever the host */
+
+#define te0(x)  ((uint_32t)f2(x) | ((uint_32t)(x) << 8) | ((uint_32t)(x) << 16) | ((uint_32t)f3(x) << 24))
+#define te1(x)  ((uint_32t)f3(x) | ((uint_32t)f2(x) << 8) | ((uint_32t)(x) << 16) | ((uint_32t)(x) << 24))
+#define te2(x)  ((uint_32t)(x) | ((uint_32t)f3(x) << 8) | ((uint_32t)f2(x) << 16) | ((uint_32t)(x) << 24))
+#define te3(x)  ((uint_32t)(x) | ((uint_32t)(x) << 8) | ((uint_32t)f3(x) << 16) | ((uint_32t)f2(x) << 24))
+
+static const uint_32t t_enc0[256] = sb_data(te0);
+static const uint_32t t_enc1[256] = sb_data(te1);
+static const uint_32t t_enc2[256] = sb_data(te2);
+static const uint_32t t_enc3[256] = sb_data(te3);
+
+#define get_col(p)  ((uint_32t)(p)[0] | ((uint_32t)(p)[1] << 8) | ((uint_32t)(p)[2] << 16) | ((uint_32t)(p)[3] << 24))
+
+#define put_col(p, v) do {  \
+	(p)[0] = (uint_8t)(v);  \
+	(p)[1] = (uint_8t)((v) >> 8);  \
+	(p)[2] = (uint_8t)((v) >> 16); \
+	(p)[3] = (uint_8t)((v) >> 24); \
+	} while (0)
+
+#define t_round(c0, c1, c2, c3)  \
+	(t_enc0[(c0) & 0xff] ^ t_enc1[((c1) >> 8) & 0xff] ^ t_enc2[((c2) >> 16) & 0xff] ^ t_enc3[(c3) >> 24])
+
+#define t_last(c0, c1, c2, c3)  \
+	((uint_32t)s_box((c0) & 0xff) | ((uint_32t)s_box(((c1) >> 8) & 0xff) << 8) | \
+	 ((uint_32t)s_box(((c2) >> 16) & 0xff) << 16) | ((uint_32t)s_box((c3) >> 24) << 24))
+
+static void enc_block_ttab( const uint_8t in[N_BLOCK], uint_8t out[N_BLOCK], const aes_context ctx[1] )
+{
+	const uint_8t *k = ctx->ksch;
+	uint_32t s0, s1, s2, s3, t0, t1, t2, t3;
+	uint_8t r;
+
+	s0 = get_col(in     ) ^ get_col(k     );
+	s1 = get_col(in +  4) ^ get_col(k +  4);
+	s2 = get_col(in +  8) ^ get_col(k +  8);
+	s3 = get_col(in + 12) ^ get_col(k + 12);
+
+	for( r = 1 ; r < ctx->rnd ; ++r )
+	{
+		k += N_BLOCK;
+		t0 = t_round(s0, s1, s2, s3) ^ get_col(k     );
+		t1 = t_round(s1, s2, s3, s0) ^ get_col(k +  4);
+		t2 = t_round(s2, s3, s0, s1) ^ get_col(k +  8);
+		t3 = t_round(s3, s0, s1, s2) ^ get_col(k + 12);
+		s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+	}
+
+	k += N_BLOCK;
+	t0 = t_last(s0, s1, s2, s3) ^ get_col(k     );
+	t1 = t_last(s1, s2, s3, s0) ^ get_col(k +  4);
+	t2 = t_last(s2, s3, s0, s1) ^ get_col(k +  8);
+	t3 = t_last(s3, s0, s1, s2) ^ get_col(k + 12);
+	put_col(out     , t0);
+	put_col(out +  4, t1);
+	put_col(out +  8, t2);
+	put_col(out + 12, t3);
+}
+
+#  define ENC_BLOCK_SW  enc_block_ttab
+#  define ENC_NAME_SW   "t-tables"
+
+#endif
+
+typedef void (*enc_blocks_f)( const uint_8t *in, uint_8t *out, int n_block, const aes_context ctx[1] );
+
+static void enc_blocks_sw( const uint_8t *in, uint_8t *out, int n_block, const aes_context ctx[1] )
+{
+	while( n_block-- )
+	{
+		ENC_BLOCK_SW( in, out, ctx );
+		in += N_BLOCK;
+		out += N_BLOCK;
+	}
+}
 
+/*  The key schedule is the FIPS-197 byte layout, the instructions take the
+	round keys as they are */
+
+#if defined( AES_HW_X86 )
+
+__attribute__((target("aes,sse2")))
+static void enc_block_hw( const uint_8t in[N_BLOCK], uint_8t out[N_BLOCK], const aes_context ctx[1] )
+{
+	__m128i s;
+	uint_8t r;
+
+	s = _mm_xor_si128( _mm_loadu_si128( (const __m128i*)in ), _mm_loadu_si128( (const __m128i*)ctx->ksch ) );
+	for( r = 1 ; r < ctx->rnd ; ++r )
+		s = _mm_aesenc_si128( s, _mm_loadu_si128( (const __m128i*)(ctx->ksch + r * N_BLOCK) ) );
+	s = _mm_aesenclast_si128( s, _mm_loadu_si128( (const __m128i*)(ctx->ksch + r * N_BLOCK) ) );
+	_mm_storeu_si128( (__m128i*)out, s );
+}
+
+/*  aesenc has a latency of several cycles but a throughput of one or two
+	per cycle, four independent blocks fill the pipeline */
+
+__attribute__((target("aes,sse2")))
+static void enc_blocks_hw( const uint_8t *in, uint_8t *out, int n_block, const aes_context ctx[1] )
+{
+	__m128i k, s0, s1, s2, s3;
+	uint_8t r;
+
+	for( ; n_block >= 4 ; n_block -= 4, in += 4 * N_BLOCK, out += 4 * N_BLOCK )
+	{
+		k = _mm_loadu_si128( (const __m128i*)ctx->ksch );
+		s0 = _mm_xor_si128( _mm_loadu_si128( (const __m128i*)in ), k );
+		s1 = _mm_xor_si128( _mm_loadu_si128( (const __m128i*)(in + N_BLOCK) ), k );
+		s2 = _mm_xor_si128( _mm_loadu_si128( (const __m128i*)(in + 2 * N_BLOCK) ), k );
+		s3 = _mm_xor_si128( _mm_loadu_si128( (const __m128i*)(in + 3 * N_BLOCK) ), k );
 		for( r = 1 ; r < ctx->rnd ; ++r )
-#if defined( VERSION_1 )
 		{
-			mix_sub_columns( s1 );
-			add_round_key( s1, ctx->ksch + r * N_BLOCK);
+			k = _mm_loadu_si128( (const __m128i*)(ctx->ksch + r * N_BLOCK) );
+			s0 = _mm_aesenc_si128( s0, k );
+			s1 = _mm_aesenc_si128( s1, k );
+			s2 = _mm_aesenc_si128( s2, k );
+			s3 = _mm_aesenc_si128( s3, k );
 		}
+		k = _mm_loadu_si128( (const __m128i*)(ctx->ksch + r * N_BLOCK) );
+		_mm_storeu_si128( (__m128i*)out, _mm_aesenclast_si128( s0, k ) );
+		_mm_storeu_si128( (__m128i*)(out + N_BLOCK), _mm_aesenclast_si128( s1, k ) );
+		_mm_storeu_si128( (__m128i*)(out + 2 * N_BLOCK), _mm_aesenclast_si128( s2, k ) );
+		_mm_storeu_si128( (__m128i*)(out + 3 * N_BLOCK), _mm_aesenclast_si128( s3, k ) );
+	}
+	for( ; n_block > 0 ; n_block--, in += N_BLOCK, out += N_BLOCK )
+		enc_block_hw( in, out, ctx );
+}
+
+static int have_aes_hw( void )
+{
+	unsigned int a, b, c, d;
+
+	if( !__get_cpuid( 1, &a, &b, &c, &d ) )
+		return 0;
+	return ( c & bit_AES ) != 0;
+}
+
+#elif defined( AES_HW_ARM )
+
+#if defined( __clang__ )
+__attribute__((target("crypto")))
 #else
-		{   uint_8t s2[N_BLOCK];
-			mix_sub_columns( s2, s1 );
-			copy_and_key( s1, s2, ctx->ksch + r * N_BLOCK);
-		}
+__attribute__((target("+crypto")))
 #endif
-		shift_sub_rows( s1 );
-		copy_and_key( out, s1, ctx->ksch + r * N_BLOCK );
+static void enc_block_hw( const uint_8t in[N_BLOCK], uint_8t out[N_BLOCK], const aes_context ctx[1] )
+{
+	uint8x16_t s;
+	uint_8t r;
+
+	/*  aese adds the round key before the s box and shift rows */
+	s = vld1q_u8( in );
+	for( r = 0 ; r < ctx->rnd - 1 ; ++r )
+		s = vaesmcq_u8( vaeseq_u8( s, vld1q_u8( ctx->ksch + r * N_BLOCK ) ) );
+	s = vaeseq_u8( s, vld1q_u8( ctx->ksch + r * N_BLOCK ) );
+	s = veorq_u8( s, vld1q_u8( ctx->ksch + ctx->rnd * N_BLOCK ) );
+	vst1q_u8( out, s );
+}
+
+#if defined( __clang__ )
+__attribute__((target("crypto")))
+#else
+__attribute__((target("+crypto")))
+#endif
+static void enc_blocks_hw( const uint_8t *in, uint_8t *out, int n_block, const aes_context ctx[1] )
+{
+	uint8x16_t k, s0, s1, s2, s3;
+	uint_8t r;
+
+	for( ; n_block >= 4 ; n_block -= 4, in += 4 * N_BLOCK, out += 4 * N_BLOCK )
+	{
+		s0 = vld1q_u8( in );
+		s1 = vld1q_u8( in + N_BLOCK );
+		s2 = vld1q_u8( in + 2 * N_BLOCK );
+		s3 = vld1q_u8( in + 3 * N_BLOCK );
+		for( r = 0 ; r < ctx->rnd - 1 ; ++r )
+		{
+			k = vld1q_u8( ctx->ksch + r * N_BLOCK );
+			s0 = vaesmcq_u8( vaeseq_u8( s0, k ) );
+			s1 = vaesmcq_u8( vaeseq_u8( s1, k ) );
+			s2 = vaesmcq_u8( vaeseq_u8( s2, k ) );
+			s3 = vaesmcq_u8( vaeseq_u8( s3, k ) );
+		}
+		k = vld1q_u8( ctx->ksch + r * N_BLOCK );
+		s0 = vaeseq_u8( s0, k );
+		s1 = vaeseq_u8( s1, k );
+		s2 = vaeseq_u8( s2, k );
+		s3 = vaeseq_u8( s3, k );
+		k = vld1q_u8( ctx->ksch + ctx->rnd * N_BLOCK );
+		vst1q_u8( out, veorq_u8( s0, k ) );
+		vst1q_u8( out + N_BLOCK, veorq_u8( s1, k ) );
+		vst1q_u8( out + 2 * N_BLOCK, veorq_u8( s2, k ) );
+		vst1q_u8( out + 3 * N_BLOCK, veorq_u8( s3, k ) );
 	}
-	else
+	for( ; n_block > 0 ; n_block--, in += N_BLOCK, out += N_BLOCK )
+		enc_block_hw( in, out, ctx );
+}
+
+static int have_aes_hw( void )
+{
+	return ( getauxval( AT_HWCAP ) & HWCAP_AES ) != 0;
+}
+
+#endif
+
+/*  Backend picked at the first block, every thread picks the same one so
+	the unsynchronized first stores are harmless */
+
+typedef struct
+{   enc_block_f  one;
+	enc_blocks_f many;
+	const char   *name;
+} enc_backend;
+
+static const enc_backend enc_sw = { ENC_BLOCK_SW, enc_blocks_sw, ENC_NAME_SW };
+#if defined( AES_HW_X86 )
+static const enc_backend enc_hw = { enc_block_hw, enc_blocks_hw, "aes-ni" };
+#elif defined( AES_HW_ARM )
+static const enc_backend enc_hw = { enc_block_hw, enc_blocks_hw, "armv8-ce" };
+#endif
+
+static const enc_backend *enc_be = NULL;
+
+static const enc_backend *enc_select( void )
+{
+	const enc_backend *be = __atomic_load_n( &enc_be, __ATOMIC_RELAXED );
+
+	if( be != NULL )
+		return be;
+	be = &enc_sw;
+#if defined( AES_HW_X86 ) || defined( AES_HW_ARM )
+	if( have_aes_hw() )
+		be = &enc_hw;
+#endif
+	__atomic_store_n( &enc_be, be, __ATOMIC_RELAXED );
+	return be;
+}
+
+/*  Name of the backend aes_encrypt runs on */
+
+const char *aes_encrypt_backend( void )
+{
+	return enc_select()->name;
+}
+
+/*  Encrypt a single block of 16 bytes */
+
+return_type aes_encrypt( const unsigned char in[N_BLOCK], unsigned char  out[N_BLOCK], const aes_context ctx[1] )
+{
+	if( ctx->rnd == 0 )
+		return -1;
+	enc_select()->one( in, out, ctx );
+	return 0;
+}
+
+/*  Encrypt a number of independent blocks */
+
+return_type aes_encrypt_blocks( const unsigned char *in, unsigned char *out, int n_block, const aes_context ctx[1] )
+{
+	if( ctx->rnd == 0 )
 		return -1;
+	enc_select()->many( in, out, n_block, ctx );
 	return 0;
 }
 
@@ -7,6 +7,10 @@ Maintainer: skerlan
 */
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include "compiler.h"
+#include "lgwmm.h"
 #include "utilities.h"
 
 #include "aes.h"
@@ -20,38 +24,176 @@ Maintainer: skerlan
 #define LORAMAC_MIC_BLOCK_B0_SIZE                   16
 
 /*!>!
- * MIC field computation initial data
+ * Session keys cache of a thread, slot is picked by DevAddr. Entries
+ * replaced while a caller may still hold them are kept on Retired until
+ * LoRaMacSKeysRelease.
  */
-static uint8_t MicBlockB0[] = { 0x49, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                                0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-                              };
+typedef struct sLoRaMacSKeysCache
+{
+    uint32_t Gen;
+    LoRaMacSKeys_t *Slot[LORAMAC_SKEYS_CACHE_NB];
+    LoRaMacSKeys_t *Retired;
+} LoRaMacSKeysCache_t;
 
-/*!>!
- * Contains the computed MIC field.
- *
- * \remark Only the 4 first bytes are used
- */
-static uint8_t Mic[16];
+static pthread_key_t SKeysCacheKey;
+static pthread_once_t SKeysCacheOnce = PTHREAD_ONCE_INIT;
+static uint32_t SKeysGen = 0;                   /* bumped by LoRaMacSKeysFlush */
 
-/*!>!
- * Encryption aBlock and sBlock
- */
-static uint8_t aBlock[] = { 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-                          };
-static uint8_t sBlock[] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-                          };
+static void LoRaMacSKeysFreeList( LoRaMacSKeys_t *sKeys )
+{
+    LoRaMacSKeys_t *next;
 
-/*!>!
- * AES computation context variable
- */
-static aes_context AesContext;
+    for( ; sKeys != NULL; sKeys = next )
+    {
+        next = sKeys->Next;
+        lgw_free( sKeys );
+    }
+}
 
-/*!>!
- * CMAC computation context variable
- */
-static AES_CMAC_CTX AesCmacCtx[1];
+static void LoRaMacSKeysCacheFree( void *arg )
+{
+    LoRaMacSKeysCache_t *cache = arg;
+    int i;
+
+    for( i = 0; i < LORAMAC_SKEYS_CACHE_NB; i++ )
+    {
+        if( cache->Slot[i] != NULL )
+        {
+            lgw_free( cache->Slot[i] );
+        }
+    }
+    LoRaMacSKeysFreeList( cache->Retired );
+    lgw_free( cache );
+}
+
+static void LoRaMacSKeysCacheKey( void )
+{
+    pthread_key_create( &SKeysCacheKey, LoRaMacSKeysCacheFree );
+}
+
+static void LoRaMacSKeysRetire( LoRaMacSKeysCache_t *cache, int i )
+{
+    if( cache->Slot[i] != NULL )
+    {
+        cache->Slot[i]->Next = cache->Retired;
+        cache->Retired = cache->Slot[i];
+        cache->Slot[i] = NULL;
+    }
+}
+
+void LoRaMacSKeysSet( LoRaMacSKeys_t *sKeys, uint32_t devAddr, const uint8_t *nwkSKey, const uint8_t *appSKey )
+{
+    sKeys->DevAddr = devAddr;
+    lgw_memcpy( sKeys->NwkSKey, nwkSKey, 16 );
+    lgw_memcpy( sKeys->AppSKey, appSKey, 16 );
+
+    AES_CMAC_Init( &sKeys->NwkSKeyCmac );
+    AES_CMAC_SetKey( &sKeys->NwkSKeyCmac, nwkSKey );
+
+    aes_set_key( appSKey, 16, &sKeys->AppSKeyAes );
+    sKeys->Next = NULL;
+}
+
+const LoRaMacSKeys_t *LoRaMacSKeysGet( uint32_t devAddr, const uint8_t *nwkSKey, const uint8_t *appSKey )
+{
+    LoRaMacSKeysCache_t *cache;
+    LoRaMacSKeys_t *sKeys;
+    uint32_t gen = __atomic_load_n( &SKeysGen, __ATOMIC_ACQUIRE );
+    int i = ( devAddr * 2654435761u ) >> ( 32 - LORAMAC_SKEYS_CACHE_BITS );
+
+    pthread_once( &SKeysCacheOnce, LoRaMacSKeysCacheKey );
+    cache = pthread_getspecific( SKeysCacheKey );
+    if( cache == NULL )
+    {
+        cache = lgw_calloc( 1, sizeof( LoRaMacSKeysCache_t ) );
+        if( cache == NULL )
+        {
+            return NULL;
+        }
+        cache->Gen = gen;
+        pthread_setspecific( SKeysCacheKey, cache );
+    }
+
+    /*!> keys table reloaded since the last lookup of this thread */
+    if( cache->Gen != gen )
+    {
+        for( int j = 0; j < LORAMAC_SKEYS_CACHE_NB; j++ )
+        {
+            LoRaMacSKeysRetire( cache, j );
+        }
+        cache->Gen = gen;
+    }
+
+    sKeys = cache->Slot[i];
+    if( sKeys != NULL && sKeys->DevAddr == devAddr &&
+        memcmp( sKeys->NwkSKey, nwkSKey, 16 ) == 0 && memcmp( sKeys->AppSKey, appSKey, 16 ) == 0 )
+    {
+        return sKeys;
+    }
+
+    /*!> a colliding device takes the slot over */
+    sKeys = lgw_malloc( sizeof( LoRaMacSKeys_t ) );
+    if( sKeys == NULL )
+    {
+        return NULL;
+    }
+    LoRaMacSKeysSet( sKeys, devAddr, nwkSKey, appSKey );
+    LoRaMacSKeysRetire( cache, i );
+    cache->Slot[i] = sKeys;
+
+    return sKeys;
+}
+
+void LoRaMacSKeysRelease( void )
+{
+    LoRaMacSKeysCache_t *cache;
+
+    pthread_once( &SKeysCacheOnce, LoRaMacSKeysCacheKey );
+    cache = pthread_getspecific( SKeysCacheKey );
+    if( cache != NULL )
+    {
+        LoRaMacSKeysFreeList( cache->Retired );
+        cache->Retired = NULL;
+    }
+}
+
+void LoRaMacSKeysFlush( void )
+{
+    __atomic_add_fetch( &SKeysGen, 1, __ATOMIC_RELEASE );
+}
+
+void LoRaMacComputeMicCtx( const AES_CMAC_CTX *keyed, const uint8_t *buffer, uint16_t size, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint32_t *mic )
+{
+    AES_CMAC_CTX cmac = *keyed;
+    uint8_t micBlockB0[LORAMAC_MIC_BLOCK_B0_SIZE] = { 0x49 };
+    uint8_t computed[16];
+
+    micBlockB0[5] = dir;
+    
+    micBlockB0[6] = ( address ) & 0xFF;
+    micBlockB0[7] = ( address >> 8 ) & 0xFF;
+    micBlockB0[8] = ( address >> 16 ) & 0xFF;
+    micBlockB0[9] = ( address >> 24 ) & 0xFF;
+
+    micBlockB0[10] = ( sequenceCounter ) & 0xFF;
+    micBlockB0[11] = ( sequenceCounter >> 8 ) & 0xFF;
+    micBlockB0[12] = ( sequenceCounter >> 16 ) & 0xFF;
+    micBlockB0[13] = ( sequenceCounter >> 24 ) & 0xFF;
+
+    micBlockB0[15] = size & 0xFF;
+
+    /*!> AES_CMAC_Init would drop the key schedule */
+    lgw_memset( cmac.X, 0, sizeof( cmac.X ) );
+    cmac.M_n = 0;
+
+    AES_CMAC_Update( &cmac, micBlockB0, LORAMAC_MIC_BLOCK_B0_SIZE );
+    
+    AES_CMAC_Update( &cmac, buffer, size & 0xFF );
+    
+    AES_CMAC_Final( computed, &cmac );
+    
+    *mic = ( uint32_t )( ( uint32_t )computed[3] << 24 | ( uint32_t )computed[2] << 16 | ( uint32_t )computed[1] << 8 | ( uint32_t )computed[0] );
+}
 
 /*!>!
  * \brief Computes the LoRaMAC frame MIC field  
@@ -66,99 +208,115 @@ static AES_CMAC_CTX AesCmacCtx[1];
  */
 void LoRaMacComputeMic( const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint32_t *mic )
 {
-    MicBlockB0[5] = dir;
-    
-    MicBlockB0[6] = ( address ) & 0xFF;
-    MicBlockB0[7] = ( address >> 8 ) & 0xFF;
-    MicBlockB0[8] = ( address >> 16 ) & 0xFF;
-    MicBlockB0[9] = ( address >> 24 ) & 0xFF;
+    AES_CMAC_CTX cmac;
 
-    MicBlockB0[10] = ( sequenceCounter ) & 0xFF;
-    MicBlockB0[11] = ( sequenceCounter >> 8 ) & 0xFF;
-    MicBlockB0[12] = ( sequenceCounter >> 16 ) & 0xFF;
-    MicBlockB0[13] = ( sequenceCounter >> 24 ) & 0xFF;
+    AES_CMAC_Init( &cmac );
 
-    MicBlockB0[15] = size & 0xFF;
+    AES_CMAC_SetKey( &cmac, key );
 
-    AES_CMAC_Init( AesCmacCtx );
+    LoRaMacComputeMicCtx( &cmac, buffer, size, address, dir, sequenceCounter, mic );
+}
 
-    AES_CMAC_SetKey( AesCmacCtx, key );
+/*!>!
+ * \brief XORs a buffer with the keystream, 8 bytes at a time
+ */
+static void LoRaMacXorKeystream( uint8_t *dst, const uint8_t *src, const uint8_t *ks, uint16_t size )
+{
+    uint64_t a, b;
 
-    AES_CMAC_Update( AesCmacCtx, MicBlockB0, LORAMAC_MIC_BLOCK_B0_SIZE );
-    
-    AES_CMAC_Update( AesCmacCtx, buffer, size & 0xFF );
-    
-    AES_CMAC_Final( Mic, AesCmacCtx );
-    
-    *mic = ( uint32_t )( ( uint32_t )Mic[3] << 24 | ( uint32_t )Mic[2] << 16 | ( uint32_t )Mic[1] << 8 | ( uint32_t )Mic[0] );
+    while( size >= 8 )
+    {
+        memcpy( &a, src, 8 );
+        memcpy( &b, ks, 8 );
+        a ^= b;
+        memcpy( dst, &a, 8 );
+        dst += 8;
+        src += 8;
+        ks += 8;
+        size -= 8;
+    }
+    while( size-- )
+    {
+        *dst++ = *src++ ^ *ks++;
+    }
 }
 
-void LoRaMacPayloadEncrypt( const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *encBuffer )
+void LoRaMacPayloadEncryptCtx( const aes_context *aes, const uint8_t *buffer, uint16_t size, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *encBuffer )
 {
-    uint16_t i;
-    uint8_t bufferIndex = 0;
+    uint8_t aBlock[LORAMAC_CTR_BLOCKS][16];
+    uint8_t sBlock[LORAMAC_CTR_BLOCKS][16];
     uint16_t ctr = 1;
+    uint16_t len;
+    int i, nb;
 
-    lgw_memset( AesContext.ksch, '\0', 240 );
-    aes_set_key( key, 16, &AesContext );
+    /*!> every counter block differs from the first one by its counter only */
+    lgw_memset( aBlock[0], 0, 16 );
+    aBlock[0][0] = 0x01;
 
-    aBlock[5] = dir;
+    aBlock[0][5] = dir;
 
-    aBlock[6] = ( address ) & 0xFF;
-    aBlock[7] = ( address >> 8 ) & 0xFF;
-    aBlock[8] = ( address >> 16 ) & 0xFF;
-    aBlock[9] = ( address >> 24 ) & 0xFF;
+    aBlock[0][6] = ( address ) & 0xFF;
+    aBlock[0][7] = ( address >> 8 ) & 0xFF;
+    aBlock[0][8] = ( address >> 16 ) & 0xFF;
+    aBlock[0][9] = ( address >> 24 ) & 0xFF;
 
-    aBlock[10] = ( sequenceCounter ) & 0xFF;
-    aBlock[11] = ( sequenceCounter >> 8 ) & 0xFF;
-    aBlock[12] = ( sequenceCounter >> 16 ) & 0xFF;
-    aBlock[13] = ( sequenceCounter >> 24 ) & 0xFF;
+    aBlock[0][10] = ( sequenceCounter ) & 0xFF;
+    aBlock[0][11] = ( sequenceCounter >> 8 ) & 0xFF;
+    aBlock[0][12] = ( sequenceCounter >> 16 ) & 0xFF;
+    aBlock[0][13] = ( sequenceCounter >> 24 ) & 0xFF;
 
-    /*!> FOR DEBUG 
-    printf("\naBlock:");
-    for (i = 0; i < 16; i++) {
-        printf("%02X", aBlock[i]);
-    }
-    printf("\n+++++++++++++++++++++++++++++++++++++++\n");
-
-    printf("\nSKEY:");
-    for (i = 0; i < 16; i++) {
-        printf("%02X", key[i]);
+    for( i = 1; i < LORAMAC_CTR_BLOCKS; i++ )
+    {
+        lgw_memcpy( aBlock[i], aBlock[0], 16 );
     }
-    printf("\n+++++++++++++++++++++++++++++++++++++++\n");
-    */
 
-    while( size >= 16 )
+    /*!> a whole frame is one call of the block cipher */
+    while( size > 0 )
     {
-        aBlock[15] = ( ( ctr ) & 0xFF );
-        ctr++;
-        aes_encrypt( aBlock, sBlock, &AesContext );
-        for( i = 0; i < 16; i++ )
+        nb = ( size + 15 ) / 16;
+        if( nb > LORAMAC_CTR_BLOCKS )
+        {
+            nb = LORAMAC_CTR_BLOCKS;
+        }
+        for( i = 0; i < nb; i++ )
         {
-            encBuffer[bufferIndex + i] = buffer[bufferIndex + i] ^ sBlock[i];
+            aBlock[i][15] = ( ( ctr++ ) & 0xFF );
         }
-        size -= 16;
-        bufferIndex += 16;
+        aes_encrypt_blocks( aBlock[0], sBlock[0], nb, aes );
+
+        len = size < nb * 16 ? size : nb * 16;
+        LoRaMacXorKeystream( encBuffer, buffer, sBlock[0], len );
+        buffer += len;
+        encBuffer += len;
+        size -= len;
     }
+}
+
+void LoRaMacPayloadDecryptCtx( const aes_context *aes, const uint8_t *buffer, uint16_t size, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *decBuffer )
+{
+    LoRaMacPayloadEncryptCtx( aes, buffer, size, address, dir, sequenceCounter, decBuffer );
+}
+
+void LoRaMacPayloadDecryptBatch( const LoRaMacDecryptJob_t *jobs, int nb )
+{
+    int i;
 
-    if( size > 0 )
+    for( i = 0; i < nb; i++ )
     {
-        aBlock[15] = ( ( ctr ) & 0xFF );
-        aes_encrypt( aBlock, sBlock, &AesContext );
-        /*!>
-        printf("\nsBlock:");
-        for (i = 0; i < 16; i++) {
-            printf("%02X", sBlock[i]);
-        }
-        printf("\n+++++++++++++++++++++++++++++++++++++++\n");
-        */
-        for( i = 0; i < size; i++ )
-        {
-            encBuffer[bufferIndex + i] = buffer[bufferIndex + i] ^ sBlock[i];
-        }
+        LoRaMacPayloadEncryptCtx( jobs[i].Aes, jobs[i].Buffer, jobs[i].Size, jobs[i].Address, jobs[i].Dir, jobs[i].SequenceCounter, jobs[i].DecBuffer );
     }
 }
 
+void LoRaMacPayloadEncrypt( const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *encBuffer )
+{
+    aes_context aes;
+
+    lgw_memset( aes.ksch, '\0', 240 );
+    aes_set_key( key, 16, &aes );
+
+    LoRaMacPayloadEncryptCtx( &aes, buffer, size, address, dir, sequenceCounter, encBuffer );
+}
+
 void LoRaMacPayloadDecrypt( const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *decBuffer )
 {
     LoRaMacPayloadEncrypt( buffer, size, key, address, dir, sequenceCounter, decBuffer );
@@ -166,19 +324,24 @@ void LoRaMacPayloadDecrypt( const uint8_t *buffer, uint16_t size, const uint8_t
 
 void LoRaMacJoinComputeMic( const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t *mic )
 {
-    AES_CMAC_Init( AesCmacCtx );
+    AES_CMAC_CTX cmac;
+    uint8_t Mic[16];
+
+    AES_CMAC_Init( &cmac );
 
-    AES_CMAC_SetKey( AesCmacCtx, key );
+    AES_CMAC_SetKey( &cmac, key );
 
-    AES_CMAC_Update( AesCmacCtx, buffer, size & 0xFF );
+    AES_CMAC_Update( &cmac, buffer, size & 0xFF );
 
-    AES_CMAC_Final( Mic, AesCmacCtx );
+    AES_CMAC_Final( Mic, &cmac );
 
     *mic = ( uint32_t )( ( uint32_t )Mic[3] << 24 | ( uint32_t )Mic[2] << 16 | ( uint32_t )Mic[1] << 8 | ( uint32_t )Mic[0] );
 }
 
 void LoRaMacJoinDecrypt( const uint8_t *buffer, uint16_t size, const uint8_t *key, uint8_t *decBuffer )
 {
+    aes_context AesContext;
+
     lgw_memset( AesContext.ksch, '\0', 240 );
     aes_set_key( key, 16, &AesContext );
     aes_decrypt( buffer, decBuffer, &AesContext );
@@ -192,6 +355,7 @@ void LoRaMacJoinComputeSKeys( const uint8_t *key, const uint8_t *appNonce, uint1
 {
     uint8_t nonce[16];
     uint8_t *pDevNonce = ( uint8_t * )&devNonce;
+    aes_context AesContext;
     
     lgw_memset( AesContext.ksch, '\0', 240 );
     aes_set_key( key, 16, &AesContext );
@@ -0,0 +1,237 @@
+/*!>
+Description:
+    Known answer and throughput test of the AES block encryption backends
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf */
+#include <stdlib.h>     /* EXIT_FAILURE, rand */
+#include <string.h>     /* memcmp */
+#include <getopt.h>     /* getopt */
+#include <time.h>       /* clock_gettime */
+
+#include "aes.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define BENCH_BLOCKS        4096        /* blocks per aes_encrypt_blocks call, a buffer of 64 KiB */
+#define BENCH_ROUNDS        256         /* calls per measure */
+#define CHAIN_MAX           9           /* blocks per call checked against single block encryption */
+
+typedef struct {
+    const char *name;
+    uint8_t keylen;
+    uint8_t key[32];
+    uint8_t pt[N_BLOCK];
+    uint8_t ct[N_BLOCK];
+} aes_kat_s;
+
+/* FIPS-197 appendix B and C.1 to C.3 */
+static const aes_kat_s kat[] = {
+    { "FIPS-197 B   AES-128", 16,
+      { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c },
+      { 0x32, 0x43, 0xf6, 0xa8, 0x88, 0x5a, 0x30, 0x8d, 0x31, 0x31, 0x98, 0xa2, 0xe0, 0x37, 0x07, 0x34 },
+      { 0x39, 0x25, 0x84, 0x1d, 0x02, 0xdc, 0x09, 0xfb, 0xdc, 0x11, 0x85, 0x97, 0x19, 0x6a, 0x0b, 0x32 } },
+    { "FIPS-197 C.1 AES-128", 16,
+      { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f },
+      { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff },
+      { 0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30, 0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a } },
+    { "FIPS-197 C.2 AES-192", 24,
+      { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+        0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17 },
+      { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff },
+      { 0xdd, 0xa9, 0x7c, 0xa4, 0x86, 0x4c, 0xdf, 0xe0, 0x6e, 0xaf, 0x70, 0xa0, 0xec, 0x0d, 0x71, 0x91 } },
+    { "FIPS-197 C.3 AES-256", 32,
+      { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+        0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f },
+      { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff },
+      { 0x8e, 0xa2, 0xb7, 0xca, 0x51, 0x67, 0x45, 0xbf, 0xea, 0xfc, 0x49, 0x90, 0x4b, 0x49, 0x60, 0x89 } },
+};
+
+#define KAT_NB              (sizeof(kat) / sizeof(kat[0]))
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* describe command line options */
+static void usage(void) {
+    printf("Available options:\n");
+    printf(" -h print this help\n");
+    printf(" -b         also measure the throughput of the backend\n");
+}
+
+static void print_block(const char *label, const uint8_t *b) {
+    int i;
+
+    printf("    %s ", label);
+    for (i = 0; i < N_BLOCK; i++)
+        printf("%02x", b[i]);
+    printf("\n");
+}
+
+static double now_s(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* FIPS-197 vectors through aes_encrypt, aes_encrypt_blocks and aes_decrypt */
+static int test_kat(void) {
+    unsigned int i;
+    int nb_fail = 0;
+    uint8_t out[4 * N_BLOCK], in[4 * N_BLOCK];
+    aes_context ctx;
+
+    for (i = 0; i < KAT_NB; i++) {
+        bool ok = true;
+        int j;
+
+        aes_set_key(kat[i].key, kat[i].keylen, &ctx);
+
+        if (aes_encrypt(kat[i].pt, out, &ctx) != 0 || memcmp(out, kat[i].ct, N_BLOCK) != 0) {
+            print_block("encrypt ", out);
+            ok = false;
+        }
+
+        /* the same block four times goes through the interleaved path of the hardware backends */
+        for (j = 0; j < 4; j++)
+            memcpy(in + j * N_BLOCK, kat[i].pt, N_BLOCK);
+        aes_encrypt_blocks(in, out, 4, &ctx);
+        for (j = 0; j < 4; j++) {
+            if (memcmp(out + j * N_BLOCK, kat[i].ct, N_BLOCK) != 0) {
+                print_block("blocks  ", out + j * N_BLOCK);
+                ok = false;
+            }
+        }
+
+        if (aes_decrypt(kat[i].ct, out, &ctx) != 0 || memcmp(out, kat[i].pt, N_BLOCK) != 0) {
+            print_block("decrypt ", out);
+            ok = false;
+        }
+
+        printf("%s %s\n", ok ? "PASS" : "FAIL", kat[i].name);
+        if (!ok) {
+            print_block("expected", kat[i].ct);
+            nb_fail++;
+        }
+    }
+
+    return nb_fail;
+}
+
+/* every chain length up to CHAIN_MAX, out of place and in place, against single blocks */
+static int test_blocks(void) {
+    uint8_t key[16], in[CHAIN_MAX * N_BLOCK], ref[CHAIN_MAX * N_BLOCK], out[CHAIN_MAX * N_BLOCK];
+    aes_context ctx;
+    int i, n, nb_fail = 0;
+
+    srand(0x1302);
+    for (i = 0; i < (int)sizeof(key); i++)
+        key[i] = rand();
+    for (i = 0; i < (int)sizeof(in); i++)
+        in[i] = rand();
+
+    aes_set_key(key, sizeof(key), &ctx);
+    for (i = 0; i < CHAIN_MAX; i++)
+        aes_encrypt(in + i * N_BLOCK, ref + i * N_BLOCK, &ctx);
+
+    for (n = 1; n <= CHAIN_MAX; n++) {
+        aes_encrypt_blocks(in, out, n, &ctx);
+        if (memcmp(out, ref, n * N_BLOCK) != 0) {
+            printf("FAIL aes_encrypt_blocks %d blocks\n", n);
+            nb_fail++;
+        }
+        memcpy(out, in, n * N_BLOCK);
+        aes_encrypt_blocks(out, out, n, &ctx);
+        if (memcmp(out, ref, n * N_BLOCK) != 0) {
+            printf("FAIL aes_encrypt_blocks %d blocks in place\n", n);
+            nb_fail++;
+        }
+    }
+
+    if (nb_fail == 0)
+        printf("PASS aes_encrypt_blocks 1..%d blocks\n", CHAIN_MAX);
+
+    return nb_fail;
+}
+
+static void bench(void) {
+    static uint8_t buf[BENCH_BLOCKS * N_BLOCK];
+    aes_context ctx;
+    double t;
+    int i, r;
+
+    aes_set_key(kat[0].key, kat[0].keylen, &ctx);
+    memset(buf, 0x5a, sizeof(buf));
+
+    t = now_s();
+    for (r = 0; r < BENCH_ROUNDS; r++)
+        for (i = 0; i < BENCH_BLOCKS; i++)
+            aes_encrypt(buf + i * N_BLOCK, buf + i * N_BLOCK, &ctx);
+    t = now_s() - t;
+    printf("aes_encrypt        : %8.1f MB/s, %6.1f ns/block\n",
+            (double)sizeof(buf) * BENCH_ROUNDS / t / 1e6, t * 1e9 / ((double)BENCH_BLOCKS * BENCH_ROUNDS));
+
+    t = now_s();
+    for (r = 0; r < BENCH_ROUNDS; r++)
+        aes_encrypt_blocks(buf, buf, BENCH_BLOCKS, &ctx);
+    t = now_s() - t;
+    printf("aes_encrypt_blocks : %8.1f MB/s, %6.1f ns/block\n",
+            (double)sizeof(buf) * BENCH_ROUNDS / t / 1e6, t * 1e9 / ((double)BENCH_BLOCKS * BENCH_ROUNDS));
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv) {
+    int i;
+    bool do_bench = false;
+    int nb_fail;
+
+    while ((i = getopt(argc, argv, "hb")) != -1) {
+        switch (i) {
+            case 'h':
+                usage();
+                return EXIT_SUCCESS;
+            case 'b':
+                do_bench = true;
+                break;
+            default:
+                printf("ERROR: argument parsing\n");
+                usage();
+                return EXIT_FAILURE;
+        }
+    }
+
+    printf("AES backend: %s\n", aes_encrypt_backend());
+
+    nb_fail = test_kat();
+    nb_fail += test_blocks();
+
+    if (do_bench)
+        bench();
+
+    if (nb_fail > 0) {
+        printf("%d test(s) failed\n", nb_fail);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */